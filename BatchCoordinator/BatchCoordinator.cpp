@@ -0,0 +1,368 @@
+// Runs a batch over several BatchDriver worker processes, so a worker that crashes or hangs only costs the jobs it was on
+// The job list is cut into shards. Each worker is started once and kept running: a thread of the coordinator sends it one
+// shard at a time over a pipe, which it solves single-threaded, straight into the memory-mapped result file that the
+// coordinator and every worker have mapped. A worker compiles each expression the first time one of its shards uses it.
+// When a worker dies, or stops making progress for the stall timeout, the rest of its shard is queued again and a new
+// worker takes its place. A job that a worker fails on twice is given up on and marked BATCH_WORKER_FAILED, so one bad
+// expression cannot stop the run. Worker n logs to batch_log_n.txt
+// Build as a console application together with BatchJobFile.cpp and MappedFile.cpp. BatchDriver.exe has to be in the
+// same directory
+//
+// usage: BatchCoordinator <job file> <result file> [workers] [shard size] [stall timeout]
+// workers defaults to one per core, shard size to 4096 jobs and the stall timeout to 60 seconds
+// Like BatchDriver, results that are already filled in are skipped, so an interrupted run can simply be started again
+
+#include "../pch.h"
+
+#include <algorithm>
+#include "../BatchJobFile.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	const size_t DEFAULT_SHARD_SIZE = 4096;
+	const double DEFAULT_STALL_TIMEOUT = 60.0;
+	const auto POLL_INTERVAL = std::chrono::milliseconds(100); // how often the workers are checked for stalls
+
+	// a range of jobs handed to one worker
+	struct Shard
+	{
+		size_t first;
+		size_t count;
+		size_t failedJob; // the job the last worker on this shard died on, or SIZE_MAX
+	};
+
+	// what the threads feeding the workers share
+	struct Coordination
+	{
+		std::string driver;
+		std::string jobPath;
+		std::string resultPath;
+		const BatchJobReader* jobs;
+		BatchResultRecord* records;
+
+		std::mutex queueMutex; // guards everything below
+		std::condition_variable queueChanged;
+		std::deque<Shard> queue;
+		size_t inFlight = 0; // shards with a worker, which can come back to the queue if the worker dies
+		size_t feeders = 0; // threads still feeding a worker
+		size_t restarts = 0;
+		size_t failedJobs = 0;
+	};
+
+	// a worker process, kept running from one shard to the next, and the shard it is on
+	struct Worker
+	{
+		size_t index; // names the worker's log
+		PROCESS_INFORMATION process;
+		HANDLE toWorker; // the worker's stdin, a "first count" line per shard
+		HANDLE fromWorker; // the worker's stdout, a "done" line per shard
+		bool running = false;
+
+		std::mutex stateMutex; // guards the process handle and the fields below, which the stall check reads
+		bool busy = false;
+		Shard shard;
+		size_t nextPending; // the jobs of the shard before this one are known to be done
+		std::chrono::steady_clock::time_point lastProgress;
+	};
+
+	// the path of BatchDriver.exe, next to this executable
+	std::string FindDriver();
+	// the first job in [from, end) whose result is still pending, or end
+	size_t FirstPending(const BatchResultRecord* records, size_t from, size_t end);
+	// starts the worker's process with pipes for its stdin and stdout
+	bool StartWorker(const Coordination& coordination, Worker& worker);
+	// closes the worker's stdin, so it exits once it is done, and waits for it. Returns the exit code
+	DWORD StopWorker(Worker& worker);
+	// sends shards to the worker one at a time until there are none left, restarting it when it dies. Runs on a thread of its own
+	void FeedWorker(Coordination& coordination, Worker& worker);
+	// kills the workers that made no progress on their shard for stallDuration
+	void StopStalledWorkers(const Coordination& coordination, std::vector<std::unique_ptr<Worker>>& workers,
+		std::chrono::steady_clock::duration stallDuration);
+	bool SendShard(HANDLE pipe, const Shard& shard);
+	// waits for the worker to report its shard done, false if it exited first
+	bool WaitForDone(HANDLE pipe);
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 3)
+	{
+		std::cerr << "usage: BatchCoordinator <job file> <result file> [workers] [shard size] [stall timeout]\n";
+		return 1;
+	}
+
+	try
+	{
+		Coordination coordination;
+		coordination.jobPath = argv[1];
+		coordination.resultPath = argv[2];
+		unsigned int workerCount = argc > 3 ? static_cast<unsigned int>(std::stoul(argv[3])) : std::thread::hardware_concurrency();
+		workerCount = std::max(workerCount, 1u);
+		const size_t shardSize = std::max<size_t>(argc > 4 ? std::stoull(argv[4]) : DEFAULT_SHARD_SIZE, 1);
+		const double stallTimeout = argc > 5 ? std::stod(argv[5]) : DEFAULT_STALL_TIMEOUT;
+		const auto stallDuration = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(stallTimeout));
+		coordination.driver = FindDriver();
+
+		// the coordinator creates the result file, the workers only ever reopen it
+		const BatchJobReader jobs(coordination.jobPath);
+		const size_t jobCount = jobs.GetJobCount();
+		BatchResultFile results(coordination.resultPath, jobCount);
+		coordination.jobs = &jobs;
+		coordination.records = results.GetRecords();
+
+		for (size_t first = 0; first < jobCount; first += shardSize)
+		{
+			const size_t count = std::min(shardSize, jobCount - first);
+			if (FirstPending(coordination.records, first, first + count) < first + count) coordination.queue.push_back({ first, count, SIZE_MAX });
+		}
+		workerCount = static_cast<unsigned int>(std::min<size_t>(workerCount, std::max<size_t>(coordination.queue.size(), 1)));
+		std::cout << jobCount << " jobs, " << coordination.queue.size() << " shards to solve on " << workerCount << " workers"
+			<< (results.WasResumed() ? ", resuming existing results" : "") << "\n";
+
+		const auto start = std::chrono::steady_clock::now();
+		std::vector<std::unique_ptr<Worker>> workers;
+		for (unsigned int i = 0; i < workerCount; ++i)
+		{
+			workers.push_back(std::make_unique<Worker>());
+			workers.back()->index = i;
+			if (!StartWorker(coordination, *workers.back()))
+			{
+				const DWORD error = GetLastError();
+				for (auto& started : workers) if (started->running) StopWorker(*started);
+				throw std::runtime_error("BatchCoordinator - unable to start " + coordination.driver + " (error " + std::to_string(error) + ")");
+			}
+		}
+		coordination.feeders = workers.size();
+		std::vector<std::thread> feeders;
+		for (auto& worker : workers) feeders.emplace_back(FeedWorker, std::ref(coordination), std::ref(*worker));
+
+		{
+			std::unique_lock<std::mutex> lock(coordination.queueMutex);
+			while (coordination.feeders > 0)
+			{
+				coordination.queueChanged.wait_for(lock, POLL_INTERVAL);
+				if (stallTimeout <= 0.0) continue;
+				lock.unlock();
+				StopStalledWorkers(coordination, workers, stallDuration);
+				lock.lock();
+			}
+		}
+		for (std::thread& feeder : feeders) feeder.join();
+		if (!coordination.queue.empty()) throw std::runtime_error("BatchCoordinator - unable to restart " + coordination.driver);
+		results.Flush();
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		std::cout << "Finished " << jobCount << " jobs in " << seconds << " s";
+		if (seconds > 0.0) std::cout << ", " << static_cast<size_t>(jobCount / seconds) << " jobs/s";
+		std::cout << ", " << coordination.restarts << " shards restarted, " << coordination.failedJobs << " jobs given up on\n";
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << "\n";
+		return 1;
+	}
+	return 0;
+}
+
+namespace
+{
+	std::string FindDriver()
+	{
+		char path[MAX_PATH];
+		const DWORD length = GetModuleFileNameA(nullptr, path, MAX_PATH);
+		if (length == 0 || length == MAX_PATH) throw std::runtime_error("BatchCoordinator - unable to find its own path");
+		std::string driver(path, length);
+		driver.erase(driver.find_last_of("\\/") + 1);
+		return driver + "BatchDriver.exe";
+	}
+
+	size_t FirstPending(const BatchResultRecord* records, size_t from, size_t end)
+	{
+		while (from < end && records[from].status != BATCH_PENDING) ++from;
+		return from;
+	}
+
+	bool StartWorker(const Coordination& coordination, Worker& worker)
+	{
+		// a worker started by another thread at the same time would inherit this one's ends of the pipes, and then
+		// this worker would never see its stdin closed, so the workers are started one at a time
+		static std::mutex startMutex;
+		std::lock_guard<std::mutex> startLock(startMutex);
+
+		SECURITY_ATTRIBUTES inherited = { sizeof(SECURITY_ATTRIBUTES), nullptr, TRUE };
+		HANDLE stdinRead = nullptr;
+		HANDLE stdoutWrite = nullptr;
+		if (!CreatePipe(&stdinRead, &worker.toWorker, &inherited, 0)) return false;
+		if (!CreatePipe(&worker.fromWorker, &stdoutWrite, &inherited, 0))
+		{
+			CloseHandle(stdinRead);
+			CloseHandle(worker.toWorker);
+			return false;
+		}
+		SetHandleInformation(worker.toWorker, HANDLE_FLAG_INHERIT, 0);
+		SetHandleInformation(worker.fromWorker, HANDLE_FLAG_INHERIT, 0);
+
+		STARTUPINFOA startup = {};
+		startup.cb = sizeof(startup);
+		startup.dwFlags = STARTF_USESTDHANDLES;
+		startup.hStdInput = stdinRead;
+		startup.hStdOutput = stdoutWrite;
+		startup.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+		const std::string commandLine = "\"" + coordination.driver + "\" \"" + coordination.jobPath + "\" \"" + coordination.resultPath +
+			"\" --worker batch_log_" + std::to_string(worker.index) + ".txt";
+		std::vector<char> mutableCommandLine(commandLine.begin(), commandLine.end());
+		mutableCommandLine.push_back('\0');
+		worker.running = CreateProcessA(nullptr, mutableCommandLine.data(), nullptr, nullptr, TRUE, 0, nullptr, nullptr, &startup, &worker.process) != 0;
+
+		// the worker has its own copies now
+		CloseHandle(stdinRead);
+		CloseHandle(stdoutWrite);
+		if (!worker.running)
+		{
+			CloseHandle(worker.toWorker);
+			CloseHandle(worker.fromWorker);
+		}
+		return worker.running;
+	}
+
+	DWORD StopWorker(Worker& worker)
+	{
+		CloseHandle(worker.toWorker);
+		WaitForSingleObject(worker.process.hProcess, INFINITE);
+		DWORD exitCode = 0;
+		GetExitCodeProcess(worker.process.hProcess, &exitCode);
+		CloseHandle(worker.fromWorker);
+		{
+			std::lock_guard<std::mutex> lock(worker.stateMutex);
+			CloseHandle(worker.process.hProcess);
+			CloseHandle(worker.process.hThread);
+			worker.running = false;
+		}
+		return exitCode;
+	}
+
+	void FeedWorker(Coordination& coordination, Worker& worker)
+	{
+		std::unique_lock<std::mutex> lock(coordination.queueMutex);
+		while (true)
+		{
+			// a shard still with a worker can come back, so the feeders only stop once every shard is done
+			coordination.queueChanged.wait(lock, [&]() { return !coordination.queue.empty() || coordination.inFlight == 0; });
+			if (coordination.queue.empty()) break;
+			const Shard shard = coordination.queue.front();
+			coordination.queue.pop_front();
+			++coordination.inFlight;
+			lock.unlock();
+
+			const size_t end = shard.first + shard.count;
+			bool started = worker.running || StartWorker(coordination, worker);
+			if (started)
+			{
+				std::lock_guard<std::mutex> stateLock(worker.stateMutex);
+				worker.busy = true;
+				worker.shard = shard;
+				worker.nextPending = shard.first;
+				worker.lastProgress = std::chrono::steady_clock::now();
+			}
+			const bool done = started && SendShard(worker.toWorker, shard) && WaitForDone(worker.fromWorker);
+			{
+				std::lock_guard<std::mutex> stateLock(worker.stateMutex);
+				worker.busy = false;
+			}
+			DWORD exitCode = 0;
+			if (started && !done)
+			{
+				// it crashed, or was stopped for making no progress
+				TerminateProcess(worker.process.hProcess, 1);
+				exitCode = StopWorker(worker);
+			}
+
+			lock.lock();
+			--coordination.inFlight;
+			if (!started)
+			{
+				// leave the shard to the other workers
+				coordination.queue.push_front(shard);
+				break;
+			}
+			const size_t failedJob = done ? end : FirstPending(coordination.records, shard.first, end);
+			if (failedJob < end)
+			{
+				// the worker solves its shard in order, so the first pending job is the one it was on
+				++coordination.restarts;
+				std::cerr << "Worker on jobs " << shard.first << " to " << end << " exited with code " << exitCode << " at job " << failedJob << "\n";
+				if (failedJob == shard.failedJob)
+				{
+					coordination.records[failedJob] = { coordination.jobs->GetJob(failedJob).initialGuess, 0, BATCH_WORKER_FAILED };
+					++coordination.failedJobs;
+					if (failedJob + 1 < end) coordination.queue.push_back({ failedJob + 1, end - failedJob - 1, SIZE_MAX });
+				}
+				else
+				{
+					coordination.queue.push_back({ failedJob, end - failedJob, failedJob });
+				}
+			}
+			coordination.queueChanged.notify_all();
+		}
+		--coordination.feeders;
+		coordination.queueChanged.notify_all();
+		lock.unlock();
+
+		if (worker.running) StopWorker(worker);
+	}
+
+	void StopStalledWorkers(const Coordination& coordination, std::vector<std::unique_ptr<Worker>>& workers,
+		std::chrono::steady_clock::duration stallDuration)
+	{
+		const auto now = std::chrono::steady_clock::now();
+		for (auto& worker : workers)
+		{
+			std::lock_guard<std::mutex> lock(worker->stateMutex);
+			if (!worker->busy || !worker->running) continue;
+			const size_t end = worker->shard.first + worker->shard.count;
+			const size_t nextPending = FirstPending(coordination.records, worker->nextPending, end);
+			if (nextPending != worker->nextPending)
+			{
+				worker->nextPending = nextPending;
+				worker->lastProgress = now;
+			}
+			else if (now - worker->lastProgress > stallDuration)
+			{
+				// its thread sees the pipe close and deals with the rest of the shard
+				std::cerr << "Worker on jobs " << worker->shard.first << " to " << end << " is stuck on job " << worker->nextPending << ", stopping it\n";
+				TerminateProcess(worker->process.hProcess, 1);
+				worker->lastProgress = now;
+			}
+		}
+	}
+
+	bool SendShard(HANDLE pipe, const Shard& shard)
+	{
+		const std::string line = std::to_string(shard.first) + " " + std::to_string(shard.count) + "\n";
+		DWORD written = 0;
+		return WriteFile(pipe, line.data(), static_cast<DWORD>(line.size()), &written, nullptr) && written == line.size();
+	}
+
+	bool WaitForDone(HANDLE pipe)
+	{
+		std::string line;
+		char c = 0;
+		DWORD read = 0;
+		while (ReadFile(pipe, &c, 1, &read, nullptr) && read == 1)
+		{
+			if (c == '\n') return line == "done" || line == "done\r";
+			line.push_back(c);
+		}
+		return false;
+	}
+}
\ No newline at end of file
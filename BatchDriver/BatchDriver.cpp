@@ -0,0 +1,202 @@
+// Offline batch driver: solves every job of a memory-mapped job file in parallel and writes the results into a
+// pre-sized memory-mapped result file
+// Build as a console application together with BatchJobFile.cpp, CompiledExpression.cpp, Interval.cpp,
+// Logger.cpp, MappedFile.cpp and Parallel.cpp
+//
+// usage: BatchDriver <job file> <result file> [first job] [job count] [threads]
+//        BatchDriver <job file> <result file> --worker [log file]
+// Results that are already filled in are skipped, so an interrupted run can simply be started again,
+// and a run can be limited to a range of jobs. threads defaults to one per core, with 1 the jobs are solved in order
+// Only the expressions that the jobs being run use are compiled
+// With --worker it is one of BatchCoordinator's worker processes: it reads ranges of jobs from stdin, solves each in order
+// on one thread, and answers each with a line on stdout, until stdin is closed. It logs to the given file, batch_log.txt by default
+
+#include "../pch.h"
+
+#include <algorithm>
+#include <atomic>
+#include "../BatchJobFile.h"
+#include <chrono>
+#include <cmath>
+#include "../CompiledExpression.h"
+#include <iostream>
+#include "../Logger.h"
+#include <memory>
+#include "../Parallel.h"
+#include "../Solvers.h"
+#include <string>
+#include <vector>
+
+namespace
+{
+	const size_t CHUNK_SIZE = 4096; // jobs handed to a thread at a time
+	const char* const WORKER_FLAG = "--worker";
+
+	// an expression and its derivative, compiled once and shared by every job that uses them
+	struct CompiledJobExpression
+	{
+		bool attempted = false; // whether it was compiled yet, the jobs only compile the expressions they use
+		std::unique_ptr<CompiledExpression> function; // null when the expression is invalid
+		std::unique_ptr<CompiledExpression> derivative;
+	};
+
+	// compiles the expressions used by the jobs in [begin, end) that were not compiled before
+	void CompileExpressions(const BatchJobReader& jobs, size_t begin, size_t end, const std::shared_ptr<Logger>& logger,
+		std::vector<CompiledJobExpression>& compiled);
+	// the options a job is solved with. Every check of the monitor that a job file cannot set is spelled out, off, so the results
+	// of a job file do not change with the defaults of SolveOptions
+	SolveOptions JobOptions(const BatchJobRecord& job);
+	// solves the pending jobs in [begin, end) in order, adding to solved and converged
+	void SolveJobs(const BatchJobReader& jobs, const std::vector<CompiledJobExpression>& compiled, BatchResultRecord* records,
+		size_t begin, size_t end, size_t& solved, size_t& converged);
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 3)
+	{
+		std::cerr << "usage: BatchDriver <job file> <result file> [first job] [job count] [threads]\n";
+		std::cerr << "       BatchDriver <job file> <result file> --worker [log file]\n";
+		return 1;
+	}
+
+	try
+	{
+		const bool workerMode = argc > 3 && std::string(argv[3]) == WORKER_FLAG;
+		auto logger = std::make_shared<Logger>(workerMode && argc > 4 ? argv[4] : "batch_log.txt");
+		const BatchJobReader jobs(argv[1]);
+		BatchResultFile results(argv[2], jobs.GetJobCount());
+		BatchResultRecord* records = results.GetRecords();
+		std::vector<CompiledJobExpression> compiled(jobs.GetExpressionCount());
+
+		if (workerMode)
+		{
+			// BatchCoordinator sends one "first count" line per shard and waits for the "done" line after it
+			// the process lives until the coordinator closes its end, so each expression is compiled at most once
+			size_t first = 0;
+			size_t count = 0;
+			while (std::cin >> first >> count)
+			{
+				first = std::min(first, jobs.GetJobCount());
+				const size_t end = first + std::min(count, jobs.GetJobCount() - first);
+				CompileExpressions(jobs, first, end, logger, compiled);
+				size_t solved = 0;
+				size_t converged = 0;
+				SolveJobs(jobs, compiled, records, first, end, solved, converged);
+				std::cout << "done" << std::endl;
+			}
+			results.Flush();
+			return 0;
+		}
+
+		const size_t firstJob = std::min<size_t>(argc > 3 ? std::stoull(argv[3]) : 0, jobs.GetJobCount());
+		const size_t jobCount = std::min<size_t>(argc > 4 ? std::stoull(argv[4]) : jobs.GetJobCount(), jobs.GetJobCount() - firstJob);
+		const unsigned int threads = argc > 5 ? static_cast<unsigned int>(std::stoul(argv[5])) : 0;
+		std::cout << "Jobs " << firstJob << " to " << firstJob + jobCount << " of " << jobs.GetJobCount()
+			<< (results.WasResumed() ? ", resuming existing results" : "") << "\n";
+
+		// compile everything up front on this thread, the workers only evaluate
+		CompileExpressions(jobs, firstJob, firstJob + jobCount, logger, compiled);
+
+		std::atomic<size_t> solved(0);
+		std::atomic<size_t> converged(0);
+		const auto start = std::chrono::steady_clock::now();
+		parallel::ParallelFor((jobCount + CHUNK_SIZE - 1) / CHUNK_SIZE, [&](size_t chunk)
+		{
+			const size_t begin = firstJob + chunk * CHUNK_SIZE;
+			const size_t end = std::min(begin + CHUNK_SIZE, firstJob + jobCount);
+			size_t chunkSolved = 0;
+			size_t chunkConverged = 0;
+			SolveJobs(jobs, compiled, records, begin, end, chunkSolved, chunkConverged);
+			solved += chunkSolved;
+			converged += chunkConverged;
+		}, threads);
+		results.Flush();
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		std::cout << "Solved " << solved << " jobs (" << converged << " converged) in " << seconds << " s";
+		if (seconds > 0.0) std::cout << ", " << static_cast<size_t>(solved / seconds) << " jobs/s";
+		std::cout << "\n";
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << "\n";
+		return 1;
+	}
+	return 0;
+}
+
+namespace
+{
+	void CompileExpressions(const BatchJobReader& jobs, size_t begin, size_t end, const std::shared_ptr<Logger>& logger,
+		std::vector<CompiledJobExpression>& compiled)
+	{
+		for (size_t job = begin; job < end; ++job)
+		{
+			const size_t i = jobs.GetJob(job).expressionIndex;
+			if (i >= compiled.size() || compiled[i].attempted) continue;
+			CompiledJobExpression& entry = compiled[i];
+			entry.attempted = true;
+			try
+			{
+				entry.function = std::make_unique<CompiledExpression>(jobs.GetExpression(i), logger);
+			}
+			catch (const std::exception& e)
+			{
+				std::cerr << "Expression " << i << " (" << jobs.GetExpression(i) << ") is invalid: " << e.what() << "\n";
+				continue;
+			}
+			entry.derivative = std::make_unique<CompiledExpression>(entry.function->Derivative());
+		}
+	}
+
+	SolveOptions JobOptions(const BatchJobRecord& job)
+	{
+		SolveOptions options = { job.maxSize, job.goalErr };
+		options.stepTol = 0.0;
+		options.relStepTol = 0.0;
+		options.stagnationLimit = 0;
+		options.cycleLength = 0;
+		options.divergenceLimit = 0;
+		options.maxEvaluations = 0;
+		return options;
+	}
+
+	void SolveJobs(const BatchJobReader& jobs, const std::vector<CompiledJobExpression>& compiled, BatchResultRecord* records,
+		size_t begin, size_t end, size_t& solved, size_t& converged)
+	{
+		for (size_t i = begin; i < end; ++i)
+		{
+			if (records[i].status != BATCH_PENDING) continue;
+
+			const BatchJobRecord& job = jobs.GetJob(i);
+			const CompiledJobExpression* expression = job.expressionIndex < compiled.size() ? &compiled[job.expressionIndex] : nullptr;
+			const SolveMethod method = static_cast<SolveMethod>(job.method);
+			if (expression == nullptr || !expression->function || job.maxSize <= 0 || (method == SolveMethod::ILLINOIS && std::isnan(job.secondGuess)))
+			{
+				records[i] = { job.initialGuess, 0, static_cast<int32_t>(SolveStatus::INVALID_INPUT) };
+				++solved;
+				continue;
+			}
+
+			const double secondGuess = std::isnan(job.secondGuess) ? solvers::OffsetGuess(job.initialGuess) : job.secondGuess;
+			SolveResult<double> result;
+			try
+			{
+				result = solvers::Solve(method,
+					[&](double x) { return expression->function->Evaluate(x); },
+					[&](double x) { return expression->derivative->Evaluate(x); },
+					job.initialGuess, secondGuess, JobOptions(job),
+					[](int, double) {});
+			}
+			catch (const std::invalid_argument&)
+			{
+				// unknown method
+				result = { job.initialGuess, 0, SolveStatus::INVALID_INPUT, 0, 0 };
+			}
+			records[i] = { result.root, result.iterations, static_cast<int32_t>(result.status) };
+			++solved;
+			if (result.status == SolveStatus::CONVERGED || result.status == SolveStatus::CONVERGED_STEP) ++converged;
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,176 @@
+// Implements the binary batch job and result files
+
+#include "pch.h"
+#include "BatchJobFile.h"
+
+#include <fstream>
+#include <stdexcept>
+
+namespace
+{
+	uint64_t AlignTo8(uint64_t offset);
+}
+
+BatchJobWriter::BatchJobWriter()
+{ }
+
+BatchJobWriter::~BatchJobWriter()
+{ }
+
+uint32_t BatchJobWriter::AddExpression(const std::string& expr)
+{
+	const auto found = expressionIndices.find(expr);
+	if (found != expressionIndices.end()) return found->second;
+
+	const uint32_t index = static_cast<uint32_t>(expressions.size());
+	expressions.push_back(expr);
+	expressionIndices.emplace(expr, index);
+	return index;
+}
+
+void BatchJobWriter::AddJob(const std::string& expr, double initialGuess, double goalErr, int maxSize, int method, double secondGuess)
+{
+	const uint32_t expressionIndex = AddExpression(expr);
+	jobs.push_back({ initialGuess, secondGuess, goalErr, expressionIndex, maxSize, method, 0 });
+}
+
+void BatchJobWriter::Write(const std::string& path) const
+{
+	BatchJobHeader header = {};
+	header.magic = BATCH_JOB_MAGIC;
+	header.version = BATCH_FORMAT_VERSION;
+	header.expressionCount = expressions.size();
+	header.jobCount = jobs.size();
+	header.expressionTableOffset = sizeof(BatchJobHeader);
+	header.stringsOffset = header.expressionTableOffset + expressions.size() * sizeof(BatchExpressionEntry);
+
+	std::vector<BatchExpressionEntry> table;
+	table.reserve(expressions.size());
+	uint64_t stringsSize = 0;
+	for (const std::string& expr : expressions)
+	{
+		table.push_back({ stringsSize, static_cast<uint32_t>(expr.size()), 0 });
+		stringsSize += expr.size();
+	}
+	header.jobsOffset = AlignTo8(header.stringsOffset + stringsSize);
+
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	if (!out) throw std::runtime_error("BatchJobWriter - unable to open " + path);
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	out.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(BatchExpressionEntry));
+	for (const std::string& expr : expressions) out.write(expr.data(), expr.size());
+	const char padding[8] = {};
+	out.write(padding, header.jobsOffset - (header.stringsOffset + stringsSize));
+	out.write(reinterpret_cast<const char*>(jobs.data()), jobs.size() * sizeof(BatchJobRecord));
+	if (!out) throw std::runtime_error("BatchJobWriter - unable to write " + path);
+}
+
+BatchJobReader::BatchJobReader(const std::string& path) :
+	file(std::make_unique<MappedFile>(path, false))
+{
+	const char* data = file->GetData();
+	const uint64_t size = file->GetSize();
+	if (size < sizeof(BatchJobHeader)) throw std::runtime_error("BatchJobReader - " + path + " is too small to be a job file");
+
+	header = reinterpret_cast<const BatchJobHeader*>(data);
+	if (header->magic != BATCH_JOB_MAGIC) throw std::runtime_error("BatchJobReader - " + path + " is not a job file");
+	if (header->version != BATCH_FORMAT_VERSION) throw std::runtime_error("BatchJobReader - " + path + " has unsupported version " + std::to_string(header->version));
+
+	// every table has to lie inside the file, checked so that large counts cannot overflow
+	const bool tableFits = header->expressionTableOffset <= size &&
+		header->expressionCount <= (size - header->expressionTableOffset) / sizeof(BatchExpressionEntry);
+	const bool jobsFit = header->jobsOffset <= size && header->jobsOffset % alignof(BatchJobRecord) == 0 &&
+		header->jobCount <= (size - header->jobsOffset) / sizeof(BatchJobRecord);
+	if (!tableFits || !jobsFit || header->stringsOffset > size) throw std::runtime_error("BatchJobReader - " + path + " is truncated or corrupt");
+
+	expressionTable = reinterpret_cast<const BatchExpressionEntry*>(data + header->expressionTableOffset);
+	strings = data + header->stringsOffset;
+	jobs = reinterpret_cast<const BatchJobRecord*>(data + header->jobsOffset);
+	for (size_t i = 0; i < header->expressionCount; ++i)
+	{
+		const BatchExpressionEntry& entry = expressionTable[i];
+		if (entry.offset > size - header->stringsOffset || entry.length > size - header->stringsOffset - entry.offset)
+			throw std::runtime_error("BatchJobReader - expression " + std::to_string(i) + " of " + path + " is out of bounds");
+	}
+}
+
+BatchJobReader::~BatchJobReader()
+{ }
+
+size_t BatchJobReader::GetJobCount() const
+{
+	return header->jobCount;
+}
+
+size_t BatchJobReader::GetExpressionCount() const
+{
+	return header->expressionCount;
+}
+
+std::string BatchJobReader::GetExpression(size_t index) const
+{
+	const BatchExpressionEntry& entry = expressionTable[index];
+	return std::string(strings + entry.offset, entry.length);
+}
+
+const BatchJobRecord& BatchJobReader::GetJob(size_t index) const
+{
+	return jobs[index];
+}
+
+BatchResultFile::BatchResultFile(const std::string& path, size_t jobCount) :
+	records(nullptr),
+	resumed(false)
+{
+	const size_t size = sizeof(BatchResultHeader) + jobCount * sizeof(BatchResultRecord);
+
+	// reuse the results of an earlier run over the same jobs
+	try
+	{
+		auto existing = std::make_unique<MappedFile>(path, true);
+		const BatchResultHeader* header = reinterpret_cast<const BatchResultHeader*>(existing->GetData());
+		resumed = existing->GetSize() == size && header->magic == BATCH_RESULT_MAGIC &&
+			header->version == BATCH_FORMAT_VERSION && header->jobCount == jobCount;
+		if (resumed) file = std::move(existing);
+	}
+	catch (const std::runtime_error&)
+	{
+		// no usable file yet
+	}
+
+	if (!resumed)
+	{
+		file = std::make_unique<MappedFile>(path, size);
+		BatchResultHeader* header = reinterpret_cast<BatchResultHeader*>(file->GetData());
+		*header = { BATCH_RESULT_MAGIC, BATCH_FORMAT_VERSION, jobCount, sizeof(BatchResultHeader), 0 };
+		BatchResultRecord* newRecords = reinterpret_cast<BatchResultRecord*>(file->GetData() + sizeof(BatchResultHeader));
+		for (size_t i = 0; i < jobCount; ++i) newRecords[i] = { 0.0, 0, BATCH_PENDING };
+	}
+	records = reinterpret_cast<BatchResultRecord*>(file->GetData() + sizeof(BatchResultHeader));
+}
+
+BatchResultFile::~BatchResultFile()
+{ }
+
+bool BatchResultFile::WasResumed() const
+{
+	return resumed;
+}
+
+BatchResultRecord* BatchResultFile::GetRecords() const
+{
+	return records;
+}
+
+void BatchResultFile::Flush()
+{
+	file->Flush();
+}
+
+namespace
+{
+	uint64_t AlignTo8(uint64_t offset)
+	{
+		return (offset + 7) & ~static_cast<uint64_t>(7);
+	}
+}
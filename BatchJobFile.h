@@ -0,0 +1,127 @@
+// Binary batch job and result files, laid out so they can be memory-mapped and used in place
+//
+// Job file: BatchJobHeader, then the expression table (expressionCount BatchExpressionEntry), then the expression
+// strings, then jobCount BatchJobRecord starting at jobsOffset. Each distinct expression is stored once
+// Result file: BatchResultHeader, then one BatchResultRecord per job, in the same order as the jobs
+// All values are little-endian and all offsets are from the start of the file
+#pragma once
+
+#include "MappedFile.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+const uint32_t BATCH_JOB_MAGIC = 0x4A424652; // "RFBJ"
+const uint32_t BATCH_RESULT_MAGIC = 0x52424652; // "RFBR"
+const uint32_t BATCH_FORMAT_VERSION = 2; // 2 added secondGuess to BatchJobRecord
+const int32_t BATCH_PENDING = -1; // status of a result that has not been solved yet
+const int32_t BATCH_WORKER_FAILED = -2; // status of a job that BatchCoordinator gave up on, after its worker crashed or hung on it twice
+
+struct BatchJobHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t expressionCount;
+	uint64_t jobCount;
+	uint64_t expressionTableOffset;
+	uint64_t stringsOffset;
+	uint64_t jobsOffset;
+};
+
+struct BatchExpressionEntry
+{
+	uint64_t offset; // from stringsOffset
+	uint32_t length;
+	uint32_t reserved;
+};
+
+struct BatchJobRecord
+{
+	double initialGuess;
+	double secondGuess; // the other end of the Illinois bracket, or the secant's second point. NaN puts it next to initialGuess,
+	                    // which Illinois cannot use, so an Illinois job with a NaN here is INVALID_INPUT
+	double goalErr;
+	uint32_t expressionIndex;
+	int32_t maxSize;
+	int32_t method; // SolveMethod
+	int32_t reserved;
+};
+
+struct BatchResultHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t jobCount;
+	uint64_t recordsOffset;
+	uint64_t reserved;
+};
+
+struct BatchResultRecord
+{
+	double root;
+	int32_t iterations;
+	int32_t status; // SolveStatus, BATCH_PENDING or BATCH_WORKER_FAILED
+};
+
+static_assert(sizeof(BatchJobHeader) == 48, "BatchJobHeader layout changed");
+static_assert(sizeof(BatchExpressionEntry) == 16, "BatchExpressionEntry layout changed");
+static_assert(sizeof(BatchJobRecord) == 40, "BatchJobRecord layout changed");
+static_assert(sizeof(BatchResultHeader) == 32, "BatchResultHeader layout changed");
+static_assert(sizeof(BatchResultRecord) == 16, "BatchResultRecord layout changed");
+
+// Collects jobs in memory, interning the expressions, and writes them out as a job file
+class BatchJobWriter
+{
+public:
+	BatchJobWriter();
+	~BatchJobWriter();
+
+	uint32_t AddExpression(const std::string& expr);
+	void AddJob(const std::string& expr, double initialGuess, double goalErr, int maxSize, int method, double secondGuess);
+
+	void Write(const std::string& path) const;
+private:
+	std::vector<std::string> expressions;
+	std::unordered_map<std::string, uint32_t> expressionIndices;
+	std::vector<BatchJobRecord> jobs;
+};
+
+// Maps a job file and checks that its tables fit inside the file
+class BatchJobReader
+{
+public:
+	BatchJobReader() = delete;
+	BatchJobReader(const std::string& path);
+	~BatchJobReader();
+
+	size_t GetJobCount() const;
+	size_t GetExpressionCount() const;
+	std::string GetExpression(size_t index) const;
+	const BatchJobRecord& GetJob(size_t index) const;
+private:
+	std::unique_ptr<MappedFile> file;
+	const BatchJobHeader* header;
+	const BatchExpressionEntry* expressionTable;
+	const char* strings;
+	const BatchJobRecord* jobs;
+};
+
+// Maps a result file for a given number of jobs. An existing file for the same number of jobs is reopened
+// as-is so a run can pick up where it stopped, otherwise a new one is created with every result pending
+class BatchResultFile
+{
+public:
+	BatchResultFile() = delete;
+	BatchResultFile(const std::string& path, size_t jobCount);
+	~BatchResultFile();
+
+	bool WasResumed() const;
+	BatchResultRecord* GetRecords() const;
+	void Flush();
+private:
+	std::unique_ptr<MappedFile> file;
+	BatchResultRecord* records;
+	bool resumed;
+};
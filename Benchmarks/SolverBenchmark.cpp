@@ -0,0 +1,361 @@
+// Compares the evaluation cost of Newton's Method against the derivative-free solvers over a fixed corpus
+// and the cost of the same Newton solve through a compiled expression and through a StaticExpression.h expression
+// and the cost of evaluating in lanes with the library math functions and with the fast approximations
+// and the cost of one evaluation in each of Expression's tiers
+// and the cost of a parameter sweep evaluated in full and incrementally
+// and the evaluations per root found by Newton's Method from a fixed guess and from automatically picked starts
+// and the cost of many Newton solves stepped together by the SolveScheduler.h schedulers against solving them one by one
+// Build as a console application together with BytecodeExpression.cpp, CompiledExpression.cpp, Expression.cpp,
+// IncrementalEvaluator.cpp, Interval.cpp and Logger.cpp
+
+#include "../pch.h"
+
+#include <algorithm>
+#include <chrono>
+#include "../Expression.h"
+#include "../IncrementalEvaluator.h"
+#include <iomanip>
+#include <iostream>
+#include "../Logger.h"
+#include <memory>
+#include "../SolveScheduler.h"
+#include "../Solvers.h"
+#include "../StaticExpression.h"
+#include <string>
+#include <vector>
+
+namespace
+{
+	struct CorpusEntry
+	{
+		const char* expr;
+		double initialGuess;
+		double secondGuess; // other end of a bracket around the root, used by the secant and Illinois methods
+	};
+
+	const CorpusEntry CORPUS[] =
+	{
+		{ "x^2-2", 1.1, 2.0 },
+		{ "x^3-2*x-5", 2.5, 2.0 },
+		{ "cos(x)-x", 1.0, 0.0 },
+		{ "e^x-3", 1.5, 0.0 },
+		{ "x*e^x-1", 1.0, 0.0 },
+		{ "ln(x)+x-2", 1.0, 2.0 },
+		{ "sin(x^2)-0.5", 0.9, 0.5 },
+		{ "tan(x)-x/2", 4.0, 4.4 },
+		{ "x^5-3*x^4+2*x^2-7", 3.0, 2.5 },
+		{ "(x^2+1)/(x+3)-2", 4.0, 3.0 },
+		{ "sin(x)*cos(x)-x/4", 1.2, 1.5 },
+		{ "x^x-5", 2.0, 3.0 },
+	};
+
+	const int REPETITIONS = 200;
+	const SolveOptions OPTIONS = { 1000, 1E-10 };
+
+	struct MethodTotals
+	{
+		const char* name;
+		int solved = 0;
+		long long iterations = 0;
+		long long functionEvaluations = 0;
+		long long derivativeEvaluations = 0;
+		long long nodesEvaluated = 0; // evaluations weighted by the size of the compiled expression
+		double seconds = 0.0;
+	};
+
+	const int STATIC_REPETITIONS = 100000;
+
+	const double FIXED_GUESS = 1.1; // what main.py starts from unless told otherwise
+	const double SEARCH_LO = -10.0;
+	const double SEARCH_HI = 10.0;
+	const int SEARCH_SAMPLES = 32;
+	const size_t SEARCH_STARTS = 4;
+
+	const size_t INTERLEAVED_ROUNDS = 1000; // how many times over the corpus is solved with every solve in flight at once
+
+	// expressions that FIXED_GUESS is a poor start for, solved together with the corpus
+	const char* const POOR_START_CORPUS[] =
+	{
+		"e^x-1000",
+		"x*e^(-x)-0.1",
+		"x^3-2*x+2",
+		"atan(x-5)",
+		"cos(x)+0.999",
+		"x^2-6*x+8.9",
+	};
+
+	// seconds per Newton solve, with nothing but the solve itself timed
+	template <typename Function, typename Derivative>
+	double TimeNewton(Function&& function, Derivative&& derivative, double initialGuess);
+	// nanoseconds per value for EvaluateLanes over a sweep of x
+	double TimeLanes(const CompiledExpression& function, MathAccuracy accuracy);
+	// nanoseconds per call of evaluate over a sweep of x
+	template <typename Evaluate>
+	double TimeEvaluations(Evaluate&& evaluate, int evaluationCount);
+}
+
+int main()
+{
+	auto logger = std::make_shared<Logger>("benchmark_log.txt");
+	auto ignore = [](int, double) {};
+
+	MethodTotals totals[] = { { "Newton" }, { "Secant" }, { "Steffensen" }, { "Illinois" } };
+	for (const CorpusEntry& entry : CORPUS)
+	{
+		for (MethodTotals& method : totals)
+		{
+			const SolveMethod solveMethod = static_cast<SolveMethod>(&method - totals);
+			SolveResult<double> result = {};
+			size_t derivativeNodes = 0;
+			size_t functionNodes = 0;
+
+			// time everything a call would do, including building the derivative for Newton's Method
+			const auto start = std::chrono::steady_clock::now();
+			for (int rep = 0; rep < REPETITIONS; ++rep)
+			{
+				try
+				{
+					auto function = Expression(entry.expr, logger);
+					const CompiledExpression& compiledFunction = function.Compile();
+					auto evaluate = [&](double x) { return compiledFunction.Evaluate(x); };
+					functionNodes = compiledFunction.GetNodes().size();
+					switch (solveMethod)
+					{
+					case SolveMethod::NEWTON:
+					{
+						const CompiledExpression compiledDerivative = compiledFunction.Derivative();
+						derivativeNodes = compiledDerivative.GetNodes().size();
+						result = solvers::Newton(evaluate, [&](double x) { return compiledDerivative.Evaluate(x); }, entry.initialGuess, OPTIONS, ignore);
+						break;
+					}
+					case SolveMethod::SECANT:
+						result = solvers::Secant(evaluate, entry.initialGuess, entry.secondGuess, OPTIONS, ignore);
+						break;
+					case SolveMethod::STEFFENSEN:
+						result = solvers::Steffensen(evaluate, entry.initialGuess, OPTIONS, ignore);
+						break;
+					case SolveMethod::ILLINOIS:
+						result = solvers::Illinois(evaluate, entry.initialGuess, entry.secondGuess, OPTIONS, ignore);
+						break;
+					}
+				}
+				catch (...)
+				{
+					// the derivative could not be found
+					result = { 0.0, 0, SolveStatus::ZERO_DERIVATIVE, 0, 0 };
+				}
+			}
+			const auto end = std::chrono::steady_clock::now();
+
+			method.seconds += std::chrono::duration<double>(end - start).count() / REPETITIONS;
+			if (result.status != SolveStatus::CONVERGED) continue;
+			++method.solved;
+			method.iterations += result.iterations;
+			method.functionEvaluations += result.functionEvaluations;
+			method.derivativeEvaluations += result.derivativeEvaluations;
+			method.nodesEvaluated += result.functionEvaluations * functionNodes + result.derivativeEvaluations * derivativeNodes;
+		}
+	}
+
+	const size_t corpusSize = sizeof(CORPUS) / sizeof(CORPUS[0]);
+	std::cout << std::left << std::setw(12) << "method" << std::right
+		<< std::setw(8) << "solved" << std::setw(12) << "iterations" << std::setw(10) << "f evals"
+		<< std::setw(10) << "f' evals" << std::setw(14) << "nodes evald" << std::setw(14) << "us / corpus" << "\n";
+	for (const MethodTotals& method : totals)
+	{
+		std::cout << std::left << std::setw(12) << method.name << std::right
+			<< std::setw(5) << method.solved << "/" << std::setw(2) << corpusSize
+			<< std::setw(12) << method.iterations << std::setw(10) << method.functionEvaluations
+			<< std::setw(10) << method.derivativeEvaluations << std::setw(14) << method.nodesEvaluated
+			<< std::setw(14) << std::fixed << std::setprecision(1) << method.seconds * 1E6 << "\n";
+	}
+
+	// Newton's Method over the corpus from one guess for everything, and from starts picked by sampling the way SolveForRootEx does
+	std::vector<const char*> guessCorpus;
+	for (const CorpusEntry& entry : CORPUS) guessCorpus.push_back(entry.expr);
+	guessCorpus.insert(guessCorpus.end(), std::begin(POOR_START_CORPUS), std::end(POOR_START_CORPUS));
+	int fixedRoots = 0;
+	int automaticRoots = 0;
+	long long fixedEvaluations = 0;
+	long long automaticEvaluations = 0;
+	long long automaticSamples = 0; // evaluations used picking the starts
+	for (const char* expr : guessCorpus)
+	{
+		auto function = Expression(expr, logger);
+		const CompiledExpression& compiledFunction = function.Compile();
+		const CompiledExpression compiledDerivative = compiledFunction.Derivative();
+		auto evaluate = [&](double x) { return compiledFunction.Evaluate(x); };
+		auto evaluateDerivative = [&](double x) { return compiledDerivative.Evaluate(x); };
+
+		const SolveResult<double> fixed = solvers::Newton(evaluate, evaluateDerivative, FIXED_GUESS, OPTIONS, ignore);
+		fixedEvaluations += fixed.functionEvaluations + fixed.derivativeEvaluations;
+		if (fixed.status == SolveStatus::CONVERGED) ++fixedRoots;
+
+		int sampleEvaluations = 0;
+		auto sample = [&](const double* xs, double* values, size_t count) { for (size_t i = 0; i < count; ++i) values[i] = evaluate(xs[i]); };
+		const std::vector<solvers::StartCandidate> starts = solvers::RankStarts(sample, evaluateDerivative, SEARCH_LO, SEARCH_HI, SEARCH_SAMPLES,
+			SEARCH_STARTS, sampleEvaluations, sampleEvaluations);
+		automaticSamples += sampleEvaluations;
+		if (starts.empty()) continue;
+		const SolveResult<double> automatic = solvers::SolveFromStarts(SolveMethod::NEWTON, evaluate, evaluateDerivative, starts, OPTIONS, sampleEvaluations, ignore);
+		automaticEvaluations += automatic.functionEvaluations + automatic.derivativeEvaluations;
+		if (automatic.status == SolveStatus::CONVERGED) ++automaticRoots;
+	}
+	std::cout << "\nNewton from " << FIXED_GUESS << ": " << fixedRoots << "/" << guessCorpus.size() << " roots, "
+		<< (fixedRoots > 0 ? static_cast<double>(fixedEvaluations) / fixedRoots : 0.0) << " evaluations per root\n";
+	std::cout << "Newton from sampled starts: " << automaticRoots << "/" << guessCorpus.size() << " roots, "
+		<< (automaticRoots > 0 ? static_cast<double>(automaticEvaluations) / automaticRoots : 0.0) << " evaluations per root, after "
+		<< (automaticRoots > 0 ? static_cast<double>(automaticSamples) / automaticRoots : 0.0) << " evaluations sampling\n";
+
+	// x^3-2*x-5, both ways
+	auto compiledFunction = CompiledExpression(CORPUS[1].expr, logger);
+	auto compiledDerivative = compiledFunction.Derivative();
+	const double compiledSeconds = TimeNewton([&](double x) { return compiledFunction.Evaluate(x); },
+		[&](double x) { return compiledDerivative.Evaluate(x); }, CORPUS[1].initialGuess);
+	constexpr auto staticFunction = staticexpr::pow(staticexpr::X, 3) - 2 * staticexpr::X - 5;
+	const double staticSeconds = TimeNewton(staticFunction, staticexpr::Derivative(staticFunction), CORPUS[1].initialGuess);
+	std::cout << "\nNewton on " << CORPUS[1].expr << ": compiled " << std::setprecision(3) << compiledSeconds * 1E9
+		<< " ns, static " << staticSeconds * 1E9 << " ns per solve\n";
+
+	auto transcendental = CompiledExpression("sin(x)*e^(x/10)+ln(x+2)-tan(x/3)", logger);
+	std::cout << "EvaluateLanes on sin(x)*e^(x/10)+ln(x+2)-tan(x/3): full " << TimeLanes(transcendental, MathAccuracy::FULL)
+		<< " ns, fast " << TimeLanes(transcendental, MathAccuracy::FAST) << " ns per value\n";
+
+	// x^5-3*x^4+2*x^2-7 in every tier, the interpreted one held there by never promoting it
+	auto interpreted = Expression(CORPUS[8].expr, logger);
+	interpreted.SetTierThresholds(SIZE_MAX, SIZE_MAX);
+	auto polynomial = CompiledExpression(CORPUS[8].expr, logger);
+	const BytecodeExpression bytecode(polynomial);
+	std::cout << "Evaluating " << CORPUS[8].expr << ": interpreted " << TimeEvaluations([&](double x) { return interpreted.Evaluate(x); }, 1000)
+		<< " ns, compiled " << TimeEvaluations([&](double x) { return polynomial.Evaluate(x); }, 1000000)
+		<< " ns, bytecode " << TimeEvaluations([&](double x) { return bytecode.Evaluate(x); }, 1000000) << " ns\n";
+
+	// sweeping a, which only the first term depends on, at a fixed x
+	auto model = CompiledExpression("a*x^2+sin(x)*e^(x/10)+ln(x+2)-tan(x/3)+cos(2*x)^3", logger, { "a" });
+	IncrementalEvaluator incremental(model);
+	std::cout << "Sweeping a in a*x^2+sin(x)*e^(x/10)+ln(x+2)-tan(x/3)+cos(2*x)^3: full "
+		<< TimeEvaluations([&](double a) { model.SetParameter(0, a); return model.Evaluate(0.7); }, 1000000)
+		<< " ns, incremental " << TimeEvaluations([&](double a) { model.SetParameter(0, a); return incremental.Evaluate(0.7); }, 1000000)
+		<< " ns per value\n";
+
+	// the corpus many times over, from guesses a little apart, solved one by one into an iterates array the way SolveForRoot
+	// does and as steppers all in flight at once. With half the steps, the priority scheduler spends them on the closest solves
+	std::vector<CompiledExpression> functions;
+	std::vector<CompiledExpression> derivatives;
+	functions.reserve(corpusSize);
+	derivatives.reserve(corpusSize);
+	for (const CorpusEntry& entry : CORPUS)
+	{
+		functions.push_back(CompiledExpression(entry.expr, logger));
+		derivatives.push_back(functions.back().Derivative());
+	}
+	const size_t interleavedCount = corpusSize * INTERLEAVED_ROUNDS;
+	auto makeStepper = [&](size_t i)
+	{
+		const CompiledExpression* function = &functions[i % corpusSize];
+		const CompiledExpression* derivative = &derivatives[i % corpusSize];
+		return solvers::NewtonStepper([function](double x) { return function->Evaluate(x); }, [derivative](double x) { return derivative->Evaluate(x); },
+			CORPUS[i % corpusSize].initialGuess + (i / corpusSize) * 1E-6, OPTIONS);
+	};
+	using Stepper = decltype(makeStepper(0));
+	auto never = [](size_t, const Stepper&) { return false; };
+	auto closest = [](const Stepper& stepper) { return -std::abs(stepper.GetFunctionValue()); };
+	auto makeSteppers = [&]()
+	{
+		std::vector<Stepper> steppers;
+		steppers.reserve(interleavedCount);
+		for (size_t i = 0; i < interleavedCount; ++i) steppers.push_back(makeStepper(i));
+		return steppers;
+	};
+	auto countConverged = [](const std::vector<Stepper>& steppers)
+	{
+		return std::count_if(steppers.begin(), steppers.end(), [](const Stepper& stepper)
+		{
+			return stepper.IsFinished() && stepper.GetResult().status == SolveStatus::CONVERGED;
+		});
+	};
+
+	std::vector<double> iterates(OPTIONS.maxSize + static_cast<size_t>(1));
+	std::vector<SolveResult<double>> blocking(interleavedCount);
+	auto start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < interleavedCount; ++i)
+	{
+		const CompiledExpression& function = functions[i % corpusSize];
+		const CompiledExpression& derivative = derivatives[i % corpusSize];
+		blocking[i] = solvers::Newton([&](double x) { return function.Evaluate(x); }, [&](double x) { return derivative.Evaluate(x); },
+			CORPUS[i % corpusSize].initialGuess + (i / corpusSize) * 1E-6, OPTIONS, [&](int iterNum, double x) { iterates[iterNum] = x; });
+	}
+	const double blockingSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	long long blockingSteps = 0;
+	for (const SolveResult<double>& result : blocking) blockingSteps += result.derivativeEvaluations;
+
+	start = std::chrono::steady_clock::now();
+	std::vector<Stepper> roundRobin = makeSteppers();
+	solvers::RunRoundRobin(roundRobin, never);
+	const double roundRobinSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	start = std::chrono::steady_clock::now();
+	std::vector<Stepper> byPriority = makeSteppers();
+	solvers::RunByPriority(byPriority, closest, never);
+	const double byPrioritySeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	size_t mismatches = 0;
+	for (size_t i = 0; i < interleavedCount; ++i)
+	{
+		const SolveResult<double>& result = roundRobin[i].GetResult();
+		if (result.root != blocking[i].root || result.iterations != blocking[i].iterations || result.status != blocking[i].status) ++mismatches;
+	}
+
+	std::vector<Stepper> budgetRoundRobin = makeSteppers();
+	solvers::RunRoundRobin(budgetRoundRobin, never, blockingSteps / 2);
+	std::vector<Stepper> budgetByPriority = makeSteppers();
+	solvers::RunByPriority(budgetByPriority, closest, never, blockingSteps / 2);
+	std::cout << "\n" << interleavedCount << " Newton solves: one by one " << blockingSeconds * 1E9 / interleavedCount << " ns, round robin "
+		<< roundRobinSeconds * 1E9 / interleavedCount << " ns, by priority " << byPrioritySeconds * 1E9 / interleavedCount << " ns per solve";
+	if (mismatches > 0) std::cout << ", " << mismatches << " stepped solves differ from Newton";
+	std::cout << "\nWith half of the " << blockingSteps << " steps: round robin converges " << countConverged(budgetRoundRobin)
+		<< ", by priority " << countConverged(budgetByPriority) << " of " << std::count_if(blocking.begin(), blocking.end(),
+		[](const SolveResult<double>& result) { return result.status == SolveStatus::CONVERGED; }) << "\n";
+	return 0;
+}
+
+namespace
+{
+	template <typename Function, typename Derivative>
+	double TimeNewton(Function&& function, Derivative&& derivative, double initialGuess)
+	{
+		volatile double sink = 0.0; // keeps the solves from being optimized away
+		const auto start = std::chrono::steady_clock::now();
+		for (int rep = 0; rep < STATIC_REPETITIONS; ++rep)
+		{
+			sink = sink + solvers::Newton(function, derivative, initialGuess + rep * 1E-12, OPTIONS, [](int, double) {}).root;
+		}
+		const auto end = std::chrono::steady_clock::now();
+		return std::chrono::duration<double>(end - start).count() / STATIC_REPETITIONS;
+	}
+
+	double TimeLanes(const CompiledExpression& function, MathAccuracy accuracy)
+	{
+		const size_t count = 1 << 16;
+		std::vector<double> xs(count);
+		std::vector<double> values(count);
+		for (size_t i = 0; i < count; ++i) xs[i] = 0.001 * static_cast<double>(i);
+		volatile double sink = 0.0;
+		const auto start = std::chrono::steady_clock::now();
+		for (int rep = 0; rep < 20; ++rep)
+		{
+			for (size_t i = 0; i < count; i += EVALUATION_LANES) function.EvaluateLanes(xs.data() + i, values.data() + i, accuracy);
+			sink = sink + values[rep];
+		}
+		const auto end = std::chrono::steady_clock::now();
+		return std::chrono::duration<double>(end - start).count() * 1E9 / (20.0 * count);
+	}
+
+	template <typename Evaluate>
+	double TimeEvaluations(Evaluate&& evaluate, int evaluationCount)
+	{
+		volatile double sink = 0.0;
+		const auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < evaluationCount; ++i) sink = sink + evaluate(1.0 + i * 1E-6);
+		const auto end = std::chrono::steady_clock::now();
+		return std::chrono::duration<double>(end - start).count() * 1E9 / evaluationCount;
+	}
+}
@@ -0,0 +1,108 @@
+// Implements BytecodeExpression
+
+#include "pch.h"
+#include "BytecodeExpression.h"
+
+#include <stdexcept>
+
+namespace
+{
+	bool IsConstantNode(const ExpressionNode& node, double value);
+}
+
+BytecodeExpression::BytecodeExpression(const CompiledExpression& compiled) :
+	parameterValues(compiled.GetParameterValues())
+{
+	// constants and parameters first, so the registers of the instructions follow on from them
+	const std::vector<ExpressionNode>& nodes = compiled.GetNodes();
+	if (nodes.empty()) throw std::invalid_argument("BytecodeExpression - nothing to translate for " + compiled.GetExpr());
+	std::vector<uint32_t> registers(nodes.size());
+	for (size_t i = 0; i < nodes.size(); ++i)
+	{
+		if (nodes[i].op == NodeOp::VARIABLE) registers[i] = 0;
+		if (nodes[i].op != NodeOp::CONSTANT) continue;
+		constants.push_back(nodes[i].value);
+		registers[i] = static_cast<uint32_t>(constants.size());
+	}
+	const size_t firstInstructionRegister = 1 + constants.size() + parameterValues->size();
+	for (size_t i = 0; i < nodes.size(); ++i)
+	{
+		if (nodes[i].op == NodeOp::PARAMETER) registers[i] = static_cast<uint32_t>(1 + constants.size() + nodes[i].lhs);
+	}
+
+	for (size_t i = 0; i < nodes.size(); ++i)
+	{
+		const ExpressionNode& node = nodes[i];
+		if (CompiledExpression::OperandCount(node.op) == 0) continue;
+
+		Instruction instruction = { BytecodeOp::CALL, node.op, registers[node.lhs], 0 };
+		switch (node.op)
+		{
+		case NodeOp::NEGATE: instruction.op = BytecodeOp::NEGATE; break;
+		case NodeOp::ADD: instruction.op = BytecodeOp::ADD; break;
+		case NodeOp::SUBTRACT: instruction.op = BytecodeOp::SUBTRACT; break;
+		case NodeOp::MULTIPLY: instruction.op = BytecodeOp::MULTIPLY; break;
+		case NodeOp::DIVIDE: instruction.op = BytecodeOp::DIVIDE; break;
+		case NodeOp::POWER:
+			if (IsConstantNode(nodes[node.rhs], 2.0)) instruction.op = BytecodeOp::SQUARE;
+			else if (IsConstantNode(nodes[node.rhs], -1.0)) instruction.op = BytecodeOp::RECIPROCAL;
+			break;
+		default:
+			break;
+		}
+		// binary operations read their second operand from rhs, unary ones never look at it
+		if (node.op != NodeOp::NEGATE && instruction.op != BytecodeOp::SQUARE && instruction.op != BytecodeOp::RECIPROCAL)
+		{
+			instruction.rhs = registers[node.rhs];
+		}
+		registers[i] = static_cast<uint32_t>(firstInstructionRegister + instructions.size());
+		instructions.push_back(instruction);
+	}
+	resultRegister = registers.back();
+}
+
+BytecodeExpression::~BytecodeExpression()
+{ }
+
+double BytecodeExpression::Evaluate(double x) const
+{
+	thread_local std::vector<double> values;
+	const std::vector<double>& parameters = *parameterValues;
+	values.resize(1 + constants.size() + parameters.size() + instructions.size());
+	double* const registers = values.data();
+	registers[0] = x;
+	for (size_t i = 0; i < constants.size(); ++i) registers[1 + i] = constants[i];
+	for (size_t i = 0; i < parameters.size(); ++i) registers[1 + constants.size() + i] = parameters[i];
+
+	double* result = registers + 1 + constants.size() + parameters.size();
+	for (const Instruction& instruction : instructions)
+	{
+		const double lhs = registers[instruction.lhs];
+		switch (instruction.op)
+		{
+		case BytecodeOp::NEGATE: *result = -lhs; break;
+		case BytecodeOp::ADD: *result = lhs + registers[instruction.rhs]; break;
+		case BytecodeOp::SUBTRACT: *result = lhs - registers[instruction.rhs]; break;
+		case BytecodeOp::MULTIPLY: *result = lhs * registers[instruction.rhs]; break;
+		case BytecodeOp::DIVIDE: *result = lhs / registers[instruction.rhs]; break;
+		case BytecodeOp::SQUARE: *result = lhs * lhs; break;
+		case BytecodeOp::RECIPROCAL: *result = 1.0 / lhs; break;
+		case BytecodeOp::CALL: *result = CompiledExpression::Apply(instruction.function, lhs, registers[instruction.rhs]); break;
+		}
+		++result;
+	}
+	return registers[resultRegister];
+}
+
+size_t BytecodeExpression::GetInstructionCount() const
+{
+	return instructions.size();
+}
+
+namespace
+{
+	bool IsConstantNode(const ExpressionNode& node, double value)
+	{
+		return node.op == NodeOp::CONSTANT && node.value == value;
+	}
+}
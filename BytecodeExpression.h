@@ -0,0 +1,48 @@
+// A CompiledExpression turned into register instructions for fast evaluation at real x
+// x, the constants and the parameters are loaded into the first registers, so their nodes disappear from the instruction list,
+// and the operands of every instruction are known registers with no checks on the kind of node
+// x^2 and x^-1 become x*x and 1/x, which are correctly rounded where pow can be an ulp out. Every other operation uses
+// the arithmetic of CompiledExpression, so apart from that last ulp the values are those of CompiledExpression::Evaluate
+#pragma once
+
+#include "CompiledExpression.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+enum class BytecodeOp
+{
+	NEGATE,
+	ADD,
+	SUBTRACT,
+	MULTIPLY,
+	DIVIDE,
+	SQUARE,
+	RECIPROCAL,
+	CALL // any other operation, through CompiledExpression::Apply
+};
+
+class BytecodeExpression
+{
+public:
+	BytecodeExpression() = delete;
+	explicit BytecodeExpression(const CompiledExpression& compiled);
+	~BytecodeExpression();
+
+	double Evaluate(double x) const;
+
+	size_t GetInstructionCount() const;
+private:
+	struct Instruction
+	{
+		BytecodeOp op;
+		NodeOp function; // only used by CALL
+		uint32_t lhs; // registers of the operands, the result goes to the next free register
+		uint32_t rhs;
+	};
+
+	std::vector<Instruction> instructions;
+	std::vector<double> constants; // registers 1 to constants.size(), register 0 is x
+	std::shared_ptr<std::vector<double>> parameterValues; // shared with the CompiledExpression, in the registers after the constants
+	uint32_t resultRegister;
+};
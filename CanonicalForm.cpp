@@ -0,0 +1,423 @@
+// Implements the canonical forms of compiled expressions
+
+#include "pch.h"
+#include "CanonicalForm.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <optional>
+#include <vector>
+
+namespace
+{
+	const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+	const uint64_t FNV_PRIME = 1099511628211ULL;
+	const double MAX_MERGED_EXPONENT = 1024.0; // integer powers up to this size are merged with their base's other factors
+
+	// base^exponent within a product. A fixed factor is a power with an exponent that cannot be merged, written out in base
+	struct Factor
+	{
+		std::string base;
+		double exponent;
+		bool fixed;
+	};
+
+	// coefficient * text within a sum, text being the product of the factors. text is empty for a constant
+	struct Term
+	{
+		std::string text;
+		double coefficient;
+		bool atomic;
+		std::vector<Factor> numerator;
+		std::vector<Factor> denominator;
+	};
+
+	// what a node reads as. An atomic form has no operator outside parentheses, so it can be an operand of anything
+	// value is set when the node comes out constant, so that what uses it folds the way the parser folds constants
+	// term is set when the node is a sum that came down to a single term, 2*x for x+x, so that a product can take its factors
+	// the way it would once the form is read back
+	struct Form
+	{
+		std::string text;
+		bool atomic;
+		std::optional<double> value;
+		std::optional<Term> term;
+	};
+
+	// works out the forms of the nodes of one expression, each at most once
+	class Canonicalizer
+	{
+	public:
+		Canonicalizer() = delete;
+		Canonicalizer(const CompiledExpression& expression);
+
+		const Form& FormOf(size_t index);
+	private:
+		Form Compute(size_t index);
+		Form SumForm(size_t index);
+		// adds the terms of the sum at index, times sign. Constant terms go to constants
+		void CollectTerms(size_t index, double sign, std::vector<Term>& terms, std::vector<double>& constants);
+		Term ProductTerm(size_t index);
+		// adds the factors of the product at index to the numerator, or to the denominator when inNumerator is false
+		void CollectFactors(size_t index, bool inNumerator, std::vector<Factor>& numerator, std::vector<Factor>& denominator,
+			std::vector<double>& multipliers, std::vector<double>& divisors);
+		std::string Atom(size_t index);
+
+		const std::vector<ExpressionNode>& nodes;
+		const std::vector<std::string>& parameterNames;
+		std::vector<std::optional<Form>> forms;
+	};
+
+	// the shortest text that reads back as exactly value. Non-finite values are written as divisions that fold back to them
+	std::string FormatConstant(double value);
+	Form ConstantForm(double value);
+	// whether x^exponent may be merged with other powers of x, which holds for integers
+	bool IsMergeableExponent(double exponent);
+	// the factors sorted and those with the same base multiplied together
+	std::vector<Factor> MergeFactors(std::vector<Factor> factors);
+	std::string FactorText(const Factor& factor);
+	// added or multiplied in sorted order, so the result does not depend on the order the values were written in
+	double SortedSum(std::vector<double> values);
+	double SortedProduct(std::vector<double> values);
+	const char* FunctionName(NodeOp op);
+}
+
+std::string canonical::Canonicalize(const CompiledExpression& expression)
+{
+	Canonicalizer canonicalizer(expression);
+	return canonicalizer.FormOf(expression.GetNodes().size() - 1).text;
+}
+
+uint64_t canonical::Hash(const std::string& form)
+{
+	uint64_t hash = FNV_OFFSET_BASIS;
+	for (const char c : form)
+	{
+		hash ^= static_cast<unsigned char>(c);
+		hash *= FNV_PRIME;
+	}
+	return hash;
+}
+
+size_t canonical::FormHash::operator()(const std::string& form) const
+{
+	return static_cast<size_t>(Hash(form));
+}
+
+namespace
+{
+	Canonicalizer::Canonicalizer(const CompiledExpression& expression) :
+		nodes(expression.GetNodes()),
+		parameterNames(expression.GetParameterNames()),
+		forms(expression.GetNodes().size())
+	{ }
+
+	const Form& Canonicalizer::FormOf(size_t index)
+	{
+		if (!forms[index]) forms[index] = Compute(index);
+		return *forms[index];
+	}
+
+	Form Canonicalizer::Compute(size_t index)
+	{
+		const ExpressionNode& node = nodes[index];
+		switch (node.op)
+		{
+		case NodeOp::VARIABLE:
+			return { "x", true };
+		case NodeOp::PARAMETER:
+			return { parameterNames.at(node.lhs), true };
+		case NodeOp::CONSTANT:
+		case NodeOp::NEGATE:
+		case NodeOp::ADD:
+		case NodeOp::SUBTRACT:
+		case NodeOp::MULTIPLY:
+		case NodeOp::DIVIDE:
+		case NodeOp::POWER:
+			return SumForm(index);
+		case NodeOp::MIN:
+		case NodeOp::MAX:
+		{
+			const Form& lhsForm = FormOf(node.lhs);
+			const Form& rhsForm = FormOf(node.rhs);
+			if (lhsForm.value && rhsForm.value) return ConstantForm(CompiledExpression::Apply(node.op, *lhsForm.value, *rhsForm.value));
+			// both commute
+			std::string lhs = lhsForm.text;
+			std::string rhs = rhsForm.text;
+			if (rhs < lhs) std::swap(lhs, rhs);
+			return { std::string(FunctionName(node.op)) + "(" + lhs + "," + rhs + ")", true };
+		}
+		default:
+		{
+			const Form& operand = FormOf(node.lhs);
+			if (operand.value) return ConstantForm(CompiledExpression::Apply(node.op, *operand.value, 0.0));
+			return { std::string(FunctionName(node.op)) + "(" + operand.text + ")", true };
+		}
+		}
+	}
+
+	Form Canonicalizer::SumForm(size_t index)
+	{
+		std::vector<Term> collected;
+		std::vector<double> constants;
+		CollectTerms(index, 1.0, collected, constants);
+
+		// like terms are added together
+		std::sort(collected.begin(), collected.end(), [](const Term& a, const Term& b)
+		{
+			return a.text < b.text || (a.text == b.text && a.coefficient < b.coefficient);
+		});
+		std::vector<Term> terms;
+		for (size_t first = 0; first < collected.size();)
+		{
+			size_t last = first;
+			std::vector<double> coefficients;
+			while (last < collected.size() && collected[last].text == collected[first].text) coefficients.push_back(collected[last++].coefficient);
+			// terms that cancel stay, as 0 times the term: 0*t is NaN wherever t is, so dropping it would change where the sum is defined
+			Term term = collected[first];
+			term.coefficient = SortedSum(coefficients);
+			terms.push_back(std::move(term));
+			first = last;
+		}
+		const double constant = SortedSum(constants);
+
+		if (terms.empty()) return ConstantForm(constant);
+		std::string text;
+		for (const Term& term : terms)
+		{
+			const double magnitude = std::abs(term.coefficient);
+			// a NaN is written without its sign, which does not read back
+			if (std::signbit(term.coefficient) && !std::isnan(term.coefficient)) text += "-";
+			else if (!text.empty()) text += "+";
+			if (magnitude == 1.0) text += term.text;
+			else if (term.text.compare(0, 2, "1/") == 0) text += FormatConstant(magnitude) + term.text.substr(1);
+			else text += FormatConstant(magnitude) + "*" + term.text;
+		}
+		if (constant != 0.0)
+		{
+			const std::string constantText = FormatConstant(constant);
+			text += constantText[0] == '-' ? constantText : "+" + constantText;
+		}
+		const bool single = terms.size() == 1 && constant == 0.0;
+		const bool atomic = single && terms[0].coefficient == 1.0 && terms[0].atomic;
+		return { text, atomic, std::nullopt, single ? std::optional<Term>(terms[0]) : std::nullopt };
+	}
+
+	void Canonicalizer::CollectTerms(size_t index, double sign, std::vector<Term>& terms, std::vector<double>& constants)
+	{
+		const ExpressionNode& node = nodes[index];
+		switch (node.op)
+		{
+		case NodeOp::ADD:
+			CollectTerms(node.lhs, sign, terms, constants);
+			CollectTerms(node.rhs, sign, terms, constants);
+			return;
+		case NodeOp::SUBTRACT:
+			CollectTerms(node.lhs, sign, terms, constants);
+			CollectTerms(node.rhs, -sign, terms, constants);
+			return;
+		case NodeOp::NEGATE:
+			CollectTerms(node.lhs, -sign, terms, constants);
+			return;
+		case NodeOp::CONSTANT:
+			constants.push_back(sign * node.value);
+			return;
+		default:
+		{
+			Term term = ProductTerm(index);
+			term.coefficient *= sign;
+			if (term.text.empty()) constants.push_back(term.coefficient);
+			else terms.push_back(term);
+			return;
+		}
+		}
+	}
+
+	Term Canonicalizer::ProductTerm(size_t index)
+	{
+		std::vector<Factor> numerator;
+		std::vector<Factor> denominator;
+		std::vector<double> multipliers;
+		std::vector<double> divisors;
+		CollectFactors(index, true, numerator, denominator, multipliers, divisors);
+		numerator = MergeFactors(numerator);
+		denominator = MergeFactors(denominator);
+
+		std::string text;
+		for (const Factor& factor : numerator) text += (text.empty() ? "" : "*") + FactorText(factor);
+		if (text.empty() && !denominator.empty()) text = "1";
+		for (const Factor& factor : denominator) text += "/" + FactorText(factor);
+		const bool atomic = numerator.size() == 1 && denominator.empty() && numerator[0].exponent == 1.0 && !numerator[0].fixed;
+		return { text, SortedProduct(multipliers) / SortedProduct(divisors), atomic, numerator, denominator };
+	}
+
+	void Canonicalizer::CollectFactors(size_t index, bool inNumerator, std::vector<Factor>& numerator, std::vector<Factor>& denominator,
+		std::vector<double>& multipliers, std::vector<double>& divisors)
+	{
+		const ExpressionNode& node = nodes[index];
+		switch (node.op)
+		{
+		case NodeOp::MULTIPLY:
+			CollectFactors(node.lhs, inNumerator, numerator, denominator, multipliers, divisors);
+			CollectFactors(node.rhs, inNumerator, numerator, denominator, multipliers, divisors);
+			return;
+		case NodeOp::DIVIDE:
+			CollectFactors(node.lhs, inNumerator, numerator, denominator, multipliers, divisors);
+			CollectFactors(node.rhs, !inNumerator, numerator, denominator, multipliers, divisors);
+			return;
+		case NodeOp::NEGATE:
+			// the sign is the same on either side of the division
+			multipliers.push_back(-1.0);
+			CollectFactors(node.lhs, inNumerator, numerator, denominator, multipliers, divisors);
+			return;
+		case NodeOp::CONSTANT:
+			(inNumerator ? multipliers : divisors).push_back(node.value);
+			return;
+		case NodeOp::POWER:
+		{
+			const std::optional<double> base = FormOf(node.lhs).value;
+			const std::optional<double> exponent = FormOf(node.rhs).value;
+			if (base && exponent)
+			{
+				(inNumerator ? multipliers : divisors).push_back(CompiledExpression::Apply(NodeOp::POWER, *base, *exponent));
+			}
+			else if (exponent && *exponent == 0.0)
+			{
+				// t^0 is 1 to the parser, whatever t is
+			}
+			else if (exponent && IsMergeableExponent(*exponent))
+			{
+				// x^-k is 1/x^k
+				const bool side = *exponent > 0 ? inNumerator : !inNumerator;
+				(side ? numerator : denominator).push_back({ Atom(node.lhs), std::abs(*exponent), false });
+			}
+			else if (base && *base == M_E)
+			{
+				(inNumerator ? numerator : denominator).push_back({ "exp(" + FormOf(node.rhs).text + ")", 1.0, false });
+			}
+			else
+			{
+				(inNumerator ? numerator : denominator).push_back({ Atom(node.lhs) + "^" + Atom(node.rhs), 1.0, true });
+			}
+			return;
+		}
+		default:
+		{
+			// sums are parenthesized, everything else is an atom already
+			const Form& form = FormOf(index);
+			if (form.value)
+			{
+				(inNumerator ? multipliers : divisors).push_back(*form.value);
+			}
+			else if (form.term)
+			{
+				(inNumerator ? multipliers : divisors).push_back(form.term->coefficient);
+				for (const Factor& factor : form.term->numerator) (inNumerator ? numerator : denominator).push_back(factor);
+				for (const Factor& factor : form.term->denominator) (inNumerator ? denominator : numerator).push_back(factor);
+			}
+			else
+			{
+				(inNumerator ? numerator : denominator).push_back({ Atom(index), 1.0, false });
+			}
+			return;
+		}
+		}
+	}
+
+	std::string Canonicalizer::Atom(size_t index)
+	{
+		const Form& form = FormOf(index);
+		return form.atomic ? form.text : "(" + form.text + ")";
+	}
+
+	std::string FormatConstant(double value)
+	{
+		if (value == 0.0) return "0"; // -0 as well
+		if (std::isnan(value)) return "(0/0)";
+		if (std::isinf(value)) return value > 0 ? "(1/0)" : "(-1/0)";
+		if (value == M_E) return "e";
+		if (std::abs(value) < 1E15 && value == std::floor(value)) return std::to_string(static_cast<long long>(value)); // the usual case, exact and quick
+		char buffer[32];
+		for (int precision = 15; precision <= 17; ++precision)
+		{
+			std::snprintf(buffer, sizeof(buffer), "%.*g", precision, value);
+			if (std::strtod(buffer, nullptr) == value) break;
+		}
+		return buffer;
+	}
+
+	Form ConstantForm(double value)
+	{
+		const std::string text = FormatConstant(value);
+		return { text, text[0] != '-', value };
+	}
+
+	bool IsMergeableExponent(double exponent)
+	{
+		return exponent != 0.0 && std::abs(exponent) <= MAX_MERGED_EXPONENT && exponent == std::floor(exponent);
+	}
+
+	std::vector<Factor> MergeFactors(std::vector<Factor> factors)
+	{
+		std::sort(factors.begin(), factors.end(), [](const Factor& a, const Factor& b)
+		{
+			return a.base < b.base || (a.base == b.base && a.exponent < b.exponent);
+		});
+		std::vector<Factor> merged;
+		for (const Factor& factor : factors)
+		{
+			// fixed factors have non-integer exponents, which cannot be added without changing where the product is defined
+			if (!merged.empty() && !factor.fixed && !merged.back().fixed && merged.back().base == factor.base) merged.back().exponent += factor.exponent;
+			else merged.push_back(factor);
+		}
+		return merged;
+	}
+
+	std::string FactorText(const Factor& factor)
+	{
+		return factor.exponent == 1.0 ? factor.base : factor.base + "^" + FormatConstant(factor.exponent);
+	}
+
+	double SortedSum(std::vector<double> values)
+	{
+		std::sort(values.begin(), values.end());
+		double sum = 0.0;
+		for (const double value : values) sum += value;
+		return sum;
+	}
+
+	double SortedProduct(std::vector<double> values)
+	{
+		std::sort(values.begin(), values.end());
+		double product = 1.0;
+		for (const double value : values) product *= value;
+		return product;
+	}
+
+	const char* FunctionName(NodeOp op)
+	{
+		switch (op)
+		{
+		case NodeOp::SIN: return "sin";
+		case NodeOp::COS: return "cos";
+		case NodeOp::TAN: return "tan";
+		case NodeOp::LN: return "ln";
+		case NodeOp::EXP: return "exp";
+		case NodeOp::SQRT: return "sqrt";
+		case NodeOp::ABS: return "abs";
+		case NodeOp::ATAN: return "atan";
+		case NodeOp::ASIN: return "asin";
+		case NodeOp::ACOS: return "acos";
+		case NodeOp::SINH: return "sinh";
+		case NodeOp::COSH: return "cosh";
+		case NodeOp::TANH: return "tanh";
+		case NodeOp::LOG10: return "log10";
+		case NodeOp::MIN: return "min";
+		case NodeOp::MAX: return "max";
+		case NodeOp::SIGN: return "sgn";
+		default: return "?";
+		}
+	}
+}
@@ -0,0 +1,26 @@
+// Canonical text of a compiled expression, so that the same function written in different ways can be recognised
+// Sums and products are flattened and their operands sorted, constants are folded into one term or coefficient and
+// written the shortest way that reads back exactly, repeated factors become integer powers (x*x is x^2), negative integer
+// powers become divisions, e^t is exp(t) and the operands of min and max are sorted. Whitespace and parentheses are not
+// kept. Terms that cancel stay, with the coefficient 0. Expressions with the same canonical form have the same value for every x,
+// up to rounding, and a canonical form reads back as itself
+#pragma once
+
+#include "CompiledExpression.h"
+#include <cstdint>
+#include <string>
+
+namespace canonical
+{
+	// the canonical form, itself an expression CompiledExpression can parse as long as its constants are finite
+	std::string Canonicalize(const CompiledExpression& expression);
+
+	// FNV-1a hash of a canonical form, the same in every process and on every platform so it may be stored
+	uint64_t Hash(const std::string& form);
+
+	// for keying containers by canonical form
+	struct FormHash
+	{
+		size_t operator()(const std::string& form) const;
+	};
+};
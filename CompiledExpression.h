@@ -0,0 +1,147 @@
+// Parses an expression string once into a flat list of nodes that can be evaluated many times
+// Nodes are hash-consed: a subexpression that appears more than once is stored, and evaluated, only once, which
+// keeps derivatives (and derivatives of derivatives) from growing out of hand
+#pragma once
+
+#include "Logger.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+enum class NodeOp
+{
+	CONSTANT,
+	VARIABLE,
+	NEGATE,
+	ADD,
+	SUBTRACT,
+	MULTIPLY,
+	DIVIDE,
+	POWER,
+	SIN,
+	COS,
+	TAN,
+	LN,
+	EXP,
+	SQRT,
+	ABS,
+	ATAN,
+	ASIN,
+	ACOS,
+	SINH,
+	COSH,
+	TANH,
+	LOG10,
+	MIN,
+	MAX,
+	SIGN,
+	PARAMETER
+};
+
+// how library functions are evaluated
+enum class MathAccuracy
+{
+	FULL, // the standard library
+	FAST // exp, ln, sin, cos, tan and powers through the polynomial kernels in FastMath.h, see there for their error bounds
+};
+
+const size_t EVALUATION_LANES = 8; // values of x evaluated together by CompiledExpression::EvaluateLanes
+
+struct ExpressionNode
+{
+	NodeOp op;
+	size_t lhs; // index of the first operand, only used by unary and binary operations. For parameters the parameter's index
+	size_t rhs; // index of the second operand, only used by binary operations
+	double value; // only used by constants
+};
+
+class CompiledExpression
+{
+public:
+	CompiledExpression() = delete;
+	// parameterNamesIn are names that stand for values set with SetParameter, such as the coefficients of a model
+	// a name is letters, digits and underscores starting with a letter, and may not be x, e or a function name
+	// in the expression a parameter has to be separated from what follows, so a times x is a*x and not ax
+	CompiledExpression(const std::string& inputExpr, const std::shared_ptr<Logger>& loggerIn, const std::vector<std::string>& parameterNamesIn = {});
+	// takes nodes compiled earlier, such as ones read back from an ExpressionLibrary, checking they are well formed
+	CompiledExpression(const std::string& inputExpr, std::vector<ExpressionNode> inputNodes, const std::shared_ptr<Logger>& loggerIn);
+	~CompiledExpression();
+
+	// T may be double, std::complex<double> or Interval
+	template <typename T>
+	T Evaluate(T x) const;
+	double Evaluate(double x, MathAccuracy accuracy) const;
+
+	// evaluates at EVALUATION_LANES values of x at once, results[i] is the value at xs[i]
+	// every node is applied to all the lanes before moving on to the next node, so the dispatch on the node
+	// is paid once per lane group and the arithmetic runs as SIMD loops over the lanes
+	void EvaluateLanes(const double* xs, double* results, MathAccuracy accuracy = MathAccuracy::FULL) const;
+
+	// the derivative with respect to x, built node by node on top of this expression's nodes so it shares them
+	// calling it again on the result gives higher derivatives, each one only a few nodes per node bigger
+	CompiledExpression Derivative() const;
+
+	// applies one unary or binary operation to real operands, with the same arithmetic Evaluate uses
+	static double Apply(NodeOp op, double lhs, double rhs);
+	// 0 for constants, x and parameters, 1 for unary operations and 2 for binary ones
+	static int OperandCount(NodeOp op);
+
+	// parameters start at 0. Copies of an expression, including its derivatives, share its parameter values, so setting
+	// one sets it for all of them. Parameters should not be set while another thread is evaluating the expression
+	void SetParameter(const std::string& name, double value);
+	void SetParameter(size_t index, double value);
+	double GetParameter(size_t index) const;
+	// throws std::invalid_argument for a name that is not a parameter
+	size_t GetParameterIndex(const std::string& name) const;
+	const std::vector<std::string>& GetParameterNames() const;
+	// the values of all the parameters by index, for evaluators built on top of this expression
+	const std::shared_ptr<std::vector<double>>& GetParameterValues() const;
+
+	const std::string& GetExpr() const;
+	const std::vector<ExpressionNode>& GetNodes() const;
+private:
+	size_t ParseSum(size_t& position);
+	size_t ParseProduct(size_t& position);
+	size_t ParseFactor(size_t& position);
+	size_t ParsePower(size_t& position);
+	size_t ParseSignedAtom(size_t& position);
+	size_t ParseAtom(size_t& position);
+	size_t ParseNumber(size_t& position);
+	bool MatchParameter(size_t& position, size_t& index) const;
+	bool StartsAtom(size_t position) const;
+	bool MatchKeyword(size_t& position, const char* keyword) const;
+	void SkipWhitespace(size_t& position) const;
+
+	// adds a node, or finds the identical one already there. Constants are folded and operations with 0 and 1
+	// that do nothing are skipped, in which case the index of the simpler equivalent node is returned
+	// 0*t and 0/t only fold to 0 while Derivative builds nodes, elsewhere they keep the NaN that t may bring
+	size_t AddNode(NodeOp op, size_t lhs, size_t rhs, double value);
+	size_t AddConstant(double value);
+	bool IsConstant(size_t index, double value) const;
+	// drops the nodes that root does not depend on, leaving root as the last node
+	void Compact(size_t root);
+
+	struct NodeKey
+	{
+		NodeOp op;
+		size_t lhs;
+		size_t rhs;
+		uint64_t valueBits;
+		bool operator==(const NodeKey& other) const;
+	};
+	struct NodeKeyHash
+	{
+		size_t operator()(const NodeKey& key) const;
+	};
+	static NodeKey KeyOf(const ExpressionNode& node);
+
+	std::string expr;
+	std::vector<ExpressionNode> nodes; // operands always appear before the node that uses them
+	std::unordered_map<NodeKey, size_t, NodeKeyHash> nodeIndices; // for finding identical nodes
+	std::vector<std::string> parameterNames;
+	std::shared_ptr<std::vector<double>> parameterValues;
+	std::shared_ptr<Logger> logger;
+	bool buildingDerivative = false; // set by Derivative while it adds nodes, whose products with 0 are all from constant rules
+};
@@ -0,0 +1,216 @@
+// Watches the iterates of a solve and decides when continuing is pointless
+// T may be double or std::complex<double>, only magnitudes and distances are used
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <vector>
+
+enum class SolveStatus
+{
+	CONVERGED,
+	MAX_ITERATIONS,
+	ZERO_DERIVATIVE,
+	NO_BRACKET,
+	CONVERGED_STEP,
+	STAGNATED,
+	CYCLING,
+	NOT_FINITE,
+	DIVERGED,
+	INVALID_INPUT,
+	CANCELLED,
+	TIMED_OUT,
+	BUDGET_EXHAUSTED
+};
+
+// lets one thread stop solves running on others. Solves check it between steps, so they stop within one step
+class CancellationToken
+{
+public:
+	void Cancel() { cancelled.store(true, std::memory_order_relaxed); }
+	bool IsCancelled() const { return cancelled.load(std::memory_order_relaxed); }
+private:
+	std::atomic<bool> cancelled{ false };
+};
+
+struct SolveOptions
+{
+	int maxSize; // maximum number of iterations
+	double goalErr; // stop once |f(x)| drops to this value
+	double stepTol = 0.0; // stop once |x[n+1] - x[n]| drops to this value, 0 disables
+	double relStepTol = 0.0; // stop once |x[n+1] - x[n]| <= relStepTol * |x[n+1]|, 0 disables
+	int stagnationLimit = 10; // give up after this many iterations without |f(x)| improving on the recent iterates, 0 disables
+	int cycleLength = 8; // look for the iterates repeating with a period of up to this many iterations, 0 disables
+	int divergenceLimit = 10; // give up after this many iterations in a row where |x| at least doubles, or once |x| is past 1E150, 0 disables
+	int maxEvaluations = 0; // stop before a step once this many function and derivative evaluations were used, 0 disables
+	std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max(); // stop once this time has passed
+	const CancellationToken* cancellation = nullptr; // stop once this is cancelled, nullptr disables
+};
+
+// whether a solve with function value funcVal has reached the goal, never for NaN
+// every solver stops on this, so that they agree on what converged means
+template <typename T>
+bool IsConverged(const T& funcVal, const SolveOptions& options)
+{
+	return std::abs(funcVal) <= options.goalErr;
+}
+
+template <typename T>
+class ConvergenceMonitor
+{
+public:
+	ConvergenceMonitor() = delete;
+	ConvergenceMonitor(const SolveOptions& optionsIn) :
+		options(optionsIn),
+		history(optionsIn.cycleLength > 0 ? optionsIn.cycleLength + 1 : 0),
+		recentFuncMags(optionsIn.stagnationLimit > 0 ? (optionsIn.stagnationLimit + 1) / 2 : 0)
+	{ }
+
+	// records the start of the solve
+	// returns true if the solve should not go any further, because x or funcVal is not finite, and sets reason to why
+	bool Start(const T& x, const T& funcVal, SolveStatus& reason)
+	{
+		lastMag = std::abs(x);
+		Remember(x);
+		if (!std::isfinite(lastMag) || !std::isfinite(std::abs(funcVal)))
+		{
+			reason = SolveStatus::NOT_FINITE;
+			return true;
+		}
+		return false;
+	}
+
+	// checks a new iterate x, reached by taking step from the previous one, with function value funcVal
+	// returns true if the solve should stop now, and sets reason to why
+	bool Update(const T& x, const T& step, const T& funcVal, SolveStatus& reason)
+	{
+		const double xMag = std::abs(x);
+		const double stepMag = std::abs(step);
+		const double funcMag = std::abs(funcVal);
+
+		if (!std::isfinite(xMag) || !std::isfinite(funcMag))
+		{
+			reason = SolveStatus::NOT_FINITE;
+			return true;
+		}
+		if (IsConverged(funcVal, options))
+		{
+			// the caller's loop will finish on this
+			reason = SolveStatus::CONVERGED;
+			return false;
+		}
+		if ((options.stepTol > 0.0 && stepMag <= options.stepTol) || (options.relStepTol > 0.0 && stepMag <= options.relStepTol * xMag))
+		{
+			reason = SolveStatus::CONVERGED_STEP;
+			return true;
+		}
+		if (stepMag == 0.0)
+		{
+			// not moving, and not at a root either
+			reason = SolveStatus::STAGNATED;
+			return true;
+		}
+
+		// stagnation, |f(x)| has stopped improving, typically at the precision floor of the evaluator
+		// progress is against the best of the last half limit of iterates, the start not among them, rather than the best ever:
+		// after a step that overshoots far, the window soon holds only iterates past it, and working back down counts
+		if (!recentFuncMags.empty())
+		{
+			const double recentBest = storedFuncMags == 0 ? HUGE_VAL : *std::min_element(recentFuncMags.begin(), recentFuncMags.begin() + storedFuncMags);
+			if (funcMag < recentBest * (1.0 - STAGNATION_IMPROVEMENT))
+			{
+				iterationsWithoutImprovement = 0;
+			}
+			else if (++iterationsWithoutImprovement >= options.stagnationLimit)
+			{
+				reason = SolveStatus::STAGNATED;
+				return true;
+			}
+			recentFuncMags[nextFuncMag] = funcMag;
+			nextFuncMag = (nextFuncMag + 1) % recentFuncMags.size();
+			if (storedFuncMags < recentFuncMags.size()) ++storedFuncMags;
+		}
+
+		// cycles, x is back where it was a few iterations ago even though the last step was not small
+		const double cycleTol = CYCLE_TOLERANCE * (xMag + 1.0);
+		if (stepMag > cycleTol)
+		{
+			for (size_t period = 2; period <= stored && period < history.size(); ++period)
+			{
+				const T& earlier = history[(next + history.size() - period) % history.size()];
+				if (std::abs(x - earlier) <= cycleTol)
+				{
+					reason = SolveStatus::CYCLING;
+					return true;
+				}
+			}
+		}
+		Remember(x);
+
+		// divergence, |x| keeps growing geometrically
+		if (xMag >= DIVERGENCE_GROWTH * lastMag && xMag > 1.0) ++growingIterations;
+		else growingIterations = 0;
+		lastMag = xMag;
+		if (options.divergenceLimit > 0 && (growingIterations >= options.divergenceLimit || xMag > DIVERGENCE_MAGNITUDE))
+		{
+			reason = SolveStatus::DIVERGED;
+			return true;
+		}
+
+		return false;
+	}
+
+	// checks the limits that do not depend on the iterates, before every step
+	// evaluations is the number of function and derivative evaluations used so far
+	// returns true if the solve should stop now, and sets reason to why
+	bool Interrupted(int evaluations, SolveStatus& reason)
+	{
+		if (options.maxEvaluations > 0 && evaluations >= options.maxEvaluations)
+		{
+			reason = SolveStatus::BUDGET_EXHAUSTED;
+			return true;
+		}
+		if (options.cancellation != nullptr && options.cancellation->IsCancelled())
+		{
+			reason = SolveStatus::CANCELLED;
+			return true;
+		}
+		// reading the clock costs about as much as evaluating a small expression, so only every few steps
+		if (options.deadline != std::chrono::steady_clock::time_point::max() && checks++ % DEADLINE_CHECK_INTERVAL == 0 &&
+			std::chrono::steady_clock::now() >= options.deadline)
+		{
+			reason = SolveStatus::TIMED_OUT;
+			return true;
+		}
+		return false;
+	}
+private:
+	void Remember(const T& x)
+	{
+		if (history.empty()) return;
+		history[next] = x;
+		next = (next + 1) % history.size();
+		if (stored < history.size()) ++stored;
+	}
+
+	static constexpr double STAGNATION_IMPROVEMENT = 1E-3; // relative improvement of |f(x)| needed to count as progress
+	static constexpr double CYCLE_TOLERANCE = 1E-10; // relative distance at which two iterates are treated as the same point
+	static constexpr double DIVERGENCE_GROWTH = 2.0;
+	static constexpr double DIVERGENCE_MAGNITUDE = 1E150; // anything past this is diverging no matter how it got there
+	static constexpr int DEADLINE_CHECK_INTERVAL = 16; // steps between looks at the clock, the first step always looks
+
+	const SolveOptions options;
+	std::vector<T> history; // ring buffer of the most recent iterates, including the current one
+	size_t next = 0;
+	size_t stored = 0;
+	std::vector<double> recentFuncMags; // ring buffer of |f(x)| at the most recent iterates, for the stagnation check
+	size_t nextFuncMag = 0;
+	size_t storedFuncMags = 0;
+	double lastMag = 0.0;
+	int iterationsWithoutImprovement = 0;
+	int growingIterations = 0;
+	int checks = 0;
+};
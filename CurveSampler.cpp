@@ -0,0 +1,142 @@
+// Implements adaptive sampling of curves
+
+#include "pch.h"
+#include "CurveSampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include "Parallel.h"
+#include <stdexcept>
+
+namespace
+{
+	const size_t GRID_SHARE = 4; // one point in this many goes to the even grid, the rest to refining it
+	const size_t MIN_GRID_POINTS = 16;
+	const double MIN_WIDTH = 1E-9; // intervals narrower than this fraction of the range are not split
+	const double SCALE_QUANTILE = 0.05; // the spread of the values is taken between this quantile and its mirror, ignoring poles
+	const size_t CHUNK_SIZE = 256; // points evaluated together by one thread
+
+	// an interval between two samples, by their indices, and how far it is from straight
+	struct Span
+	{
+		size_t left;
+		size_t right;
+		double error;
+	};
+
+	// evaluates function at count points, in lanes and across all cores
+	void EvaluatePoints(const CompiledExpression& function, const double* xs, size_t count, double* values);
+	// the spread of the finite values, between the quantiles, or 1 when they are all the same
+	double ValueScale(std::vector<double> values);
+	// how far the middle value is from the straight line through the outer two, relative to scale
+	// infinite where a value is missing next to one that is not, a pole or the edge of the domain, 0 where all three are missing
+	double Deviation(double xLeft, double fLeft, double xMiddle, double fMiddle, double xRight, double fRight, double scale);
+}
+
+void sampling::SampleCurve(const CompiledExpression& function, double lo, double hi, size_t maxPoints, double tolerance,
+	std::vector<double>& xs, std::vector<double>& values)
+{
+	if (!std::isfinite(lo) || !std::isfinite(hi) || !(hi > lo) || maxPoints < 2)
+		throw std::invalid_argument("SampleCurve - needs a finite, non-empty range and at least 2 points");
+
+	const size_t gridCount = std::min(maxPoints, std::max(MIN_GRID_POINTS, maxPoints / GRID_SHARE));
+	xs.resize(gridCount);
+	values.resize(gridCount);
+	for (size_t i = 0; i < gridCount; ++i) xs[i] = lo + (hi - lo) * static_cast<double>(i) / static_cast<double>(gridCount - 1);
+	xs.back() = hi;
+	EvaluatePoints(function, xs.data(), gridCount, values.data());
+	const double scale = ValueScale(values);
+	const double minWidth = (hi - lo) * MIN_WIDTH;
+
+	// on the grid, an interval is as far from straight as the curve bends at either end
+	std::vector<double> bends(gridCount, 0.0);
+	for (size_t i = 1; i + 1 < gridCount; ++i) bends[i] = Deviation(xs[i - 1], values[i - 1], xs[i], values[i], xs[i + 1], values[i + 1], scale);
+	std::vector<Span> open;
+	for (size_t i = 0; i + 1 < gridCount; ++i)
+	{
+		const double error = std::max(bends[i], bends[i + 1]);
+		if (error > tolerance) open.push_back({ i, i + 1, error });
+	}
+
+	while (!open.empty() && xs.size() < maxPoints)
+	{
+		// when the points left cannot split every interval, the worst ones go first
+		const size_t budget = maxPoints - xs.size();
+		if (open.size() > budget)
+		{
+			std::nth_element(open.begin(), open.begin() + budget, open.end(), [](const Span& a, const Span& b) { return a.error > b.error; });
+			open.resize(budget);
+		}
+
+		const size_t first = xs.size();
+		for (const Span& span : open) xs.push_back(0.5 * (xs[span.left] + xs[span.right]));
+		values.resize(xs.size());
+		EvaluatePoints(function, xs.data() + first, open.size(), values.data() + first);
+
+		std::vector<Span> next;
+		for (size_t i = 0; i < open.size(); ++i)
+		{
+			const Span& span = open[i];
+			const size_t middle = first + i;
+			const double error = Deviation(xs[span.left], values[span.left], xs[middle], values[middle], xs[span.right], values[span.right], scale);
+			if (error <= tolerance || xs[middle] - xs[span.left] <= minWidth) continue;
+			next.push_back({ span.left, middle, error });
+			next.push_back({ middle, span.right, error });
+		}
+		open.swap(next);
+	}
+
+	// the midpoints were appended, put everything in order of x
+	std::vector<size_t> order(xs.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return xs[a] < xs[b]; });
+	std::vector<double> sortedXs(xs.size());
+	std::vector<double> sortedValues(xs.size());
+	for (size_t i = 0; i < order.size(); ++i)
+	{
+		sortedXs[i] = xs[order[i]];
+		sortedValues[i] = values[order[i]];
+	}
+	xs.swap(sortedXs);
+	values.swap(sortedValues);
+}
+
+namespace
+{
+	void EvaluatePoints(const CompiledExpression& function, const double* xs, size_t count, double* values)
+	{
+		const size_t chunks = (count + CHUNK_SIZE - 1) / CHUNK_SIZE;
+		parallel::ParallelFor(chunks, [&](size_t chunk)
+		{
+			const size_t end = std::min(count, (chunk + 1) * CHUNK_SIZE);
+			size_t i = chunk * CHUNK_SIZE;
+			for (; i + EVALUATION_LANES <= end; i += EVALUATION_LANES) function.EvaluateLanes(xs + i, values + i);
+			for (; i < end; ++i) values[i] = function.Evaluate(xs[i]);
+		});
+	}
+
+	double ValueScale(std::vector<double> values)
+	{
+		values.erase(std::remove_if(values.begin(), values.end(), [](double value) { return !std::isfinite(value); }), values.end());
+		if (values.empty()) return 1.0;
+		std::sort(values.begin(), values.end());
+		const size_t low = static_cast<size_t>(SCALE_QUANTILE * (values.size() - 1));
+		const size_t high = values.size() - 1 - low;
+		const double spread = values[high] - values[low];
+		if (spread > 0.0) return spread;
+		// flat apart from a few outliers, or constant
+		const double fullSpread = values.back() - values.front();
+		return fullSpread > 0.0 ? fullSpread : 1.0;
+	}
+
+	double Deviation(double xLeft, double fLeft, double xMiddle, double fMiddle, double xRight, double fRight, double scale)
+	{
+		const int finite = std::isfinite(fLeft) + std::isfinite(fMiddle) + std::isfinite(fRight);
+		if (finite == 0) return 0.0;
+		if (finite < 3) return HUGE_VAL;
+		const double t = (xMiddle - xLeft) / (xRight - xLeft);
+		const double line = fLeft + t * (fRight - fLeft);
+		return std::abs(fMiddle - line) / scale;
+	}
+}
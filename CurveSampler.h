@@ -0,0 +1,18 @@
+// Samples an expression adaptively for plotting: more points where the curve bends or jumps, few where it is straight
+#pragma once
+
+#include "CompiledExpression.h"
+#include <vector>
+
+namespace sampling
+{
+	// samples function over [lo, hi] at no more than maxPoints points, storing them sorted by x in xs and values
+	// starts from an even grid, then keeps splitting the intervals whose midpoint is furthest off the straight line between
+	// their ends, worst first, until every interval is within tolerance of straight or the points run out. tolerance is relative
+	// to the spread of the function's values over the grid, so 1E-3 is about a pixel on a plot 1000 pixels high.
+	// Near poles and the edges of the domain intervals are split until they are a billionth of the range wide
+	// each round of midpoints is evaluated in lanes, across all cores when there are enough of them. function must not log
+	// while this runs
+	void SampleCurve(const CompiledExpression& function, double lo, double hi, size_t maxPoints, double tolerance,
+		std::vector<double>& xs, std::vector<double>& values);
+};
@@ -1,30 +1,94 @@
 #include "pch.h"
 #include "Expression.h"
 
+#include <algorithm>
+#include <chrono>
 #include <ctype.h>
+#include <limits>
 #include <math.h>
 #include <regex>
+#include <stdio.h>
 #include <string.h>
 
 namespace
 {
+	const size_t DEFAULT_COMPILE_AFTER = 32; // a few Newton solves' worth, the string evaluator takes microseconds per call
+	const size_t DEFAULT_BYTECODE_AFTER = 1024;
+	const size_t NEVER = std::numeric_limits<size_t>::max();
+	const size_t AGREEMENT_CHECKS = 4; // the last interpreted values the compiled form has to reproduce before it takes over
+	const double AGREEMENT_TOLERANCE = 1E-9; // relative to the values, or absolute below 1
+	const char NEGATIVE_VALUE = '~'; // the sign of a value the evaluator wrote in itself, so a '-' is always one from the expression
+
+	// a function of one value, and its derivative in terms of its operand $ and the operand's derivative #
+	// a derivative without # is multiplied by the operand's derivative (the chain rule)
+	struct SpecialFunction
+	{
+		const char* name;
+		double (*func)(double);
+		const char* derivative;
+	};
+
+	// longer names first where one starts with another
+	const SpecialFunction SPECIAL_FUNCTIONS[] = {
+		{ "sinh", [](double x) { return std::sinh(x); }, "cosh$" },
+		{ "cosh", [](double x) { return std::cosh(x); }, "sinh$" },
+		{ "tanh", [](double x) { return std::tanh(x); }, "(#)/(cosh$)^2" },
+		{ "sin", [](double x) { return std::sin(x); }, "cos$" },
+		{ "cos", [](double x) { return std::cos(x); }, "-sin$" },
+		{ "tan", [](double x) { return std::tan(x); }, "(#)/(cos$)^2" },
+		{ "ln", [](double x) { return std::log(x); }, "(#)/($)" },
+		{ "log10", [](double x) { return std::log10(x); }, "(#)/(2.302585092994046*($))" },
+		{ "exp", [](double x) { return std::exp(x); }, "exp$" },
+		{ "sqrt", [](double x) { return std::sqrt(x); }, "(#)/(2*sqrt$)" },
+		{ "abs", [](double x) { return std::abs(x); }, "sgn$" },
+		{ "atan", [](double x) { return std::atan(x); }, "(#)/(1+($)^2)" },
+		{ "asin", [](double x) { return std::asin(x); }, "(#)/sqrt(1-($)^2)" },
+		{ "acos", [](double x) { return std::acos(x); }, "-(#)/sqrt(1-($)^2)" },
+		{ "sgn", [](double x) { return x > 0.0 ? 1.0 : (x < 0.0 ? -1.0 : x); }, "0" }
+	};
+
+	const SpecialFunction* FindSpecialFunction(const std::string& expr, size_t position);
+	bool IsMinMax(const std::string& expr, size_t position);
+	bool SplitPair(const std::string& pair, std::string& first, std::string& second);
 	std::string GetSubExpression(const std::string& expr, size_t startPosition, size_t& endPosition);
+	bool IsMinMaxName(const std::string& expr, size_t position);
+	// writes out the multiplications implied by operands next to each other, such as "3x" or "2sin(x)", the way
+	// CompiledExpression reads them, and drops whitespace
+	std::string InsertImpliedProducts(const std::string& expr);
+	// writes a value the evaluator worked out back into the expression, in full precision
+	std::string FormatValue(double value);
+	// the length of the number starting at position, digits with an optional decimal and exponent, or 0 if there is none
+	size_t NumberLength(const std::string& expr, size_t position);
+	// a '+' or '-' that is the sign of an exponent, as in 3E-2
+	bool IsExponentSign(const std::string& expr, size_t position);
+	// a '+' or '-' at the start or after another operator, which belongs to the value after it
+	bool IsUnarySign(const std::string& expr, size_t position);
 	double GetValueToRight(const std::string& expr, size_t startPosition, size_t& endPosition, double x);
-	double GetValueToLeft(const std::string& expr, size_t endPosition, size_t& startPosition, double x);
-	std::string Reverse(const std::string& s);
+	// includeSigns takes in the unary signs in front of the value. They are left out for powers, since -a^b is -(a^b)
+	double GetValueToLeft(const std::string& expr, size_t endPosition, size_t& startPosition, double x, bool includeSigns);
 }
 
 Expression::Expression(const char* inputExpr, size_t exprLen, const std::shared_ptr<Logger>& loggerIn) :
-	logger(loggerIn)
+	logger(loggerIn),
+	tier(ExpressionTier::INTERPRETED),
+	evaluations(0),
+	compileAfter(DEFAULT_COMPILE_AFTER),
+	bytecodeAfter(DEFAULT_BYTECODE_AFTER)
 {
 	expr = "";
 	for (int i = 0; i < exprLen; ++i)
 		expr.push_back(inputExpr[i]);
+	evaluatedExpr = InsertImpliedProducts(expr);
 }
 
 Expression::Expression(std::string inputExpr, const std::shared_ptr<Logger>& loggerIn) :
 	expr(inputExpr),
-	logger(loggerIn)
+	evaluatedExpr(InsertImpliedProducts(inputExpr)),
+	logger(loggerIn),
+	tier(ExpressionTier::INTERPRETED),
+	evaluations(0),
+	compileAfter(DEFAULT_COMPILE_AFTER),
+	bytecodeAfter(DEFAULT_BYTECODE_AFTER)
 { }
 
 Expression::~Expression()
@@ -38,10 +102,17 @@ const std::string& Expression::GetExpr()
 
 double Expression::Evaluate(double x)
 {
+	++evaluations;
+	if (tier != ExpressionTier::BYTECODE) Promote();
+	if (tier == ExpressionTier::BYTECODE) return bytecode->Evaluate(x);
+	if (tier == ExpressionTier::COMPILED) return compiled->Evaluate(x);
+
 	const std::string logMsg = "Evaluate - begun evaluation of: " + expr;
 	logger->Log(logMsg);
 
-	const double returnVal = EvalInternal(expr, x);
+	const double returnVal = EvalInternal(evaluatedExpr, x);
+	if (interpretedValues.size() == AGREEMENT_CHECKS) interpretedValues.erase(interpretedValues.begin());
+	interpretedValues.emplace_back(x, returnVal);
 
 	const std::string logMsg2 = "Evaluate - result of evaluation: " + std::to_string(returnVal);
 	logger->LogEndChunk(logMsg2);
@@ -49,12 +120,129 @@ double Expression::Evaluate(double x)
 	return returnVal;
 }
 
+std::complex<double> Expression::Evaluate(std::complex<double> z)
+{
+	// the string-based evaluator only handles real values, so complex values go through the compiled form
+	return Compile().Evaluate(z);
+}
+
+Interval Expression::Evaluate(const Interval& x)
+{
+	return Compile().Evaluate(x);
+}
+
+const CompiledExpression& Expression::Compile()
+{
+	// a compile already running in the background is waited for rather than repeated
+	if (!compiled && pendingCompiled.valid())
+	{
+		try
+		{
+			compiled = pendingCompiled.get();
+		}
+		catch (...)
+		{
+			compileAfter = NEVER;
+			throw;
+		}
+	}
+	if (!compiled) compiled = std::make_shared<CompiledExpression>(expr, logger);
+	return *compiled;
+}
+
+void Expression::SetTierThresholds(size_t compileAfterIn, size_t bytecodeAfterIn)
+{
+	compileAfter = compileAfterIn;
+	bytecodeAfter = bytecodeAfterIn;
+}
+
+ExpressionTier Expression::GetTier() const
+{
+	return tier;
+}
+
+void Expression::Promote()
+{
+	// a build is only looked at without waiting, the evaluations never block on it
+	const auto ready = [](const auto& pending) { return pending.valid() && pending.wait_for(std::chrono::seconds(0)) == std::future_status::ready; };
+	if (tier == ExpressionTier::INTERPRETED)
+	{
+		if (ready(pendingCompiled))
+		{
+			try
+			{
+				compiled = pendingCompiled.get();
+			}
+			catch (const std::exception& e)
+			{
+				// the string evaluator accepts some expressions the compiler does not, those stay interpreted
+				const std::string logMsg = "Promote - staying interpreted, " + std::string(e.what());
+				logger->LogEndChunk(logMsg);
+				compileAfter = NEVER;
+			}
+		}
+		if (compiled && evaluations >= compileAfter && !AgreesWithInterpreted())
+		{
+			// a solve that is running would carry on with a different function
+			compileAfter = NEVER;
+		}
+		else if (compiled && evaluations >= compileAfter)
+		{
+			tier = ExpressionTier::COMPILED;
+			const std::string logMsg = "Promote - compiled after " + std::to_string(evaluations) + " evaluations: " + expr;
+			logger->LogEndChunk(logMsg);
+		}
+		else if (!compiled && !pendingCompiled.valid() && evaluations >= compileAfter)
+		{
+			pendingCompiled = std::async(std::launch::async, [exprCopy = expr, loggerCopy = logger]()
+			{
+				return std::make_shared<CompiledExpression>(exprCopy, loggerCopy);
+			});
+		}
+	}
+	if (tier == ExpressionTier::COMPILED)
+	{
+		if (ready(pendingBytecode))
+		{
+			bytecode = pendingBytecode.get();
+			tier = ExpressionTier::BYTECODE;
+			const std::string logMsg = "Promote - translated to " + std::to_string(bytecode->GetInstructionCount()) +
+				" bytecode instructions after " + std::to_string(evaluations) + " evaluations: " + expr;
+			logger->LogEndChunk(logMsg);
+		}
+		else if (!pendingBytecode.valid() && evaluations >= bytecodeAfter)
+		{
+			pendingBytecode = std::async(std::launch::async, [compiledCopy = compiled]()
+			{
+				return std::make_shared<BytecodeExpression>(*compiledCopy);
+			});
+		}
+	}
+}
+
+bool Expression::AgreesWithInterpreted()
+{
+	for (const auto& [x, value] : interpretedValues)
+	{
+		const double compiledValue = compiled->Evaluate(x);
+		if (std::isnan(value) && std::isnan(compiledValue)) continue;
+		if (value == compiledValue) continue;
+		if (std::abs(value - compiledValue) <= AGREEMENT_TOLERANCE * std::max({ 1.0, std::abs(value), std::abs(compiledValue) })) continue;
+
+		const std::string logMsg = "Promote - staying interpreted, the compiled form gives " + std::to_string(compiledValue) +
+			" instead of " + std::to_string(value) + " at " + std::to_string(x) + " for: " + expr;
+		logger->LogEndChunk(logMsg);
+		return false;
+	}
+	return true;
+}
+
 Expression Expression::Derivative()
 {
 	const std::string logMsg = "Derivative - begun finding derivative of: " + expr;
 	logger->Log(logMsg);
 
-	const std::string derivative = FindDerivativeInternal(expr, "x");
+	const std::string derivative = FindDerivativeInternal(evaluatedExpr, "x");
 
 	const std::string logMsg2 = "Derivative - found result to be: " + derivative;
 	logger->LogEndChunk(logMsg2);
@@ -77,12 +265,13 @@ std::vector<std::pair<InterTermOperator, std::string>> Expression::BreakUpTerms(
 	std::vector<std::pair<InterTermOperator, std::string>> terms;
 	std::string currentTerm = "";
 	InterTermOperator currentOp = InterTermOperator::NONE;
-	char lastC = '\0';
 	bool isFirst = true;
 	size_t nestingLevel = 0;
-	for (char c : expressionToBreak)
+	for (size_t position = 0; position < expressionToBreak.size(); ++position)
 	{
-		if (nestingLevel == 0 && (c == '+' || (c == '-' && lastC != 'E' && !isFirst)))
+		const char c = expressionToBreak[position];
+		const bool isOperator = (c == '+' || c == '-') && !IsExponentSign(expressionToBreak, position);
+		if (nestingLevel == 0 && isOperator && (c == '+' || (!IsUnarySign(expressionToBreak, position) && !isFirst)))
 		{
 			terms.push_back(std::make_pair(currentOp, currentTerm));
 			currentOp = c == '+' ?
@@ -98,8 +287,6 @@ std::vector<std::pair<InterTermOperator, std::string>> Expression::BreakUpTerms(
 			currentTerm.push_back(c);
 			isFirst = false;
 		}
-
-		lastC = c;
 	}
 	if (!currentTerm.empty()) terms.push_back(std::make_pair(currentOp, currentTerm));
 
@@ -188,6 +375,7 @@ std::vector<std::pair<InterTermOperator, std::string>> Expression::ProcessDeriva
 		if (!solved) processedItem = ProcessProductRule(term, deriveVar, solved);
 		if (!solved) processedItem = ProcessQuotientRule(term, deriveVar, solved);
 		if (!solved) processedItem = ProcessPowers(term, deriveVar, solved);
+		if (!solved) processedItem = ProcessMinMax(term, deriveVar, solved);
 		if (!solved) processedItem = ProcessSpecialFunctions(term, deriveVar, solved);
 		if (!solved) processedItem = ProcessChainRule(term, deriveVar, solved);
 		if (!solved)
@@ -350,9 +538,9 @@ std::string Expression::ProcessQuotientRule(const std::string& term, const std::
 			const bool rTD0 = rTermDerivative.compare("0") == 0;
 			const bool rTD1 = rTermDerivative.compare("1") == 0;
 			if (lTD0 && rTD0) processedItem = "0";
-			else if (lTD0 && rTD1) processedItem = "(" + lTerm + ")/(" + rTerm + ")^2";
+			else if (lTD0 && rTD1) processedItem = "-(" + lTerm + ")/(" + rTerm + ")^2";
 			else if (rTD0) processedItem = "(" + lTermDerivative + ")/(" + rTerm + ")";
-			else if (lTD0) processedItem = "(" + lTerm + ")*(" + rTermDerivative + ")/(" + rTerm + ")^2";
+			else if (lTD0) processedItem = "-(" + lTerm + ")*(" + rTermDerivative + ")/(" + rTerm + ")^2";
 			else if (rTD1) processedItem = "(" + lTermDerivative + ")/" + rTerm + "-" + lTerm + "/" + rTerm + "^2";
 			else processedItem = "(" + lTermDerivative + ")/(" + rTerm + ")-(" + lTerm + ")*(" + rTermDerivative + ")/(" + rTerm + ")^2";
 
@@ -387,6 +575,13 @@ std::string Expression::ProcessPowers(const std::string& term, const std::string
 
 			const std::string lTerm = term.substr(0, pos);
 			const std::string rTerm = term.substr(pos+1);
+			if (!lTerm.empty() && lTerm.front() == '-')
+			{
+				// -a^b is -(a^b), the same as the evaluators read it
+				processedItem = "-(" + FindDerivativeInternal(term.substr(1), deriveVar) + ")";
+				solved = true;
+				return processedItem;
+			}
 			if (lTerm.compare("0") == 0 || rTerm.compare("0") == 0)
 			{
 				// trivial case
@@ -442,52 +637,22 @@ std::string Expression::ProcessPowers(const std::string& term, const std::string
 }
 
 std::string Expression::ProcessSpecialFunctions(const std::string& term, const std::string& deriveVar, bool& solved)
-{			
+{
 	// at this point, if "solved" is to be true, the function should be of form "[function-escape](f(x))"
-	// only sin should start with s
-	// only cos should start with c
-	// only tan should start with t
-	// only ln should start with l
-	if (term.size() < 2)
-	{
-		return "0";
-	}
-	const char c = term[0];
-	const char c2 = term[1];
+	// possibly negated, where the escape is one of the names in SPECIAL_FUNCTIONS
 	std::string processedItem = "0";
-	size_t offset = 0;
-	const bool isNeg = c == '-';
-	const char cStar = isNeg ? c2 : c;
-	if (isNeg) offset += 1;
-	switch (cStar)
-	{
-	case 's':
-		solved = true;
-		offset += 3;
-		break;
-	case 'c':
-		solved = true;
-		offset += 3;
-		break;
-	case 't':
-		solved = true;
-		offset += 3;
-		break;
-	case 'l':
-		solved = true;
-		offset += 2;
-		break;
-	default:
-		solved = false;
-	}
+	const bool isNeg = !term.empty() && term[0] == '-';
+	const size_t offset = isNeg ? 1 : 0;
+	const SpecialFunction* function = FindSpecialFunction(term, offset);
+	solved = function != nullptr;
 	if (!solved) return processedItem;
 
 	const std::string logMsg = "ProcessSpecialFunctions - " + term;
 	logger->Log(logMsg);
-	const std::string fn = term.substr(offset);
+	const std::string fn = term.substr(offset + strlen(function->name));
 	const std::string fnDerivative = FindDerivativeInternal(fn, deriveVar);
 
-	if (fnDerivative.compare("0") == 0)
+	if (fnDerivative.compare("0") == 0 || strcmp(function->derivative, "0") == 0)
 	{
 		// trivial case
 		processedItem = "0";
@@ -495,28 +660,51 @@ std::string Expression::ProcessSpecialFunctions(const std::string& term, const s
 	}
 	const bool fnD1 = fnDerivative.compare("1") == 0;
 
-	switch (cStar)
-	{
-	case 's':
-		processedItem = "cos" + fn;
-		if (!fnD1) processedItem = "(" + fnDerivative + ")*" + processedItem;
-		break;
-	case 'c':
-		processedItem = "-sin" + fn;
-		if (!fnD1) processedItem = "(" + fnDerivative + ")*" + processedItem;
-		break;
-	case 't':
-		processedItem = "(" + fnDerivative + ")/(cos" + fn + ")^2";
-		break;
-	case 'l':
-		processedItem = "(" + fnDerivative + ")/(" + fn + ")";
-		break;
+	// fill in the function's derivative pattern
+	processedItem = "";
+	bool hasDerivative = false;
+	for (const char* c = function->derivative; *c != '\0'; ++c)
+	{
+		if (*c == '$') processedItem += fn;
+		else if (*c == '#') processedItem += fnDerivative;
+		else processedItem.push_back(*c);
+		hasDerivative = hasDerivative || *c == '#';
 	}
+	if (!hasDerivative && !fnD1) processedItem = "(" + fnDerivative + ")*" + processedItem;
 	if (isNeg) processedItem = "-1.0*" + processedItem;
 	return processedItem;
 
 }
 
+std::string Expression::ProcessMinMax(const std::string& term, const std::string& deriveVar, bool& solved)
+{
+	// terms of form "min(a,b)" or "max(a,b)", possibly negated
+	// the derivative is that of whichever operand is selected, (a' + b' -+ sgn(a - b) (a' - b')) / 2
+	std::string processedItem = "0";
+	const bool isNeg = !term.empty() && term[0] == '-';
+	const size_t offset = isNeg ? 1 : 0;
+	solved = false;
+	if (!IsMinMax(term, offset) || term.size() < offset + 5 || term.back() != ')') return processedItem;
+	size_t endPosition = 0;
+	const std::string pair = GetSubExpression(term, offset + 4, endPosition);
+	std::string first;
+	std::string second;
+	if (endPosition != term.size() - 1 || !SplitPair(pair, first, second)) return processedItem;
+	solved = true;
+
+	const std::string logMsg = "ProcessMinMax - " + term;
+	logger->Log(logMsg);
+	const std::string firstDerivative = FindDerivativeInternal(first, deriveVar);
+	const std::string secondDerivative = FindDerivativeInternal(second, deriveVar);
+	if (firstDerivative.compare("0") == 0 && secondDerivative.compare("0") == 0) return processedItem;
+
+	const std::string selector = term.compare(offset, 3, "max") == 0 ? "+" : "-";
+	processedItem = "((" + firstDerivative + ")+(" + secondDerivative + ")" + selector + "sgn((" + first + ")-(" + second + "))*((" +
+		firstDerivative + ")-(" + secondDerivative + ")))/2";
+	if (isNeg) processedItem = "-1.0*" + processedItem;
+	return processedItem;
+}
+
 size_t Expression::EvalSubExpression(std::string& expr, size_t startPosition, double x)
 {
 	// Replaces the sub expressions starting at startPosition with the value evaluated at x
@@ -534,7 +722,7 @@ size_t Expression::EvalSubExpression(std::string& expr, size_t startPosition, do
 	logger->Log(logMsgStart);
 
 	const double subResult = EvalInternal(subExpr, x);
-	const std::string subResultS = std::to_string(subResult);
+	const std::string subResultS = FormatValue(subResult);
 
 	const size_t positionToStartReplace = startPosition - 1; // begins after opening parenthesis, still need to remove opening parenthesis.
 	const size_t totalSizeToReplace = endPosition - startPosition + 2; // include parentheses pair
@@ -563,7 +751,7 @@ size_t Expression::EvalSpecialFunction(std::string& expr, size_t startPositionOf
 	size_t endPosition = startPositionOfValue;
 	const double value = GetValueToRight(expr, startPositionOfValue, endPosition, x);
 	const double evaluatedValue = func(value);
-	const std::string evaluatedValueS = std::to_string(evaluatedValue);
+	const std::string evaluatedValueS = FormatValue(evaluatedValue);
 
 	// Make note in log and replace the expression
 	std::string logMsg = "EvalSpecialFunction - Before: " + expr;
@@ -575,6 +763,36 @@ size_t Expression::EvalSpecialFunction(std::string& expr, size_t startPositionOf
 	return startPositionOfFunction + evaluatedValueS.size() -1;
 }
 
+size_t Expression::EvalMinMax(std::string& expr, size_t startPositionOfFunction, double x)
+{
+	// Replaces "min(a,b)" or "max(a,b)" starting at startPositionOfFunction with its value at x
+	// Outputs the end position of the last digit in the new substring in the modified expr
+	size_t endPosition = startPositionOfFunction;
+	const std::string pair = GetSubExpression(expr, startPositionOfFunction + 4, endPosition);
+	std::string first;
+	std::string second;
+	if (!SplitPair(pair, first, second))
+	{
+		std::string errMsg = "EvalMinMax - expected two values separated by a comma in " + expr;
+		logger->Log(errMsg);
+		throw std::invalid_argument(errMsg);
+	}
+	const double firstValue = EvalInternal(first, x);
+	const double secondValue = EvalInternal(second, x);
+	const double evaluatedValue = expr.compare(startPositionOfFunction, 3, "min") == 0 ?
+		std::min(firstValue, secondValue) :
+		std::max(firstValue, secondValue);
+	const std::string evaluatedValueS = FormatValue(evaluatedValue);
+
+	// Make note in log and replace the expression
+	std::string logMsg = "EvalMinMax - Before: " + expr;
+	expr.replace(startPositionOfFunction, endPosition - startPositionOfFunction + 1, evaluatedValueS);
+	logMsg += " After: " + expr;
+	logger->Log(logMsg);
+
+	return startPositionOfFunction + evaluatedValueS.size() - 1;
+}
+
 void Expression::EvalSubExpressions(std::string& expr, double x)
 {
 	size_t position = 0;
@@ -582,7 +800,13 @@ void Expression::EvalSubExpressions(std::string& expr, double x)
 	while (position < sizeOfExpression)
 	{
 		const char c = expr[position];
-		if (c == '(')
+		if (c == '(' && position >= 3 && IsMinMax(expr, position - 3))
+		{
+			// the parentheses hold two values, not one expression
+			position = EvalMinMax(expr, position - 3, x);
+			sizeOfExpression = expr.size();
+		}
+		else if (c == '(')
 		{
 			position = EvalSubExpression(expr, position + 1, x);
 			sizeOfExpression = expr.size();
@@ -593,56 +817,19 @@ void Expression::EvalSubExpressions(std::string& expr, double x)
 
 void Expression::EvalSpecialFunctions(std::string& expr, double x)
 {
-	const static auto sinLambda = [](double x) { return std::sin(x); };
-	const static auto cosLambda = [](double x) { return std::cos(x); };
-	const static auto tanLambda = [](double x) { return std::tan(x); };
-	const static auto lnLambda = [](double x) { return std::log(x); };
-	const static auto negSinLambda = [](double x) { return -1.0 * std::sin(x); };
-	const static auto negCosLambda = [](double x) { return -1.0 * std::cos(x); };
-	const static auto negTanLambda = [](double x) { return -1.0 * std::tan(x); };
-	const static auto negLnLambda = [](double x) { return -1.0 * std::log(x); };
-	
 	size_t position = 0;
 	size_t sizeOfExpression = expr.size();
 	while (position < sizeOfExpression)
 	{
 		// at this point:
-		// only sin should start with s
-		// only cos should start with c
-		// only tan should start with t
-		// only ln should start with l
+		// every function name is directly followed by its value
 		// all values in parenthesis of functions are evaluated.
-		const char c = expr[position];
-		const bool hasNextC = position != sizeOfExpression;
-		const char nextC = hasNextC ?
-			expr[position + 1] :
-			c; // default, always check hasNextC
-
-		const bool isNeg = c == '-';
-		const char cStar = isNeg && hasNextC ? nextC : c;
-
-		switch (cStar)
+		// a '-' in front of a function is left in place, so that -sin(x)^2 is -(sin(x)^2) as it is compiled
+		const SpecialFunction* function = FindSpecialFunction(expr, position);
+		if (function != nullptr)
 		{
-		case 's':
-			if (isNeg) position = EvalSpecialFunction(expr, position, position + 4, negSinLambda, x);
-			else position = EvalSpecialFunction(expr, position, position + 3 , sinLambda, x);
-			sizeOfExpression = expr.size();
-			break;
-		case 'c':
-			if (isNeg) position = EvalSpecialFunction(expr, position, position + 4, negCosLambda, x);
-			else position = EvalSpecialFunction(expr, position, position + 3, cosLambda, x);
+			position = EvalSpecialFunction(expr, position, position + strlen(function->name), function->func, x);
 			sizeOfExpression = expr.size();
-			break;
-		case 't':
-			if (isNeg) position = EvalSpecialFunction(expr, position, position + 4, negTanLambda, x);
-			else position = EvalSpecialFunction(expr, position, position + 3, tanLambda, x);
-			sizeOfExpression = expr.size();
-			break;
-		case 'l':
-			if (isNeg) position = EvalSpecialFunction(expr, position, position + 3, negLnLambda, x);
-			else position = EvalSpecialFunction(expr, position, position + 2, lnLambda, x);
-			sizeOfExpression = expr.size();
-			break;
 		}
 		++position;
 	}
@@ -662,10 +849,10 @@ void Expression::EvalPowers(std::string& expr, double x)
 		{
 			size_t startPosition = position;
 			size_t endPosition = position;
-			const double valueToLeft = GetValueToLeft(expr, position - 1, startPosition, x);
+			const double valueToLeft = GetValueToLeft(expr, position - 1, startPosition, x, false);
 			const double valueToRight = GetValueToRight(expr, position + 1, endPosition, x);
 			const double evaluatedValue = std::pow(valueToLeft, valueToRight);
-			const std::string evaluatedValueS = std::to_string(evaluatedValue);
+			const std::string evaluatedValueS = FormatValue(evaluatedValue);
 
 			const std::string logMsgLR = "EvalPowers - Left: " + std::to_string(valueToLeft) + " - " + std::to_string(startPosition) + " - Right: " + std::to_string(valueToRight) + " - " + std::to_string(endPosition);
 			logger->Log(logMsgLR);
@@ -698,7 +885,7 @@ void Expression::EvalMultiplcation(std::string& expr, double x)
 		{
 			size_t startPosition = position;
 			size_t endPosition = position;
-			const double valueToLeft = GetValueToLeft(expr, position - 1, startPosition, x);
+			const double valueToLeft = GetValueToLeft(expr, position - 1, startPosition, x, true);
 			const double valueToRight = GetValueToRight(expr, position + 1, endPosition, x);
 
 			const std::string logMsgLR = "EvalMultiplcation - Left: " + std::to_string(valueToLeft) + " - " + std::to_string(startPosition) + " - Right: " + std::to_string(valueToRight) + " - " + std::to_string(endPosition);
@@ -707,16 +894,12 @@ void Expression::EvalMultiplcation(std::string& expr, double x)
 			const double evaluatedValue = c == '/' ?
 				valueToLeft / valueToRight :
 				valueToLeft * valueToRight;
-			const std::string evaluatedValueS = std::to_string(evaluatedValue);
+			const std::string evaluatedValueS = FormatValue(evaluatedValue);
 
 			// Make note in log and replace the expression
 			std::string logMsg = "EvalMultiplcation - Before: " + expr;
 			const size_t totalSizeToReplace = endPosition - startPosition + 1;
 			expr.replace(startPosition, totalSizeToReplace, evaluatedValueS);
-			auto pos = expr.find("+-");
-			if (pos != std::string::npos) expr.replace(pos, 2, "-");
-			pos = expr.find("--");
-			if (pos != std::string::npos) expr.replace(pos, 2, "+");
 			logMsg += " After: " + expr;
 			logger->Log(logMsg);
 
@@ -738,11 +921,12 @@ void Expression::EvalAddition(std::string& expr, double x)
 	while (position < sizeOfExpression)
 	{
 		const char c = expr[position];
-		if (c == '+' || (c == '-' && position != 0))
+		// signs of values and of exponents are read with the values
+		if ((c == '+' || c == '-') && !IsUnarySign(expr, position) && !IsExponentSign(expr, position))
 		{
 			size_t startPosition = position;
 			size_t endPosition = position;
-			const double valueToLeft = GetValueToLeft(expr, position - 1, startPosition, x);
+			const double valueToLeft = GetValueToLeft(expr, position - 1, startPosition, x, true);
 			const double valueToRight = GetValueToRight(expr, position + 1, endPosition, x);
 
 
@@ -752,7 +936,7 @@ void Expression::EvalAddition(std::string& expr, double x)
 			const double evaluatedValue = c == '+' ?
 				valueToLeft + valueToRight :
 				valueToLeft - valueToRight;
-			const std::string evaluatedValueS = std::to_string(evaluatedValue);
+			const std::string evaluatedValueS = FormatValue(evaluatedValue);
 
 			// Make note in log and replace the expression
 			std::string logMsg = "EvalAddition - Before: " + expr;
@@ -805,11 +989,16 @@ double Expression::EvalInternal(const std::string& expr, double x)
 	// find addition/subtraction
 	EvalAddition(exprModified, x);
 
-	// if the final solution is just "x", a final replacement is required
-	if (exprModified.compare("x") == 0)
-		exprModified = std::to_string(x);
-
-	return std::stod(exprModified);
+	// what is left is a single value, possibly "x" or with signs in front
+	size_t endPosition = 0;
+	const double returnVal = GetValueToRight(exprModified, 0, endPosition, x);
+	if (endPosition + 1 != exprModified.size())
+	{
+		std::string errMsg = "EvalInternal - could not evaluate " + expr + ", left with " + exprModified;
+		logger->Log(errMsg);
+		throw std::invalid_argument(errMsg);
+	}
+	return returnVal;
 }
 
 namespace
@@ -817,86 +1006,52 @@ namespace
 
 	double GetValueToRight(const std::string& expr, size_t startPosition, size_t& endPosition, double x)
 	{
-		// Return result from a double substring starting at startPosition
-		// endPosition is the digit the function last looks at
-		bool hasDecimal = false;
-		std::string returnVal = "";
-
-		endPosition = startPosition;
-		size_t sizeOfExpression = expr.size();
-		while (endPosition < sizeOfExpression)
+		// Return the value starting at startPosition: any signs, then x, e, a number, or INF or NAN written in by FormatValue
+		// endPosition is the last character of the value
+		double sign = 1.0;
+		size_t position = startPosition;
+		while (position < expr.size() && (expr[position] == '-' || expr[position] == '+' || expr[position] == NEGATIVE_VALUE))
 		{
-			const char c = expr[endPosition];
-			switch (c)
-			{
-			case 'x':
-				// this is the variable x
-				if (!returnVal.empty()) return std::stod(returnVal) * x; // assume multiplcation was intended in this case
-				return x;
-			case 'e':
-				if (returnVal.empty())  return M_E; // assume this is the constant "e" and not intended for scientific notation 
-				break;
-			case 'E':
-			case '.':
-				break;
-			default:
-				if (!std::isdigit(c) && !(c == '-' && (returnVal.empty() || returnVal.back() == 'e')))
-				{
-					--endPosition; // went to far
-					return std::stod(returnVal);
-				}
-			}
-
-			returnVal.push_back(c);
-			++endPosition;
+			if (expr[position] != '+') sign = -sign;
+			++position;
 		}
-
-		--endPosition; // went to far
-		return std::stod(returnVal);
+		if (position < expr.size() && (expr[position] == 'x' || expr[position] == 'e'))
+		{
+			endPosition = position;
+			return expr[position] == 'x' ? sign * x : sign * M_E;
+		}
+		if (expr.compare(position, 3, "INF") == 0 || expr.compare(position, 3, "NAN") == 0)
+		{
+			endPosition = position + 2;
+			return expr[position] == 'I' ? sign * HUGE_VAL : std::numeric_limits<double>::quiet_NaN();
+		}
+		const size_t length = NumberLength(expr, position);
+		if (length == 0) throw std::invalid_argument("GetValueToRight - expected a value at " + expr.substr(startPosition));
+		endPosition = position + length - 1;
+		return sign * std::stod(expr.substr(position, length));
 	}
 
-	double GetValueToLeft(const std::string& expr, size_t endPosition, size_t& startPosition, double x)
+	double GetValueToLeft(const std::string& expr, size_t endPosition, size_t& startPosition, double x, bool includeSigns)
 	{
-		// Return result from a double substring starting at endPosition and going left
-		// startPosition is the digit the function last looks at
-		bool hasDecimal = false;
-		std::string returnVal = "";
-
+		// Return the value ending at endPosition
+		// startPosition is the first character of the value
+		// walks back over everything that can be part of a value, then reads it forwards
 		startPosition = endPosition;
-		size_t sizeOfExpression = expr.size();
-		while (startPosition >= 0)
-		{
-			const char c = expr[startPosition];
-			const bool hasNoNextVal = startPosition == 0;
-			const char nextVal = hasNoNextVal ?
-				c : // default, should always check hasNoNextVal
-				expr[startPosition - 1];
-			switch (c)
-			{
-			case 'x':
-				// this is the variable x
-				if (!returnVal.empty()) return std::stod(Reverse(returnVal)) * x; // assume multiplcation was intended in this case
-				return x;
-			case 'e':
-				if (hasNoNextVal || !std::isdigit(nextVal)) return M_E; // assume this is the constant "e" and not intended for scientific notation 
-				break;
-			case 'E':
-			case '.':
-				break;
-			default:
-				if (!std::isdigit(c) && !(c == '-' && (hasNoNextVal || nextVal == 'e')))
-				{
-					++startPosition;
-					return std::stod(Reverse(returnVal));
-				}
-			}
-
-			returnVal.push_back(c);
-
-			if (hasNoNextVal) return std::stod(Reverse(returnVal));
+		while (startPosition > 0)
+		{
+			const char c = expr[startPosition - 1];
+			const bool partOfValue = std::isdigit(c) || strchr(".EeINFA", c) != nullptr ||
+				((c == '-' || c == '+') && IsExponentSign(expr, startPosition - 1));
+			if (!partOfValue) break;
 			--startPosition;
 		}
-		return 0.0;
+		if (startPosition > 0 && expr[startPosition - 1] == NEGATIVE_VALUE) --startPosition;
+		while (includeSigns && startPosition > 0 && IsUnarySign(expr, startPosition - 1)) --startPosition;
+
+		size_t valueEnd = startPosition;
+		const double value = GetValueToRight(expr, startPosition, valueEnd, x);
+		if (valueEnd != endPosition) throw std::invalid_argument("GetValueToLeft - expected a value before " + expr.substr(endPosition + 1));
+		return value;
 	}
 
 	std::string GetSubExpression(const std::string& expr, size_t startPosition, size_t& endPosition)
@@ -923,9 +1078,149 @@ namespace
 		return returnVal;
 	}
 
-	std::string Reverse(const std::string& s)
+	const SpecialFunction* FindSpecialFunction(const std::string& expr, size_t position)
+	{
+		for (const SpecialFunction& function : SPECIAL_FUNCTIONS)
+		{
+			if (expr.compare(position, strlen(function.name), function.name) == 0) return &function;
+		}
+		return nullptr;
+	}
+
+	bool IsMinMax(const std::string& expr, size_t position)
+	{
+		return expr.compare(position, 4, "min(") == 0 || expr.compare(position, 4, "max(") == 0;
+	}
+
+	bool SplitPair(const std::string& pair, std::string& first, std::string& second)
+	{
+		// splits "a,b" at the comma that is not inside parentheses
+		size_t nestingLevel = 0;
+		for (size_t position = 0; position < pair.size(); ++position)
+		{
+			const char c = pair[position];
+			if (c == '(') ++nestingLevel;
+			else if (c == ')') --nestingLevel;
+			else if (c == ',' && nestingLevel == 0)
+			{
+				first = pair.substr(0, position);
+				second = pair.substr(position + 1);
+				return !first.empty() && !second.empty();
+			}
+		}
+		return false;
+	}
+
+	bool IsMinMaxName(const std::string& expr, size_t position)
+	{
+		return expr.compare(position, 3, "min") == 0 || expr.compare(position, 3, "max") == 0;
+	}
+
+	std::string InsertImpliedProducts(const std::string& expr)
+	{
+		// goes through the expression a token at a time, putting a '*' between one that ends an operand and one that starts one
+		std::string result;
+		result.reserve(2 * expr.size()); // is a maximum
+		bool operandEnded = false;
+		size_t position = 0;
+		while (position < expr.size())
+		{
+			const char c = expr[position];
+			if (std::isspace(static_cast<unsigned char>(c)))
+			{
+				++position;
+				continue;
+			}
+
+			const size_t start = position;
+			bool startsOperand = true;
+			bool endsOperand = true;
+			const SpecialFunction* function = FindSpecialFunction(expr, position);
+			if (std::isdigit(static_cast<unsigned char>(c)) || c == '.')
+			{
+				position += NumberLength(expr, position);
+			}
+			else if (IsMinMaxName(expr, position))
+			{
+				position += 3;
+				endsOperand = false;
+			}
+			else if (function != nullptr)
+			{
+				// the function's value follows it, without a '*'
+				position += strlen(function->name);
+				endsOperand = false;
+			}
+			else if (c == 'x' || c == 'e')
+			{
+				++position;
+			}
+			else if (c == '(')
+			{
+				++position;
+				endsOperand = false;
+			}
+			else if (c == ')')
+			{
+				++position;
+				startsOperand = false;
+			}
+			else
+			{
+				// operators and separators, and anything else is left for the evaluator to complain about
+				++position;
+				startsOperand = false;
+				endsOperand = false;
+			}
+
+			if (operandEnded && startsOperand) result.push_back('*');
+			result.append(expr, start, position - start);
+			operandEnded = endsOperand;
+		}
+		return result;
+	}
+
+	std::string FormatValue(double value)
+	{
+		std::string sign = std::signbit(value) && !std::isnan(value) ? std::string(1, NEGATIVE_VALUE) : "";
+		if (std::isnan(value)) return "NAN";
+		if (std::isinf(value)) return sign + "INF";
+		char buffer[32];
+		snprintf(buffer, sizeof(buffer), "%.17G", std::abs(value));
+		return sign + buffer;
+	}
+
+	size_t NumberLength(const std::string& expr, size_t position)
+	{
+		// digits with an optional decimal and exponent, the same as CompiledExpression::ParseNumber. A lone 'e' is the constant e
+		size_t end = position;
+		while (end < expr.size() && (std::isdigit(static_cast<unsigned char>(expr[end])) || expr[end] == '.')) ++end;
+		if (end == position) return 0;
+		if (end < expr.size() && (expr[end] == 'E' || expr[end] == 'e'))
+		{
+			size_t exponentEnd = end + 1;
+			if (exponentEnd < expr.size() && (expr[exponentEnd] == '-' || expr[exponentEnd] == '+')) ++exponentEnd;
+			if (exponentEnd < expr.size() && std::isdigit(static_cast<unsigned char>(expr[exponentEnd])))
+			{
+				end = exponentEnd;
+				while (end < expr.size() && std::isdigit(static_cast<unsigned char>(expr[end]))) ++end;
+			}
+		}
+		return end - position;
+	}
+
+	bool IsExponentSign(const std::string& expr, size_t position)
+	{
+		if (position < 2 || position + 1 >= expr.size()) return false;
+		if (expr[position - 1] != 'E' && expr[position - 1] != 'e') return false;
+		const char beforeExponent = expr[position - 2];
+		return (std::isdigit(static_cast<unsigned char>(beforeExponent)) || beforeExponent == '.') &&
+			std::isdigit(static_cast<unsigned char>(expr[position + 1]));
+	}
+
+	bool IsUnarySign(const std::string& expr, size_t position)
 	{
-		const std::string rev(s.rbegin(), s.rend());
-		return rev;
+		if (expr[position] != '-' && expr[position] != '+') return false;
+		return position == 0 || (strchr("+-*/^,", expr[position - 1]) != nullptr && !IsExponentSign(expr, position - 1));
 	}
 }
\ No newline at end of file
@@ -1,7 +1,13 @@
 #pragma once
 
+#include "BytecodeExpression.h"
+#include "CompiledExpression.h"
 #include "Logger.h"
+#include <complex>
 #include <functional>
+#include <future>
+#include "Interval.h"
+#include <memory>
 #include <string>
 #include <utility>
 #include <vector>
@@ -13,22 +19,47 @@ enum class InterTermOperator
 	MINUS
 };
 
+// how Expression::Evaluate works out real values. Expressions start out interpreted, which costs nothing to set up,
+// and move up the tiers as they are evaluated, so only the ones evaluated often pay for building the faster forms
+enum class ExpressionTier
+{
+	INTERPRETED, // the string evaluator
+	COMPILED, // CompiledExpression
+	BYTECODE // BytecodeExpression
+};
+
 class Expression
 {
 public:
 	Expression() = delete;
 	Expression(const char* inputExpr, size_t exprLen, const std::shared_ptr<Logger>& loggerIn);
 	Expression(std::string inputExpr, const std::shared_ptr<Logger>& loggerIn);
+	Expression(Expression&&) = default;
+	Expression& operator=(Expression&&) = default;
+	// waits for any form still being built in the background
 	~Expression();
 
 	double Evaluate(double x);
+	std::complex<double> Evaluate(std::complex<double> z);
+	// an interval holding f(x) for every x in the given interval
+	Interval Evaluate(const Interval& x);
+
+	// parses the expression once so it can be evaluated repeatedly without string processing
+	const CompiledExpression& Compile();
 
 	const std::string& GetExpr();
 
+	// the number of real evaluations after which the compiled and then the bytecode forms are built
+	// they are built on their own threads, Evaluate carries on with the current form until the next one is ready
+	// and switches between two calls, so a solve that is running picks up the faster form as it goes
+	void SetTierThresholds(size_t compileAfterIn, size_t bytecodeAfterIn);
+	ExpressionTier GetTier() const;
+
 	Expression Derivative();
 private:
 	size_t EvalSubExpression(std::string& expr, size_t startPosition, double x);
 	size_t EvalSpecialFunction(std::string& expr, size_t startPositionOfFunction, size_t startPositionOfValue, std::function<double(double)> func, double x);
+	size_t EvalMinMax(std::string& expr, size_t startPositionOfFunction, double x);
 	void EvalSubExpressions(std::string& expr, double x);
 	void EvalSpecialFunctions(std::string& expr, double x);
 	void EvalPowers(std::string& expr, double x);
@@ -46,7 +77,23 @@ private:
 	std::string ProcessQuotientRule(const std::string& term, const std::string& derivVar, bool& solved);
 	std::string ProcessPowers(const std::string& term, const std::string& derivVar, bool& solved);
 	std::string ProcessSpecialFunctions(const std::string& term, const std::string& derivVar, bool& solved);
+	std::string ProcessMinMax(const std::string& term, const std::string& derivVar, bool& solved);
+
+	// starts building the next tier once its threshold is passed, and moves to it once it is built
+	void Promote();
+	// whether the compiled form gives the values the string evaluator gave last, so a solve does not change function part way
+	bool AgreesWithInterpreted();
 
 	std::string expr;
+	std::string evaluatedExpr; // expr as the string evaluator reads it, with the implied multiplications written out
 	std::shared_ptr<Logger> logger;
+	std::shared_ptr<CompiledExpression> compiled;
+	std::shared_ptr<BytecodeExpression> bytecode;
+	std::future<std::shared_ptr<CompiledExpression>> pendingCompiled;
+	std::future<std::shared_ptr<BytecodeExpression>> pendingBytecode;
+	ExpressionTier tier;
+	size_t evaluations;
+	size_t compileAfter;
+	size_t bytecodeAfter;
+	std::vector<std::pair<double, double>> interpretedValues; // the last few x and f(x) from the string evaluator
 };
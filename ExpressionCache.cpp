@@ -0,0 +1,161 @@
+// Implements the cache of compiled expressions
+
+#include "pch.h"
+#include "ExpressionCache.h"
+
+#include <algorithm>
+
+ExpressionCache::ExpressionCache(const std::shared_ptr<Logger>& loggerIn, size_t capacityIn) :
+	logger(loggerIn),
+	capacity(std::max<size_t>(capacityIn, 1)),
+	hits(0),
+	misses(0),
+	canonicalHits(0),
+	evictions(0)
+{ }
+
+ExpressionCache::~ExpressionCache()
+{ }
+
+std::shared_ptr<const CachedExpression> ExpressionCache::Get(const std::string& expr)
+{
+	{
+		std::lock_guard<std::mutex> lock(entriesMutex);
+		const auto found = entries.find(expr);
+		if (found != entries.end())
+		{
+			++hits;
+			Touch(found->second);
+			return found->second.expression;
+		}
+	}
+
+	// compiled without the lock, two threads asking for the same new expression at once may both compile it
+	std::shared_ptr<CompiledExpression> function;
+	std::string form;
+	try
+	{
+		function = std::make_shared<CompiledExpression>(expr, logger);
+		form = canonical::Canonicalize(*function);
+	}
+	catch (const std::exception&)
+	{
+		// the expression is invalid, the callers check for null
+		function = nullptr;
+	}
+
+	if (function != nullptr)
+	{
+		std::lock_guard<std::mutex> lock(entriesMutex);
+		const auto found = entries.find(expr);
+		if (found != entries.end())
+		{
+			++hits;
+			Touch(found->second);
+			return found->second.expression;
+		}
+		const auto sameForm = canonicalEntries.find(form);
+		if (sameForm != canonicalEntries.end())
+		{
+			// written differently before, the compiled function and derivative from then serve just as well
+			++hits;
+			++canonicalHits;
+			const auto expression = sameForm->second.expression;
+			Insert(expr, expression, form, false);
+			return expression;
+		}
+	}
+
+	auto entry = std::make_shared<CachedExpression>();
+	entry->function = function;
+	try
+	{
+		if (function != nullptr) entry->derivative = std::make_shared<CompiledExpression>(function->Derivative());
+	}
+	catch (const std::exception&)
+	{
+		// no derivative, only Newton's Method needs one
+	}
+
+	std::lock_guard<std::mutex> lock(entriesMutex);
+	const auto found = entries.find(expr);
+	if (found != entries.end())
+	{
+		++hits;
+		Touch(found->second);
+		return found->second.expression;
+	}
+	++misses;
+	Insert(expr, entry, form, false);
+	return entry;
+}
+
+void ExpressionCache::Add(const std::string& expr, const std::shared_ptr<const CachedExpression>& entry)
+{
+	const std::string form = entry->function != nullptr ? canonical::Canonicalize(*entry->function) : std::string();
+	std::lock_guard<std::mutex> lock(entriesMutex);
+	const auto found = entries.find(expr);
+	if (found != entries.end()) Remove(found);
+	Insert(expr, entry, form, true);
+}
+
+size_t ExpressionCache::GetSize()
+{
+	std::lock_guard<std::mutex> lock(entriesMutex);
+	return entries.size();
+}
+
+size_t ExpressionCache::GetHits()
+{
+	std::lock_guard<std::mutex> lock(entriesMutex);
+	return hits;
+}
+
+size_t ExpressionCache::GetMisses()
+{
+	std::lock_guard<std::mutex> lock(entriesMutex);
+	return misses;
+}
+
+size_t ExpressionCache::GetCanonicalHits()
+{
+	std::lock_guard<std::mutex> lock(entriesMutex);
+	return canonicalHits;
+}
+
+size_t ExpressionCache::GetEvictions()
+{
+	std::lock_guard<std::mutex> lock(entriesMutex);
+	return evictions;
+}
+
+void ExpressionCache::Touch(Entry& entry)
+{
+	recentlyUsed.splice(recentlyUsed.begin(), recentlyUsed, entry.recent);
+}
+
+void ExpressionCache::Insert(const std::string& expr, const std::shared_ptr<const CachedExpression>& expression, const std::string& form, bool replace)
+{
+	while (entries.size() >= capacity)
+	{
+		Remove(entries.find(recentlyUsed.back()));
+		++evictions;
+	}
+	recentlyUsed.push_front(expr);
+	entries.emplace(expr, Entry{ expression, form, recentlyUsed.begin() });
+	if (form.empty()) return;
+	CanonicalEntry& canonicalEntry = canonicalEntries[form];
+	if (canonicalEntry.spellings == 0 || replace) canonicalEntry.expression = expression;
+	++canonicalEntry.spellings;
+}
+
+void ExpressionCache::Remove(std::unordered_map<std::string, Entry>::iterator found)
+{
+	if (!found->second.form.empty())
+	{
+		const auto canonicalEntry = canonicalEntries.find(found->second.form);
+		if (--canonicalEntry->second.spellings == 0) canonicalEntries.erase(canonicalEntry);
+	}
+	recentlyUsed.erase(found->second.recent);
+	entries.erase(found);
+}
@@ -0,0 +1,76 @@
+// Keeps expressions and their derivatives compiled, so repeated requests for the same expression skip parsing
+// and differentiation. Expressions are also filed under their canonical form (see CanonicalForm.h), so another way of
+// writing an expression already compiled only costs a parse, and shares the compiled function and derivative. Holds at
+// most a fixed number of expressions, dropping the least recently used. Safe to use from several threads
+#pragma once
+
+#include "CanonicalForm.h"
+#include "CompiledExpression.h"
+#include "Logger.h"
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+const size_t EXPRESSION_CACHE_CAPACITY = 1 << 16; // expressions kept by default
+
+struct CachedExpression
+{
+	std::shared_ptr<const CompiledExpression> function; // null when the expression could not be parsed
+	std::shared_ptr<const CompiledExpression> derivative; // null when the derivative could not be found
+};
+
+class ExpressionCache
+{
+public:
+	ExpressionCache() = delete;
+	ExpressionCache(const std::shared_ptr<Logger>& loggerIn, size_t capacityIn = EXPRESSION_CACHE_CAPACITY);
+	~ExpressionCache();
+
+	// compiles the expression on first use, unless another form of it is cached already. Expressions that fail to compile
+	// are cached as well. Compiling happens outside the lock, so other threads are not held up by it
+	std::shared_ptr<const CachedExpression> Get(const std::string& expr);
+	// adds an expression compiled elsewhere, replacing any entry for it
+	void Add(const std::string& expr, const std::shared_ptr<const CachedExpression>& entry);
+
+	size_t GetSize();
+	size_t GetHits();
+	size_t GetMisses();
+	// the hits found through the canonical form, having been written differently before
+	size_t GetCanonicalHits();
+	// expressions dropped to stay within the capacity
+	size_t GetEvictions();
+private:
+	struct Entry
+	{
+		std::shared_ptr<const CachedExpression> expression;
+		std::string form; // canonical form, empty when the expression did not compile
+		std::list<std::string>::iterator recent; // position in recentlyUsed
+	};
+	// an expression shared by every spelling of the same canonical form
+	struct CanonicalEntry
+	{
+		std::shared_ptr<const CachedExpression> expression;
+		size_t spellings; // entries with this form, the canonical entry goes with the last of them
+	};
+
+	// the following expect entriesMutex to be held
+	// moves expr to the front of recentlyUsed
+	void Touch(Entry& entry);
+	// stores expression under expr and under form, unless form is empty, evicting the least recently used entry if full
+	// a form already cached keeps its expression unless replace is set
+	void Insert(const std::string& expr, const std::shared_ptr<const CachedExpression>& expression, const std::string& form, bool replace);
+	void Remove(std::unordered_map<std::string, Entry>::iterator found);
+
+	std::unordered_map<std::string, Entry> entries;
+	std::unordered_map<std::string, CanonicalEntry, canonical::FormHash> canonicalEntries;
+	std::list<std::string> recentlyUsed; // keys of entries, most recent first
+	std::mutex entriesMutex;
+	std::shared_ptr<Logger> logger;
+	const size_t capacity;
+	size_t hits;
+	size_t misses;
+	size_t canonicalHits;
+	size_t evictions;
+};
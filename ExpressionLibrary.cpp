@@ -0,0 +1,215 @@
+// Implements the binary library of compiled expressions
+
+#include "pch.h"
+#include "ExpressionLibrary.h"
+
+#include <fstream>
+#include <stdexcept>
+
+namespace
+{
+	const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+	const uint64_t FNV_PRIME = 1099511628211ULL;
+
+	uint64_t Checksum(const char* data, size_t size);
+	uint64_t AlignTo8(uint64_t offset);
+}
+
+ExpressionLibraryWriter::ExpressionLibraryWriter()
+{ }
+
+ExpressionLibraryWriter::~ExpressionLibraryWriter()
+{ }
+
+void ExpressionLibraryWriter::Add(const CompiledExpression& function, const CompiledExpression* derivative)
+{
+	const std::string& expr = function.GetExpr();
+	if (!function.GetParameterNames().empty()) throw std::invalid_argument("ExpressionLibraryWriter - " + expr + " has parameters");
+	if (expressionIndices.find(expr) != expressionIndices.end()) return;
+	expressionIndices.emplace(expr, expressions.size());
+
+	ExpressionLibraryEntry entry = {};
+	entry.exprLength = static_cast<uint32_t>(expr.size());
+	entry.functionFirstNode = nodes.size();
+	entry.functionNodeCount = static_cast<uint32_t>(function.GetNodes().size());
+	AppendNodes(function);
+	entry.derivativeFirstNode = nodes.size();
+	if (derivative != nullptr)
+	{
+		entry.derivativeNodeCount = static_cast<uint32_t>(derivative->GetNodes().size());
+		entry.derivativeLength = static_cast<uint32_t>(derivative->GetExpr().size());
+		AppendNodes(*derivative);
+	}
+	expressions.push_back(expr);
+	derivatives.push_back(derivative != nullptr ? derivative->GetExpr() : std::string());
+	entries.push_back(entry);
+}
+
+size_t ExpressionLibraryWriter::GetCount() const
+{
+	return expressions.size();
+}
+
+void ExpressionLibraryWriter::Write(const std::string& path) const
+{
+	ExpressionLibraryHeader header = {};
+	header.magic = EXPRESSION_LIBRARY_MAGIC;
+	header.version = EXPRESSION_LIBRARY_VERSION;
+	header.expressionCount = entries.size();
+	header.entriesOffset = sizeof(ExpressionLibraryHeader);
+	header.nodeCount = nodes.size();
+	header.nodesOffset = AlignTo8(header.entriesOffset + entries.size() * sizeof(ExpressionLibraryEntry));
+	header.stringsOffset = header.nodesOffset + nodes.size() * sizeof(SerializedNode);
+
+	// lay the whole file out in memory first, the checksum covers all of it
+	std::vector<ExpressionLibraryEntry> placedEntries = entries;
+	uint64_t stringsSize = 0;
+	for (size_t i = 0; i < placedEntries.size(); ++i)
+	{
+		placedEntries[i].exprOffset = stringsSize;
+		stringsSize += expressions[i].size() + derivatives[i].size();
+	}
+	header.fileSize = header.stringsOffset + stringsSize;
+
+	std::vector<char> contents(header.fileSize, 0);
+	std::copy(reinterpret_cast<const char*>(placedEntries.data()), reinterpret_cast<const char*>(placedEntries.data() + placedEntries.size()),
+		contents.begin() + header.entriesOffset);
+	std::copy(reinterpret_cast<const char*>(nodes.data()), reinterpret_cast<const char*>(nodes.data() + nodes.size()),
+		contents.begin() + header.nodesOffset);
+	uint64_t stringOffset = header.stringsOffset;
+	for (size_t i = 0; i < expressions.size(); ++i)
+	{
+		const std::string both = expressions[i] + derivatives[i];
+		std::copy(both.begin(), both.end(), contents.begin() + stringOffset);
+		stringOffset += both.size();
+	}
+	header.checksum = Checksum(contents.data() + sizeof(ExpressionLibraryHeader), contents.size() - sizeof(ExpressionLibraryHeader));
+	std::copy(reinterpret_cast<const char*>(&header), reinterpret_cast<const char*>(&header + 1), contents.begin());
+
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	if (!out) throw std::runtime_error("ExpressionLibraryWriter - unable to open " + path);
+	out.write(contents.data(), contents.size());
+	if (!out) throw std::runtime_error("ExpressionLibraryWriter - unable to write " + path);
+}
+
+void ExpressionLibraryWriter::AppendNodes(const CompiledExpression& expression)
+{
+	for (const ExpressionNode& node : expression.GetNodes())
+	{
+		nodes.push_back({ static_cast<uint32_t>(node.op), 0, node.lhs, node.rhs, node.value });
+	}
+}
+
+ExpressionLibrary::ExpressionLibrary(const std::string& path, const std::shared_ptr<Logger>& loggerIn) :
+	file(std::make_unique<MappedFile>(path, false)),
+	logger(loggerIn)
+{
+	const char* data = file->GetData();
+	const uint64_t size = file->GetSize();
+	if (size < sizeof(ExpressionLibraryHeader)) throw std::runtime_error("ExpressionLibrary - " + path + " is too small to be a library");
+
+	header = reinterpret_cast<const ExpressionLibraryHeader*>(data);
+	if (header->magic != EXPRESSION_LIBRARY_MAGIC) throw std::runtime_error("ExpressionLibrary - " + path + " is not an expression library");
+	if (header->version != EXPRESSION_LIBRARY_VERSION) throw std::runtime_error("ExpressionLibrary - " + path + " has unsupported version " + std::to_string(header->version));
+	if (header->fileSize != size || Checksum(data + sizeof(ExpressionLibraryHeader), size - sizeof(ExpressionLibraryHeader)) != header->checksum)
+	{
+		throw std::runtime_error("ExpressionLibrary - " + path + " is truncated or corrupt");
+	}
+
+	// every table has to lie inside the file, checked so that large counts cannot overflow
+	const bool entriesFit = header->entriesOffset <= size && header->entriesOffset % alignof(ExpressionLibraryEntry) == 0 &&
+		header->expressionCount <= (size - header->entriesOffset) / sizeof(ExpressionLibraryEntry);
+	const bool nodesFit = header->nodesOffset <= size && header->nodesOffset % alignof(SerializedNode) == 0 &&
+		header->nodeCount <= (size - header->nodesOffset) / sizeof(SerializedNode);
+	if (!entriesFit || !nodesFit || header->stringsOffset > size) throw std::runtime_error("ExpressionLibrary - " + path + " has tables out of bounds");
+
+	entries = reinterpret_cast<const ExpressionLibraryEntry*>(data + header->entriesOffset);
+	nodes = reinterpret_cast<const SerializedNode*>(data + header->nodesOffset);
+	strings = data + header->stringsOffset;
+	indices.reserve(header->expressionCount);
+	for (size_t i = 0; i < header->expressionCount; ++i)
+	{
+		const ExpressionLibraryEntry& entry = entries[i];
+		const uint64_t stringLength = static_cast<uint64_t>(entry.exprLength) + entry.derivativeLength;
+		const bool stringFits = entry.exprOffset <= size - header->stringsOffset && stringLength <= size - header->stringsOffset - entry.exprOffset;
+		const bool functionFits = entry.functionFirstNode <= header->nodeCount && entry.functionNodeCount <= header->nodeCount - entry.functionFirstNode;
+		const bool derivativeFits = entry.derivativeFirstNode <= header->nodeCount && entry.derivativeNodeCount <= header->nodeCount - entry.derivativeFirstNode;
+		if (!stringFits || !functionFits || !derivativeFits)
+			throw std::runtime_error("ExpressionLibrary - expression " + std::to_string(i) + " of " + path + " is out of bounds");
+		indices.emplace(std::string_view(strings + entry.exprOffset, entry.exprLength), i);
+	}
+
+	const std::string logMsg = "ExpressionLibrary - mapped " + std::to_string(header->expressionCount) + " expressions from " + path;
+	logger->LogEndChunk(logMsg);
+}
+
+ExpressionLibrary::~ExpressionLibrary()
+{ }
+
+size_t ExpressionLibrary::GetCount() const
+{
+	return header->expressionCount;
+}
+
+std::string ExpressionLibrary::GetExpression(size_t index) const
+{
+	const ExpressionLibraryEntry& entry = entries[index];
+	return std::string(strings + entry.exprOffset, entry.exprLength);
+}
+
+std::string ExpressionLibrary::GetDerivativeExpression(size_t index) const
+{
+	const ExpressionLibraryEntry& entry = entries[index];
+	return std::string(strings + entry.exprOffset + entry.exprLength, entry.derivativeLength);
+}
+
+size_t ExpressionLibrary::Find(const std::string& expr) const
+{
+	const auto found = indices.find(std::string_view(expr));
+	return found != indices.end() ? found->second : NOT_FOUND;
+}
+
+std::shared_ptr<const CachedExpression> ExpressionLibrary::Load(size_t index) const
+{
+	const ExpressionLibraryEntry& entry = entries[index];
+	auto loaded = std::make_shared<CachedExpression>();
+	loaded->function = LoadNodes(GetExpression(index), entry.functionFirstNode, entry.functionNodeCount);
+	if (entry.derivativeNodeCount > 0) loaded->derivative = LoadNodes(GetDerivativeExpression(index), entry.derivativeFirstNode, entry.derivativeNodeCount);
+	return loaded;
+}
+
+void ExpressionLibrary::Preload(ExpressionCache& cache) const
+{
+	for (size_t i = 0; i < GetCount(); ++i) cache.Add(GetExpression(i), Load(i));
+}
+
+std::shared_ptr<const CompiledExpression> ExpressionLibrary::LoadNodes(const std::string& expr, uint64_t firstNode, uint32_t nodeCount) const
+{
+	std::vector<ExpressionNode> loadedNodes;
+	loadedNodes.reserve(nodeCount);
+	for (uint32_t i = 0; i < nodeCount; ++i)
+	{
+		const SerializedNode& node = nodes[firstNode + i];
+		loadedNodes.push_back({ static_cast<NodeOp>(node.op), static_cast<size_t>(node.lhs), static_cast<size_t>(node.rhs), node.value });
+	}
+	return std::make_shared<CompiledExpression>(expr, std::move(loadedNodes), logger);
+}
+
+namespace
+{
+	uint64_t Checksum(const char* data, size_t size)
+	{
+		uint64_t hash = FNV_OFFSET_BASIS;
+		for (size_t i = 0; i < size; ++i)
+		{
+			hash ^= static_cast<unsigned char>(data[i]);
+			hash *= FNV_PRIME;
+		}
+		return hash;
+	}
+
+	uint64_t AlignTo8(uint64_t offset)
+	{
+		return (offset + 7) & ~static_cast<uint64_t>(7);
+	}
+}
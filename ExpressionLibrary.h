@@ -0,0 +1,116 @@
+// Binary library of compiled expressions and their derivatives, so a catalog of expressions can be parsed and
+// differentiated once, ahead of time, and then mapped in at startup
+//
+// Library file: ExpressionLibraryHeader, then expressionCount ExpressionLibraryEntry, then nodeCount SerializedNode
+// holding the nodes of every function and derivative one after the other, then the expression strings
+// Node operands are indices within their own expression and everything else is an offset from the start of the file,
+// so the file can be mapped at any address. checksum is the FNV-1a hash of everything after the header
+// NodeOp values are stored as numbers, so new operations must be added to the end of NodeOp
+// All values are little-endian
+#pragma once
+
+#include "CompiledExpression.h"
+#include "ExpressionCache.h"
+#include "Logger.h"
+#include "MappedFile.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+const uint32_t EXPRESSION_LIBRARY_MAGIC = 0x4C454652; // "RFEL"
+const uint32_t EXPRESSION_LIBRARY_VERSION = 1;
+
+struct ExpressionLibraryHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t expressionCount;
+	uint64_t entriesOffset;
+	uint64_t nodeCount;
+	uint64_t nodesOffset;
+	uint64_t stringsOffset;
+	uint64_t fileSize;
+	uint64_t checksum;
+};
+
+struct ExpressionLibraryEntry
+{
+	uint64_t exprOffset; // from stringsOffset
+	uint32_t exprLength;
+	uint32_t functionNodeCount;
+	uint64_t functionFirstNode; // index into the node table
+	uint64_t derivativeFirstNode;
+	uint32_t derivativeNodeCount; // 0 when the derivative could not be found
+	uint32_t derivativeLength; // the derivative's expression string follows the expression's
+};
+
+struct SerializedNode
+{
+	uint32_t op; // NodeOp
+	uint32_t reserved;
+	uint64_t lhs;
+	uint64_t rhs;
+	double value;
+};
+
+static_assert(sizeof(ExpressionLibraryHeader) == 64, "ExpressionLibraryHeader layout changed");
+static_assert(sizeof(ExpressionLibraryEntry) == 40, "ExpressionLibraryEntry layout changed");
+static_assert(sizeof(SerializedNode) == 32, "SerializedNode layout changed");
+
+// Collects compiled expressions in memory and writes them out as a library file
+class ExpressionLibraryWriter
+{
+public:
+	ExpressionLibraryWriter();
+	~ExpressionLibraryWriter();
+
+	// derivative may be null. Adding an expression that is already there does nothing
+	// the library has nowhere to keep parameter names, so expressions with parameters throw std::invalid_argument
+	void Add(const CompiledExpression& function, const CompiledExpression* derivative);
+
+	size_t GetCount() const;
+	void Write(const std::string& path) const;
+private:
+	void AppendNodes(const CompiledExpression& expression);
+
+	std::vector<std::string> expressions;
+	std::vector<std::string> derivatives;
+	std::unordered_map<std::string, size_t> expressionIndices;
+	std::vector<ExpressionLibraryEntry> entries;
+	std::vector<SerializedNode> nodes;
+};
+
+// Maps a library file, checking its checksum and that its tables fit inside the file
+// Nothing is compiled until an expression is loaded
+class ExpressionLibrary
+{
+public:
+	static const size_t NOT_FOUND = static_cast<size_t>(-1);
+
+	ExpressionLibrary() = delete;
+	ExpressionLibrary(const std::string& path, const std::shared_ptr<Logger>& loggerIn);
+	~ExpressionLibrary();
+
+	size_t GetCount() const;
+	std::string GetExpression(size_t index) const;
+	size_t Find(const std::string& expr) const; // NOT_FOUND if the library does not have it
+
+	// builds the compiled function and derivative of an expression straight from its stored nodes
+	std::shared_ptr<const CachedExpression> Load(size_t index) const;
+	// loads every expression into the cache
+	void Preload(ExpressionCache& cache) const;
+private:
+	std::string GetDerivativeExpression(size_t index) const;
+	std::shared_ptr<const CompiledExpression> LoadNodes(const std::string& expr, uint64_t firstNode, uint32_t nodeCount) const;
+
+	std::unique_ptr<MappedFile> file;
+	const ExpressionLibraryHeader* header;
+	const ExpressionLibraryEntry* entries;
+	const SerializedNode* nodes;
+	const char* strings;
+	std::unordered_map<std::string_view, size_t> indices; // views into the mapped strings
+	std::shared_ptr<Logger> logger;
+};
@@ -0,0 +1,242 @@
+// Polynomial approximations of exp, ln, sin, cos and tan, and powers built on them, for evaluating with MathAccuracy::FAST
+// Each comes as a kernel, which only holds on part of the range but has no branches and no library calls, so a loop
+// over EVALUATION_LANES of them compiles to SIMD instructions, and as a full function that handles every input by
+// going to the kernel when it can. Loops run the kernel on every lane, then redo the lanes outside its range
+// Measured against long double versions of the functions on 5 million random points per range:
+//     Exp    2.5 ulp for EXP_MIN <= x <= EXP_MAX. Below EXP_MIN it flushes to 0, and above EXP_MAX it is infinity
+//     Log    2 ulp for all positive x, including subnormals. NaN for x < 0 and -infinity for 0
+//     Sin    2.5 ulp, or 2E-16 absolute next to the zeros of sin
+//     Cos    2.5 ulp, or 2E-16 absolute next to the zeros of cos
+//     Tan    4 ulp, or 2E-16 absolute next to the zeros of tan
+//     Pow    |n| - 1 ulp for whole exponents n up to MAX_SQUARING_EXPONENT, and 1 ulp more for negative n (12.2 ulp
+//            measured for n = 16, 13.9 for n = -16), otherwise the error of Exp plus that of Log times |exponent ln(base)|.
+//            Negative bases to other exponents go to the library
+// The trig kernels hold for |x| <= TRIG_LIMIT. Past TRIG_LIMIT the argument reduction loses accuracy, so the full
+// functions use the library functions there. The library functions themselves are within about 0.5 ulp
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+namespace fastmath
+{
+	const double TRIG_LIMIT = 1E5; // largest |x| the trig kernels reduce accurately
+
+	inline double FromBits(uint64_t bits)
+	{
+		double value;
+		memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+	inline uint64_t ToBits(double value)
+	{
+		uint64_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		return bits;
+	}
+
+	const double EXP_MIN = -708.0; // range of ExpKernel, beyond it e^x is subnormal or overflows
+	const double EXP_MAX = 709.0;
+	const double LOG_MIN = 2.2250738585072014e-308; // smallest normal double, the bottom of the range of LogKernel
+	const double SHIFTER = 6755399441055744.0; // 1.5 * 2^52, adding it pushes the fraction bits out
+	const double LN2_HI = 6.93147180369123816490e-01; // ln(2) split in two so k ln(2) is exact for the k that can occur
+	const double LN2_LO = 1.90821492927058770002e-10;
+
+	inline bool InExpRange(double x) { return x >= EXP_MIN && x <= EXP_MAX; }
+	inline bool InLogRange(double x) { return x >= LOG_MIN && x <= std::numeric_limits<double>::max(); }
+	inline bool InTrigRange(double x) { return x >= -TRIG_LIMIT && x <= TRIG_LIMIT; }
+
+	// e^x for EXP_MIN <= x <= EXP_MAX
+	inline double ExpKernel(double x)
+	{
+		// e^x = 2^k e^r with r = x - k ln(2), |r| <= ln(2) / 2
+		const double shifted = x * 1.44269504088896338700 + SHIFTER;
+		const double k = shifted - SHIFTER;
+		const double r = (x - k * LN2_HI) - k * LN2_LO;
+
+		// Taylor series to r^12, whose truncation error is below 2E-17 on this range
+		double p = 1.0 / 479001600.0;
+		p = p * r + 1.0 / 39916800.0;
+		p = p * r + 1.0 / 3628800.0;
+		p = p * r + 1.0 / 362880.0;
+		p = p * r + 1.0 / 40320.0;
+		p = p * r + 1.0 / 5040.0;
+		p = p * r + 1.0 / 720.0;
+		p = p * r + 1.0 / 120.0;
+		p = p * r + 1.0 / 24.0;
+		p = p * r + 1.0 / 6.0;
+		p = p * r + 0.5;
+		// e^r - 1 first, so the 1 is only added once, after the small terms are summed
+		const double expR = 1.0 + (r + r * r * p);
+
+		// 2^k built directly in the exponent bits. The low bits of shifted hold k, so it never goes through an
+		// integer conversion, which has no vector instruction
+		return expR * FromBits((ToBits(shifted) + 1023) << 52);
+	}
+
+	// ln(x) for normal, positive, finite x
+	inline double LogKernel(double x)
+	{
+		// x = 2^k m with sqrt(1/2) <= m < sqrt(2), then ln(m) = 2 atanh(s) with s = (m - 1) / (m + 1), |s| < 0.172
+		// subtracting the bits of sqrt(1/2) leaves k in the exponent field, and taking those out of x leaves m
+		const uint64_t bits = ToBits(x);
+		const uint64_t offset = bits - 0x3FE6A09E667F3BCDULL;
+		// k + 2048 placed in the fraction of 2^52 turns into a double without an integer conversion
+		const double k = (FromBits(0x4330000000000000ULL | (((offset >> 52) + 2048) & 0xFFF)) - 4503599627370496.0) - 2048.0;
+		const double m = FromBits(bits - (offset & 0xFFF0000000000000ULL));
+		const double s = (m - 1.0) / (m + 1.0);
+		const double z = s * s;
+
+		// atanh series to s^23, whose truncation error is below 1E-19 on this range
+		double p = 1.0 / 23.0;
+		p = p * z + 1.0 / 21.0;
+		p = p * z + 1.0 / 19.0;
+		p = p * z + 1.0 / 17.0;
+		p = p * z + 1.0 / 15.0;
+		p = p * z + 1.0 / 13.0;
+		p = p * z + 1.0 / 11.0;
+		p = p * z + 1.0 / 9.0;
+		p = p * z + 1.0 / 7.0;
+		p = p * z + 1.0 / 5.0;
+		p = p * z + 1.0 / 3.0;
+		const double lnM = 2.0 * s + 2.0 * s * z * p;
+		return k * LN2_HI + (lnM + k * LN2_LO);
+	}
+
+	// x = k pi/2 + r with |r| <= pi/4. pi/2 is split in three so k pi/2 is exact for |k| < 2^20
+	// the low bits of quadrant are those of k
+	inline double ReduceQuarterPi(double x, uint64_t& quadrant)
+	{
+		const double PIO2_1 = 1.57079632673412561417e+00;
+		const double PIO2_2 = 6.07710050630396597660e-11;
+		const double PIO2_3 = 2.02226624879595063154e-21;
+		const double shifted = x * 6.36619772367581382433e-01 + SHIFTER;
+		const double k = shifted - SHIFTER;
+		quadrant = ToBits(shifted);
+		return ((x - k * PIO2_1) - k * PIO2_2) - k * PIO2_3;
+	}
+
+	// sin and cos of |r| <= pi/4, the minimax polynomials of fdlibm's __kernel_sin and __kernel_cos
+	inline double SinPolynomial(double r)
+	{
+		const double z = r * r;
+		double p = 1.58969099521155010221e-10;
+		p = p * z - 2.50507602534068634195e-08;
+		p = p * z + 2.75573137070700676789e-06;
+		p = p * z - 1.98412698298579493134e-04;
+		p = p * z + 8.33333333332248946124e-03;
+		p = p * z - 1.66666666666666324348e-01;
+		return r + r * z * p;
+	}
+
+	inline double CosPolynomial(double r)
+	{
+		const double z = r * r;
+		double p = -1.13596475577881948265e-11;
+		p = p * z + 2.08757232129817482790e-09;
+		p = p * z - 2.75573143513906633035e-07;
+		p = p * z + 2.48015872894767294178e-05;
+		p = p * z - 1.38888888888741095749e-03;
+		p = p * z + 4.16666666666666019037e-02;
+		const double halfZ = 0.5 * z;
+		const double w = 1.0 - halfZ;
+		// the rounding of 1 - z/2 is added back, which keeps the result within an ulp
+		return w + (((1.0 - w) - halfZ) + z * z * p);
+	}
+
+	// sin, cos and tan for |x| <= TRIG_LIMIT
+	inline double SinKernel(double x)
+	{
+		uint64_t quadrant;
+		const double r = ReduceQuarterPi(x, quadrant);
+		const double s = SinPolynomial(r);
+		const double c = CosPolynomial(r);
+		// the sign is flipped on the bits, a negation picked by a branch would stop the loops from vectorizing
+		const double value = (quadrant & 1) != 0 ? c : s;
+		return FromBits(ToBits(value) ^ ((quadrant & 2) << 62));
+	}
+
+	inline double CosKernel(double x)
+	{
+		uint64_t quadrant;
+		const double r = ReduceQuarterPi(x, quadrant);
+		const double s = SinPolynomial(r);
+		const double c = CosPolynomial(r);
+		const double value = (quadrant & 1) != 0 ? s : c;
+		return FromBits(ToBits(value) ^ (((quadrant + 1) & 2) << 62));
+	}
+
+	inline double TanKernel(double x)
+	{
+		uint64_t quadrant;
+		const double r = ReduceQuarterPi(x, quadrant);
+		const double s = SinPolynomial(r);
+		const double c = CosPolynomial(r);
+		// one division either way, picking the operands first keeps the division out of the branch
+		const bool odd = (quadrant & 1) != 0;
+		return (odd ? -c : s) / (odd ? s : c);
+	}
+
+	inline double Exp(double x)
+	{
+		if (InExpRange(x)) return ExpKernel(x);
+		if (x != x) return x;
+		return x < EXP_MIN ? 0.0 : std::numeric_limits<double>::infinity();
+	}
+
+	inline double Log(double x)
+	{
+		if (InLogRange(x)) return LogKernel(x);
+		// subnormals are scaled up by 2^54 first
+		if (x > 0.0 && x < LOG_MIN) return LogKernel(x * 18014398509481984.0) - 54.0 * LN2_HI - 54.0 * LN2_LO;
+		if (x == 0.0) return -std::numeric_limits<double>::infinity();
+		return x == std::numeric_limits<double>::infinity() ? x : std::numeric_limits<double>::quiet_NaN();
+	}
+
+	inline double Sin(double x)
+	{
+		return InTrigRange(x) ? SinKernel(x) : std::sin(x);
+	}
+
+	inline double Cos(double x)
+	{
+		return InTrigRange(x) ? CosKernel(x) : std::cos(x);
+	}
+
+	inline double Tan(double x)
+	{
+		return InTrigRange(x) ? TanKernel(x) : std::tan(x);
+	}
+
+	// small whole exponents are done by repeated squaring, which is faster than going through Exp and Log and more accurate
+	// for the powers that show up in polynomials. Every multiply rounds and the squarings double the error before them,
+	// which is where the |n| - 1 ulp comes from
+	inline bool UsesSquaring(double exponent)
+	{
+		const double MAX_SQUARING_EXPONENT = 16.0;
+		return exponent == std::floor(exponent) && std::abs(exponent) <= MAX_SQUARING_EXPONENT;
+	}
+
+	inline double Pow(double base, double exponent)
+	{
+		// positive bases to exponents that are not done by squaring are e^(exponent ln(base))
+		if (UsesSquaring(exponent))
+		{
+			unsigned n = static_cast<unsigned>(std::abs(exponent));
+			double result = 1.0;
+			double square = base;
+			while (n != 0)
+			{
+				if ((n & 1) != 0) result *= square;
+				square *= square;
+				n >>= 1;
+			}
+			return exponent < 0.0 ? 1.0 / result : result;
+		}
+		if (base > 0.0) return Exp(exponent * Log(base));
+		return std::pow(base, exponent);
+	}
+};
@@ -0,0 +1,110 @@
+// Implements IncrementalEvaluator
+
+#include "pch.h"
+#include "IncrementalEvaluator.h"
+
+#include <algorithm>
+
+IncrementalEvaluator::IncrementalEvaluator(const CompiledExpression& expressionIn) :
+	expression(expressionIn),
+	values(expressionIn.GetNodes().size(), 0.0),
+	lastX(0.0),
+	lastParameters(*expressionIn.GetParameterValues()),
+	evaluated(false),
+	dependents(1 + lastParameters.size()),
+	dirty(values.size(), false),
+	recomputed(0)
+{
+	// one forward sweep per input, a node depends on an input if either of its operands does
+	const std::vector<ExpressionNode>& nodes = expression.GetNodes();
+	std::vector<bool> reaches(nodes.size());
+	for (size_t input = 0; input < dependents.size(); ++input)
+	{
+		for (size_t i = 0; i < nodes.size(); ++i)
+		{
+			const ExpressionNode& node = nodes[i];
+			const int operands = CompiledExpression::OperandCount(node.op);
+			if (operands == 0)
+			{
+				reaches[i] = input == 0 ? node.op == NodeOp::VARIABLE : node.op == NodeOp::PARAMETER && node.lhs == input - 1;
+			}
+			else
+			{
+				reaches[i] = reaches[node.lhs] || (operands == 2 && reaches[node.rhs]);
+			}
+			if (reaches[i]) dependents[input].push_back(i);
+		}
+	}
+}
+
+IncrementalEvaluator::~IncrementalEvaluator()
+{ }
+
+double IncrementalEvaluator::Evaluate(double x)
+{
+	const std::vector<ExpressionNode>& nodes = expression.GetNodes();
+	const std::vector<double>& parameters = *expression.GetParameterValues();
+
+	// a NaN never compares equal, so an input that is NaN counts as changed every time
+	if (!evaluated)
+	{
+		dirtyNodes.resize(nodes.size());
+		for (size_t i = 0; i < nodes.size(); ++i) dirtyNodes[i] = i;
+		std::fill(dirty.begin(), dirty.end(), true);
+		evaluated = true;
+	}
+	else
+	{
+		size_t changed = 0;
+		if (!(x == lastX))
+		{
+			MarkChanged(0);
+			++changed;
+		}
+		for (size_t i = 0; i < parameters.size(); ++i)
+		{
+			if (!(parameters[i] == lastParameters[i]))
+			{
+				MarkChanged(1 + i);
+				++changed;
+			}
+		}
+		// each input's nodes are in order, but changes to several inputs leave the list in several sorted runs
+		if (changed > 1) std::sort(dirtyNodes.begin(), dirtyNodes.end());
+	}
+	lastX = x;
+	lastParameters = parameters;
+
+	for (const size_t i : dirtyNodes)
+	{
+		const ExpressionNode& node = nodes[i];
+		switch (node.op)
+		{
+		case NodeOp::CONSTANT: values[i] = node.value; break;
+		case NodeOp::VARIABLE: values[i] = x; break;
+		case NodeOp::PARAMETER: values[i] = parameters[node.lhs]; break;
+		default:
+			values[i] = CompiledExpression::Apply(node.op, values[node.lhs], CompiledExpression::OperandCount(node.op) == 2 ? values[node.rhs] : 0.0);
+			break;
+		}
+		dirty[i] = false;
+	}
+	recomputed = dirtyNodes.size();
+	dirtyNodes.clear();
+	return values.back();
+}
+
+size_t IncrementalEvaluator::GetRecomputedCount() const
+{
+	return recomputed;
+}
+
+void IncrementalEvaluator::MarkChanged(size_t input)
+{
+	for (const size_t i : dependents[input])
+	{
+		if (dirty[i]) continue;
+		dirty[i] = true;
+		dirtyNodes.push_back(i);
+	}
+}
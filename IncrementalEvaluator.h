@@ -0,0 +1,37 @@
+// Evaluates a CompiledExpression over and over, redoing only the nodes whose inputs changed since the last time
+// Every node's value is kept. Changing a parameter only recomputes the nodes that depend on it, so a parameter study
+// at a fixed x touches just the path from that parameter to the result. When x changes, the parts of the expression
+// that only depend on parameters and constants keep their values
+#pragma once
+
+#include "CompiledExpression.h"
+#include <vector>
+
+class IncrementalEvaluator
+{
+public:
+	IncrementalEvaluator() = delete;
+	// the expression must outlive the evaluator. Its parameters are read on every Evaluate, so they can be changed
+	// through the expression or through any copy of it
+	explicit IncrementalEvaluator(const CompiledExpression& expressionIn);
+	~IncrementalEvaluator();
+
+	// the value at x with the expression's current parameters, the same value CompiledExpression::Evaluate gives
+	double Evaluate(double x);
+
+	// the number of nodes the last Evaluate computed
+	size_t GetRecomputedCount() const;
+private:
+	// marks the nodes depending on input, which is 0 for x and 1 + the index for parameters
+	void MarkChanged(size_t input);
+
+	const CompiledExpression& expression;
+	std::vector<double> values; // the value of every node as of the last Evaluate
+	double lastX;
+	std::vector<double> lastParameters;
+	bool evaluated; // false until the first Evaluate, which computes everything
+	std::vector<std::vector<size_t>> dependents; // for each input, the nodes depending on it, in evaluation order
+	std::vector<bool> dirty;
+	std::vector<size_t> dirtyNodes;
+	size_t recomputed;
+};
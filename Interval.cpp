@@ -0,0 +1,259 @@
+// Implements interval arithmetic
+// Results are computed with the default rounding and then widened: by one ulp on each side for the basic
+// operations, which are correctly rounded, and by LIBRARY_ULPS for the library functions, which are not
+// guaranteed to be but are within an ulp or so on the platforms we build for
+
+#include "pch.h"
+#include "Interval.h"
+
+#include <algorithm>
+
+namespace
+{
+	const int LIBRARY_ULPS = 2;
+	const double HALF_PI = M_PI / 2;
+	const double HALF_PI_UPPER = 1.5707963267948968; // the double just above pi/2, which atan and asin never exceed
+	const double TWO_PI = 2 * M_PI;
+
+	Interval Widen(double lo, double hi, int ulps);
+	Interval IntegerPower(const Interval& base, long long n);
+	bool ContainsPoint(const Interval& a, double offset, double period);
+}
+
+Interval operator-(const Interval& a)
+{
+	return Interval(-a.hi, -a.lo);
+}
+
+Interval operator+(const Interval& a, const Interval& b)
+{
+	if (a.IsEmpty() || b.IsEmpty()) return Interval::Empty();
+	return Widen(a.lo + b.lo, a.hi + b.hi, 1);
+}
+
+Interval operator-(const Interval& a, const Interval& b)
+{
+	if (a.IsEmpty() || b.IsEmpty()) return Interval::Empty();
+	return Widen(a.lo - b.hi, a.hi - b.lo, 1);
+}
+
+Interval operator*(const Interval& a, const Interval& b)
+{
+	if (a.IsEmpty() || b.IsEmpty()) return Interval::Empty();
+	const double products[] = { a.lo * b.lo, a.lo * b.hi, a.hi * b.lo, a.hi * b.hi };
+	// 0 * inf, nothing sensible can be said
+	for (double product : products) if (std::isnan(product)) return Interval::Entire();
+	return Widen(*std::min_element(products, products + 4), *std::max_element(products, products + 4), 1);
+}
+
+Interval operator/(const Interval& a, const Interval& b)
+{
+	if (a.IsEmpty() || b.IsEmpty()) return Interval::Empty();
+	if (b.Contains(0.0))
+	{
+		// dividing by 0 is undefined, anything else the divisor holds could give anything
+		if (b.lo == 0.0 && b.hi == 0.0) return Interval::Empty();
+		return Interval::Entire();
+	}
+	const double quotients[] = { a.lo / b.lo, a.lo / b.hi, a.hi / b.lo, a.hi / b.hi };
+	for (double quotient : quotients) if (std::isnan(quotient)) return Interval::Entire();
+	return Widen(*std::min_element(quotients, quotients + 4), *std::max_element(quotients, quotients + 4), 1);
+}
+
+Interval& operator-=(Interval& a, const Interval& b)
+{
+	a = a - b;
+	return a;
+}
+
+Interval pow(const Interval& base, const Interval& exponent)
+{
+	if (base.IsEmpty() || exponent.IsEmpty()) return Interval::Empty();
+
+	// whole number exponents are the common case, and the only one defined for negative bases
+	if (exponent.lo == exponent.hi && exponent.lo == std::floor(exponent.lo) && std::abs(exponent.lo) < 1E9)
+	{
+		return IntegerPower(base, static_cast<long long>(exponent.lo));
+	}
+
+	// otherwise only the positive part of the base counts, as b^y = e^(y ln(b))
+	return exp(exponent * log(base));
+}
+
+Interval exp(const Interval& a)
+{
+	if (a.IsEmpty()) return Interval::Empty();
+	const Interval result = Widen(std::exp(a.lo), std::exp(a.hi), LIBRARY_ULPS);
+	return Interval(std::max(result.lo, 0.0), result.hi);
+}
+
+Interval log(const Interval& a)
+{
+	if (a.IsEmpty() || a.hi <= 0.0) return Interval::Empty();
+	const double lo = a.lo > 0.0 ? std::log(a.lo) : -std::numeric_limits<double>::infinity();
+	return Widen(lo, std::log(a.hi), LIBRARY_ULPS);
+}
+
+Interval sin(const Interval& a)
+{
+	if (a.IsEmpty()) return Interval::Empty();
+	if (a.Width() >= TWO_PI || !std::isfinite(a.Width())) return Interval(-1.0, 1.0);
+
+	// monotonic between the extremes, so the range is the ends plus whichever extremes are inside
+	const Interval ends = Widen(std::min(std::sin(a.lo), std::sin(a.hi)), std::max(std::sin(a.lo), std::sin(a.hi)), LIBRARY_ULPS);
+	const double lo = ContainsPoint(a, -HALF_PI, TWO_PI) ? -1.0 : std::max(ends.lo, -1.0);
+	const double hi = ContainsPoint(a, HALF_PI, TWO_PI) ? 1.0 : std::min(ends.hi, 1.0);
+	return Interval(lo, hi);
+}
+
+Interval cos(const Interval& a)
+{
+	if (a.IsEmpty()) return Interval::Empty();
+	if (a.Width() >= TWO_PI || !std::isfinite(a.Width())) return Interval(-1.0, 1.0);
+
+	const Interval ends = Widen(std::min(std::cos(a.lo), std::cos(a.hi)), std::max(std::cos(a.lo), std::cos(a.hi)), LIBRARY_ULPS);
+	const double lo = ContainsPoint(a, M_PI, TWO_PI) ? -1.0 : std::max(ends.lo, -1.0);
+	const double hi = ContainsPoint(a, 0.0, TWO_PI) ? 1.0 : std::min(ends.hi, 1.0);
+	return Interval(lo, hi);
+}
+
+Interval tan(const Interval& a)
+{
+	if (a.IsEmpty()) return Interval::Empty();
+	if (a.Width() >= M_PI || !std::isfinite(a.Width()) || ContainsPoint(a, HALF_PI, M_PI)) return Interval::Entire();
+	return Widen(std::tan(a.lo), std::tan(a.hi), LIBRARY_ULPS);
+}
+
+Interval sqrt(const Interval& a)
+{
+	if (a.IsEmpty() || a.hi < 0.0) return Interval::Empty();
+	// sqrt is correctly rounded, like the basic operations
+	const Interval result = Widen(std::sqrt(std::max(a.lo, 0.0)), std::sqrt(a.hi), 1);
+	return Interval(std::max(result.lo, 0.0), result.hi);
+}
+
+Interval abs(const Interval& a)
+{
+	if (a.IsEmpty()) return Interval::Empty();
+	if (a.lo >= 0.0) return a;
+	if (a.hi <= 0.0) return -a;
+	return Interval(0.0, std::max(-a.lo, a.hi));
+}
+
+Interval atan(const Interval& a)
+{
+	if (a.IsEmpty()) return Interval::Empty();
+	const Interval result = Widen(std::atan(a.lo), std::atan(a.hi), LIBRARY_ULPS);
+	return Interval(std::max(result.lo, -HALF_PI_UPPER), std::min(result.hi, HALF_PI_UPPER));
+}
+
+Interval asin(const Interval& a)
+{
+	const Interval inDomain = Intersect(a, Interval(-1.0, 1.0));
+	if (inDomain.IsEmpty()) return Interval::Empty();
+	const Interval result = Widen(std::asin(inDomain.lo), std::asin(inDomain.hi), LIBRARY_ULPS);
+	return Interval(std::max(result.lo, -HALF_PI_UPPER), std::min(result.hi, HALF_PI_UPPER));
+}
+
+Interval acos(const Interval& a)
+{
+	const Interval inDomain = Intersect(a, Interval(-1.0, 1.0));
+	if (inDomain.IsEmpty()) return Interval::Empty();
+	// decreasing
+	const Interval result = Widen(std::acos(inDomain.hi), std::acos(inDomain.lo), LIBRARY_ULPS);
+	return Interval(std::max(result.lo, 0.0), result.hi);
+}
+
+Interval sinh(const Interval& a)
+{
+	if (a.IsEmpty()) return Interval::Empty();
+	return Widen(std::sinh(a.lo), std::sinh(a.hi), LIBRARY_ULPS);
+}
+
+Interval cosh(const Interval& a)
+{
+	// even and increasing away from 0, like abs
+	const Interval magnitude = abs(a);
+	if (magnitude.IsEmpty()) return Interval::Empty();
+	const Interval result = Widen(std::cosh(magnitude.lo), std::cosh(magnitude.hi), LIBRARY_ULPS);
+	return Interval(std::max(result.lo, 1.0), result.hi);
+}
+
+Interval tanh(const Interval& a)
+{
+	if (a.IsEmpty()) return Interval::Empty();
+	const Interval result = Widen(std::tanh(a.lo), std::tanh(a.hi), LIBRARY_ULPS);
+	return Interval(std::max(result.lo, -1.0), std::min(result.hi, 1.0));
+}
+
+Interval log10(const Interval& a)
+{
+	if (a.IsEmpty() || a.hi <= 0.0) return Interval::Empty();
+	const double lo = a.lo > 0.0 ? std::log10(a.lo) : -std::numeric_limits<double>::infinity();
+	return Widen(lo, std::log10(a.hi), LIBRARY_ULPS);
+}
+
+Interval min(const Interval& a, const Interval& b)
+{
+	// exact, no rounding involved
+	if (a.IsEmpty() || b.IsEmpty()) return Interval::Empty();
+	return Interval(std::min(a.lo, b.lo), std::min(a.hi, b.hi));
+}
+
+Interval max(const Interval& a, const Interval& b)
+{
+	if (a.IsEmpty() || b.IsEmpty()) return Interval::Empty();
+	return Interval(std::max(a.lo, b.lo), std::max(a.hi, b.hi));
+}
+
+Interval Sign(const Interval& a)
+{
+	if (a.IsEmpty()) return Interval::Empty();
+	const double lo = a.lo > 0.0 ? 1.0 : (a.lo < 0.0 ? -1.0 : 0.0);
+	const double hi = a.hi > 0.0 ? 1.0 : (a.hi < 0.0 ? -1.0 : 0.0);
+	return Interval(lo, hi);
+}
+
+Interval Intersect(const Interval& a, const Interval& b)
+{
+	if (a.IsEmpty() || b.IsEmpty()) return Interval::Empty();
+	const double lo = std::max(a.lo, b.lo);
+	const double hi = std::min(a.hi, b.hi);
+	if (lo > hi) return Interval::Empty();
+	return Interval(lo, hi);
+}
+
+namespace
+{
+	Interval Widen(double lo, double hi, int ulps)
+	{
+		for (int i = 0; i < ulps; ++i)
+		{
+			lo = std::nextafter(lo, -std::numeric_limits<double>::infinity());
+			hi = std::nextafter(hi, std::numeric_limits<double>::infinity());
+		}
+		return Interval(lo, hi);
+	}
+
+	Interval IntegerPower(const Interval& base, long long n)
+	{
+		if (n == 0) return Interval(1.0);
+		if (n < 0) return Interval(1.0) / IntegerPower(base, -n);
+
+		const double loPower = std::pow(base.lo, static_cast<double>(n));
+		const double hiPower = std::pow(base.hi, static_cast<double>(n));
+		if (n % 2 == 1) return Widen(loPower, hiPower, LIBRARY_ULPS); // increasing everywhere
+		if (base.lo >= 0.0) return Widen(loPower, hiPower, LIBRARY_ULPS);
+		if (base.hi <= 0.0) return Widen(hiPower, loPower, LIBRARY_ULPS);
+		return Interval(0.0, Widen(0.0, std::max(loPower, hiPower), LIBRARY_ULPS).hi);
+	}
+
+	bool ContainsPoint(const Interval& a, double offset, double period)
+	{
+		// whether a holds offset + k * period for some whole k. The points are only known to within rounding,
+		// so a near miss counts as a hit, which can only make the result wider
+		const double margin = 1E-12 * (std::abs(a.lo) + std::abs(a.hi) + 1.0);
+		const double k = std::ceil((a.lo - margin - offset) / period);
+		return offset + k * period <= a.hi + margin;
+	}
+}
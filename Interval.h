@@ -0,0 +1,56 @@
+// Closed intervals of doubles with outward rounding, so the true result of every operation on any values inside
+// the operands is inside the result
+// An interval holding NaN is empty, which is what functions give outside their domain (ln of negative values)
+#pragma once
+
+#include <cmath>
+#include <limits>
+
+struct Interval
+{
+	Interval() : lo(0.0), hi(0.0) { }
+	explicit Interval(double value) : lo(value), hi(value) { }
+	Interval(double loIn, double hiIn) : lo(loIn), hi(hiIn) { }
+
+	static Interval Empty() { return Interval(std::numeric_limits<double>::quiet_NaN(), std::numeric_limits<double>::quiet_NaN()); }
+	static Interval Entire() { return Interval(-std::numeric_limits<double>::infinity(), std::numeric_limits<double>::infinity()); }
+
+	bool IsEmpty() const { return std::isnan(lo) || std::isnan(hi); }
+	bool Contains(double x) const { return lo <= x && x <= hi; }
+	double Width() const { return hi - lo; }
+	double Mid() const { return lo + (hi - lo) / 2; }
+
+	double lo;
+	double hi;
+};
+
+Interval operator-(const Interval& a);
+Interval operator+(const Interval& a, const Interval& b);
+Interval operator-(const Interval& a, const Interval& b);
+Interval operator*(const Interval& a, const Interval& b);
+Interval operator/(const Interval& a, const Interval& b);
+Interval& operator-=(Interval& a, const Interval& b);
+
+// found through argument-dependent lookup by CompiledExpression::Evaluate
+Interval pow(const Interval& base, const Interval& exponent);
+Interval exp(const Interval& a);
+Interval log(const Interval& a);
+Interval sin(const Interval& a);
+Interval cos(const Interval& a);
+Interval tan(const Interval& a);
+Interval sqrt(const Interval& a);
+Interval abs(const Interval& a);
+Interval atan(const Interval& a);
+Interval asin(const Interval& a);
+Interval acos(const Interval& a);
+Interval sinh(const Interval& a);
+Interval cosh(const Interval& a);
+Interval tanh(const Interval& a);
+Interval log10(const Interval& a);
+Interval min(const Interval& a, const Interval& b);
+Interval max(const Interval& a, const Interval& b);
+// -1, 0 or 1 depending on the sign of the values in a
+Interval Sign(const Interval& a);
+
+// the part of a that is also in b, empty if they do not overlap
+Interval Intersect(const Interval& a, const Interval& b);
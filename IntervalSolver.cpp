@@ -0,0 +1,170 @@
+// Implements interval Newton branch-and-prune
+// Each box X is pruned by:
+//     f(X) not holding 0: no root in X, drop it
+//     f'(X) not holding 0: Newton's Method in interval form, N = m - f(m) / f'(X) with m the middle of X, holds
+//     every root in X, so X shrinks to N intersected with X. If N is strictly inside X, X holds exactly one root
+// and anything that does not shrink enough is split in two
+
+#include "pch.h"
+#include "IntervalSolver.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include "Parallel.h"
+
+namespace
+{
+	// split slightly off the middle, so that roots at round numbers (0 of a symmetric box, say) do not end up
+	// on the boundary between two boxes, where neither box can prove it holds the root
+	const double SPLIT_RATIO = 0.49609375;
+	const double CONTRACTION_NEEDED = 0.5; // a Newton step narrowing the box to less than this keeps it whole
+	const size_t BOXES_PER_WORKER = 16; // boxes handed out for the parallel part, per thread
+
+	struct Box
+	{
+		Interval x;
+		bool unique; // already proven to hold exactly one root
+	};
+
+	class BranchAndPrune
+	{
+	public:
+		BranchAndPrune(const CompiledExpression& functionIn, const CompiledExpression& derivativeIn, double toleranceIn, size_t maxBoxesIn) :
+			function(functionIn),
+			derivative(derivativeIn),
+			tolerance(toleranceIn),
+			maxBoxes(maxBoxesIn)
+		{ }
+
+		// prunes one box, pushing what is left of it onto boxes and any finished enclosure onto found
+		void Refine(const Box& box, std::vector<Box>& boxes, std::vector<RootEnclosure>& found);
+	private:
+		void Split(const Interval& x, bool unique, std::vector<Box>& boxes, std::vector<RootEnclosure>& found);
+
+		const CompiledExpression& function;
+		const CompiledExpression& derivative;
+		const double tolerance;
+		const size_t maxBoxes;
+		std::atomic<size_t> boxesSeen{ 0 };
+	};
+
+	std::vector<RootEnclosure> Merge(std::vector<RootEnclosure>& found);
+}
+
+std::vector<RootEnclosure> solvers::IntervalNewton(const CompiledExpression& function, const CompiledExpression& derivative, const Interval& box,
+	double tolerance, size_t maxBoxes)
+{
+	BranchAndPrune search(function, derivative, tolerance, maxBoxes);
+	std::vector<RootEnclosure> found;
+
+	// breadth first on this thread until there are enough boxes to go around
+	std::vector<Box> boxes = { { box, false } };
+	const size_t boxesWanted = parallel::WorkerCount(maxBoxes) * BOXES_PER_WORKER;
+	while (!boxes.empty() && boxes.size() < boxesWanted)
+	{
+		std::vector<Box> next;
+		for (const Box& current : boxes) search.Refine(current, next, found);
+		boxes.swap(next);
+	}
+
+	// then depth first from each of them in parallel
+	std::mutex foundMutex;
+	parallel::ParallelFor(boxes.size(), [&](size_t i)
+	{
+		std::vector<Box> stack = { boxes[i] };
+		std::vector<RootEnclosure> subtreeFound;
+		while (!stack.empty())
+		{
+			const Box current = stack.back();
+			stack.pop_back();
+			search.Refine(current, stack, subtreeFound);
+		}
+		std::lock_guard<std::mutex> lock(foundMutex);
+		found.insert(found.end(), subtreeFound.begin(), subtreeFound.end());
+	});
+
+	return Merge(found);
+}
+
+namespace
+{
+	void BranchAndPrune::Refine(const Box& box, std::vector<Box>& boxes, std::vector<RootEnclosure>& found)
+	{
+		if (++boxesSeen > maxBoxes)
+		{
+			// out of budget, hand back what is left unresolved
+			found.push_back({ box.x, false });
+			return;
+		}
+
+		const Interval funcVal = function.Evaluate(box.x);
+		if (funcVal.IsEmpty() || !funcVal.Contains(0.0)) return;
+
+		const Interval derivVal = derivative.Evaluate(box.x);
+		if (derivVal.IsEmpty() || derivVal.Contains(0.0))
+		{
+			// possibly several roots, or a multiple one, only splitting can tell
+			Split(box.x, box.unique, boxes, found);
+			return;
+		}
+
+		const double mid = box.x.Mid();
+		const Interval newton = Interval(mid) - function.Evaluate(Interval(mid)) / derivVal;
+		if (newton.IsEmpty())
+		{
+			Split(box.x, box.unique, boxes, found);
+			return;
+		}
+		const Interval narrowed = Intersect(newton, box.x);
+		if (narrowed.IsEmpty()) return;
+
+		const bool unique = box.unique || (newton.lo > box.x.lo && newton.hi < box.x.hi);
+		if (narrowed.Width() <= tolerance)
+		{
+			found.push_back({ narrowed, unique });
+		}
+		else if (narrowed.Width() < CONTRACTION_NEEDED * box.x.Width())
+		{
+			boxes.push_back({ narrowed, unique });
+		}
+		else
+		{
+			Split(narrowed, unique, boxes, found);
+		}
+	}
+
+	void BranchAndPrune::Split(const Interval& x, bool unique, std::vector<Box>& boxes, std::vector<RootEnclosure>& found)
+	{
+		const double split = x.lo + SPLIT_RATIO * (x.hi - x.lo);
+		if (x.Width() <= tolerance || !(split > x.lo && split < x.hi))
+		{
+			// as narrow as asked for, or as narrow as doubles get
+			found.push_back({ x, unique });
+			return;
+		}
+		// only one of the halves holds the root of a unique box, so both have to prove it again
+		boxes.push_back({ Interval(split, x.hi), false });
+		boxes.push_back({ Interval(x.lo, split), false });
+	}
+
+	std::vector<RootEnclosure> Merge(std::vector<RootEnclosure>& found)
+	{
+		// boxes share their ends, so a root on the boundary between two of them is found in both. Around a multiple root
+		// a whole run of boxes survives, and they become one enclosure, however wide
+		std::sort(found.begin(), found.end(), [](const RootEnclosure& a, const RootEnclosure& b) { return a.enclosure.lo < b.enclosure.lo; });
+		std::vector<RootEnclosure> merged;
+		for (const RootEnclosure& next : found)
+		{
+			if (!merged.empty() && next.enclosure.lo <= merged.back().enclosure.hi)
+			{
+				RootEnclosure& last = merged.back();
+				last.enclosure.hi = std::max(last.enclosure.hi, next.enclosure.hi);
+				last.unique = false;
+				continue;
+			}
+			merged.push_back(next);
+		}
+		return merged;
+	}
+}
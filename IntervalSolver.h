@@ -0,0 +1,25 @@
+// Finds every root of an expression inside a box, with guarantees, by interval Newton branch-and-prune
+#pragma once
+
+#include "CompiledExpression.h"
+#include "Interval.h"
+#include <vector>
+
+struct RootEnclosure
+{
+	Interval enclosure;
+	bool unique; // the enclosure provably holds exactly one root. Otherwise it may hold one or more, or none
+};
+
+namespace solvers
+{
+	// returns enclosures, sorted and not overlapping, covering every root of function in box: wherever they are not,
+	// there is provably no root. Boxes are refined until they are at most tolerance wide, except that once maxBoxes boxes
+	// have been looked at, whatever is left is returned as it is, marked not unique. Boxes that touch are then merged into
+	// one enclosure, so that a root is not reported twice, and that enclosure can be wider than tolerance where f is within
+	// rounding of 0 over a stretch, as around a multiple root (the triple root of tan(x)-x at 0 comes back 5E-8 wide for a
+	// tolerance of 1E-9). Merged enclosures are never marked unique
+	// subdivision runs across all cores. function and derivative must not log while this runs
+	std::vector<RootEnclosure> IntervalNewton(const CompiledExpression& function, const CompiledExpression& derivative, const Interval& box,
+		double tolerance, size_t maxBoxes);
+};
@@ -0,0 +1,103 @@
+// Implements Newton's Method in lockstep lanes
+
+#include "pch.h"
+#include "LaneSolver.h"
+
+#include <cmath>
+#include <optional>
+
+void solvers::NewtonLanes(const CompiledExpression& function, const CompiledExpression& derivative, const double* initialGuesses, size_t count,
+	const SolveOptions& options, SolveResult<double>* results, MathAccuracy accuracy)
+{
+	// lane state, structure of arrays so EvaluateLanes can read the iterates directly
+	// a lane is fresh when it was just given a guess and has not had its function value taken yet
+	double xs[EVALUATION_LANES] = {};
+	double funcVals[EVALUATION_LANES] = {};
+	double derivVals[EVALUATION_LANES] = {};
+	double steps[EVALUATION_LANES] = {};
+	size_t jobs[EVALUATION_LANES] = {};
+	int iterNums[EVALUATION_LANES] = {};
+	bool active[EVALUATION_LANES] = {};
+	bool fresh[EVALUATION_LANES] = {};
+	std::optional<ConvergenceMonitor<double>> monitors[EVALUATION_LANES];
+
+	size_t nextJob = 0;
+	size_t activeLanes = 0;
+	auto fill = [&](size_t lane)
+	{
+		if (nextJob >= count)
+		{
+			// nothing left, the lane keeps its last x so the evaluations stay harmless
+			active[lane] = false;
+			return;
+		}
+		xs[lane] = initialGuesses[nextJob];
+		jobs[lane] = nextJob++;
+		iterNums[lane] = 0;
+		active[lane] = true;
+		fresh[lane] = true;
+		monitors[lane].emplace(options);
+		++activeLanes;
+	};
+	auto retire = [&](size_t lane, SolveStatus status, int iterNum)
+	{
+		// the same counts Newton reports: one function evaluation per iterate and one derivative evaluation per step
+		results[jobs[lane]] = { xs[lane], iterNum, status, iterNums[lane] + 1, iterNums[lane] };
+		--activeLanes;
+		fill(lane);
+	};
+	for (size_t lane = 0; lane < EVALUATION_LANES; ++lane) fill(lane);
+
+	while (activeLanes > 0)
+	{
+		function.EvaluateLanes(xs, funcVals, accuracy);
+		SolveStatus reason;
+		for (size_t lane = 0; lane < EVALUATION_LANES; ++lane)
+		{
+			if (!active[lane]) continue;
+			if (fresh[lane])
+			{
+				fresh[lane] = false;
+				if (monitors[lane]->Start(xs[lane], funcVals[lane], reason))
+				{
+					retire(lane, reason, 1);
+					continue;
+				}
+			}
+			else if (monitors[lane]->Update(xs[lane], steps[lane], funcVals[lane], reason))
+			{
+				retire(lane, reason, std::min(iterNums[lane] + 1, options.maxSize));
+				continue;
+			}
+			if (IsConverged(funcVals[lane], options))
+			{
+				retire(lane, SolveStatus::CONVERGED, std::min(iterNums[lane] + 1, options.maxSize));
+			}
+			else if (iterNums[lane] >= options.maxSize)
+			{
+				retire(lane, SolveStatus::MAX_ITERATIONS, options.maxSize);
+			}
+			else if (monitors[lane]->Interrupted(2 * iterNums[lane] + 1, reason))
+			{
+				retire(lane, reason, std::min(iterNums[lane] + 1, options.maxSize));
+			}
+		}
+
+		// lanes refilled above are fresh and only need their function value, their derivative is thrown away
+		derivative.EvaluateLanes(xs, derivVals, accuracy);
+		for (size_t lane = 0; lane < EVALUATION_LANES; ++lane)
+		{
+			if (!active[lane] || fresh[lane]) continue;
+			if (std::abs(derivVals[lane]) < VERY_SMALL_VALUE)
+			{
+				results[jobs[lane]] = { xs[lane], iterNums[lane] + 1, SolveStatus::ZERO_DERIVATIVE, iterNums[lane] + 1, iterNums[lane] + 1 };
+				--activeLanes;
+				fill(lane);
+				continue;
+			}
+			steps[lane] = funcVals[lane] / derivVals[lane];
+			xs[lane] -= steps[lane];
+			++iterNums[lane];
+		}
+	}
+}
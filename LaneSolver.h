@@ -0,0 +1,17 @@
+// Newton's Method from many starting points of one expression, advanced together in SIMD lanes
+#pragma once
+
+#include "CompiledExpression.h"
+#include "ConvergenceMonitor.h"
+#include "Solvers.h"
+
+namespace solvers
+{
+	// solves from each of the count initial guesses, filling results[i] for initialGuesses[i]
+	// EVALUATION_LANES solves run in lockstep, and a lane that finishes is refilled with the next guess straight away,
+	// so the lanes stay busy however different the iteration counts are
+	// every result is the same as what Newton would give for that guess, evaluating with the same accuracy,
+	// intermediate iterates are not kept
+	void NewtonLanes(const CompiledExpression& function, const CompiledExpression& derivative, const double* initialGuesses, size_t count,
+		const SolveOptions& options, SolveResult<double>* results, MathAccuracy accuracy = MathAccuracy::FULL);
+};
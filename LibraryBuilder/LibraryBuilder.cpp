@@ -0,0 +1,78 @@
+// Expression library builder: parses and differentiates a catalog of expressions once and writes the compiled
+// forms out as a library file (see ExpressionLibrary.h) that services can map at startup instead
+// Build as a console application together with CanonicalForm.cpp, CompiledExpression.cpp, ExpressionCache.cpp,
+// ExpressionLibrary.cpp, Interval.cpp, Logger.cpp and MappedFile.cpp
+//
+// usage: LibraryBuilder <catalog file> <library file>
+// The catalog is a text file with one expression per line, blank lines are skipped
+
+#include "../pch.h"
+
+#include <chrono>
+#include "../CompiledExpression.h"
+#include "../ExpressionLibrary.h"
+#include <fstream>
+#include <iostream>
+#include "../Logger.h"
+#include <memory>
+#include <string>
+
+int main(int argc, char* argv[])
+{
+	if (argc < 3)
+	{
+		std::cerr << "usage: LibraryBuilder <catalog file> <library file>\n";
+		return 1;
+	}
+
+	try
+	{
+		auto logger = std::make_shared<Logger>("library_log.txt");
+		std::ifstream catalog(argv[1]);
+		if (!catalog)
+		{
+			std::cerr << "Unable to open " << argv[1] << "\n";
+			return 1;
+		}
+
+		const auto start = std::chrono::steady_clock::now();
+		ExpressionLibraryWriter writer;
+		size_t failed = 0;
+		std::string line;
+		while (std::getline(catalog, line))
+		{
+			if (!line.empty() && line.back() == '\r') line.pop_back();
+			if (line.find_first_not_of(" \t") == std::string::npos) continue;
+
+			std::unique_ptr<CompiledExpression> function;
+			try
+			{
+				function = std::make_unique<CompiledExpression>(line, logger);
+			}
+			catch (const std::exception& e)
+			{
+				std::cerr << "Skipping " << line << ": " << e.what() << "\n";
+				++failed;
+				continue;
+			}
+			const CompiledExpression derivative = function->Derivative();
+			writer.Add(*function, &derivative);
+		}
+		writer.Write(argv[2]);
+		const auto built = std::chrono::steady_clock::now();
+
+		// map it straight back, which is all a service has to do at startup
+		const ExpressionLibrary library(argv[2], logger);
+		const auto loaded = std::chrono::steady_clock::now();
+
+		std::cout << "Wrote " << writer.GetCount() << " expressions (" << failed << " skipped) in "
+			<< std::chrono::duration<double>(built - start).count() << " s, mapping and checking took "
+			<< std::chrono::duration<double>(loaded - built).count() << " s\n";
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << "\n";
+		return 1;
+	}
+	return 0;
+}
@@ -30,8 +30,8 @@ void Logger::LogEndChunk(const string& toLog)
 
 void Logger::LogEndChunk(const char* toLog)
 {
-	Log(toLog);
-	logfile << "\n";
+	std::lock_guard<std::mutex> lock(logMutex);
+	if (IS_DEBUG) logfile << toLog << "\n\n";
 }
 
 void Logger::Log(const string& toLog)
@@ -41,5 +41,6 @@ void Logger::Log(const string& toLog)
 
 void Logger::Log(const char* toLog)
 {
+	std::lock_guard<std::mutex> lock(logMutex);
 	if (IS_DEBUG) logfile << toLog << "\n";
 }
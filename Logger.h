@@ -1,6 +1,7 @@
 #pragma once
 
 #include <fstream>
+#include <mutex>
 #include <string>
 class Logger
 
@@ -19,5 +20,6 @@ public:
 private:
 	std::ofstream logfile;
 	std::string logName;
+	std::mutex logMutex; // expressions compile in the background while the thread that owns them keeps logging
 };
 
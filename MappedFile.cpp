@@ -0,0 +1,88 @@
+// Implements mapping a whole file into memory
+
+#include "pch.h"
+#include "MappedFile.h"
+
+#include <stdexcept>
+
+MappedFile::MappedFile(const std::string& pathIn, bool writable) :
+	path(pathIn),
+	file(INVALID_HANDLE_VALUE),
+	mapping(nullptr),
+	data(nullptr),
+	size(0)
+{
+	Open(writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ, OPEN_EXISTING);
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize)) Fail("unable to get the size of");
+	size = static_cast<size_t>(fileSize.QuadPart);
+	Map(writable);
+}
+
+MappedFile::MappedFile(const std::string& pathIn, size_t sizeIn) :
+	path(pathIn),
+	file(INVALID_HANDLE_VALUE),
+	mapping(nullptr),
+	data(nullptr),
+	size(sizeIn)
+{
+	Open(GENERIC_READ | GENERIC_WRITE, CREATE_ALWAYS);
+	Map(true); // mapping past the end of the file extends it to size
+}
+
+MappedFile::~MappedFile()
+{
+	if (data != nullptr) UnmapViewOfFile(data);
+	if (mapping != nullptr) CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+}
+
+char* MappedFile::GetData() const
+{
+	return data;
+}
+
+size_t MappedFile::GetSize() const
+{
+	return size;
+}
+
+void MappedFile::Flush()
+{
+	if (data == nullptr) return;
+	if (!FlushViewOfFile(data, 0) || !FlushFileBuffers(file))
+		throw std::runtime_error("MappedFile - unable to flush " + path + " (error " + std::to_string(GetLastError()) + ")");
+}
+
+void MappedFile::Open(unsigned long access, unsigned long creation)
+{
+	// shared for writing as well, so that several processes can map the same result file
+	file = CreateFileA(path.c_str(), access, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, creation, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) Fail("unable to open");
+}
+
+void MappedFile::Map(bool writable)
+{
+	// empty files cannot be mapped, leave data as null
+	if (size == 0) return;
+
+	const unsigned long long mappingSize = size;
+	mapping = CreateFileMappingA(file, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY,
+		static_cast<DWORD>(mappingSize >> 32), static_cast<DWORD>(mappingSize & 0xFFFFFFFF), nullptr);
+	if (mapping == nullptr) Fail("unable to create a mapping of");
+	data = static_cast<char*>(MapViewOfFile(mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size));
+	if (data == nullptr) Fail("unable to map");
+}
+
+void MappedFile::Fail(const std::string& what)
+{
+	// the destructor does not run when the constructor throws, so release what was opened here
+	const std::string errMsg = "MappedFile - " + what + " " + path + " (error " + std::to_string(GetLastError()) + ")";
+	if (data != nullptr) UnmapViewOfFile(data);
+	if (mapping != nullptr) CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+	data = nullptr;
+	mapping = nullptr;
+	file = INVALID_HANDLE_VALUE;
+	throw std::runtime_error(errMsg);
+}
@@ -0,0 +1,34 @@
+// Maps a whole file into memory
+#pragma once
+
+#include <string>
+
+class MappedFile
+{
+public:
+	MappedFile() = delete;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// maps an existing file, read-only unless writable is set
+	MappedFile(const std::string& pathIn, bool writable);
+	// creates the file (replacing any existing one) with the given size and maps it read-write
+	MappedFile(const std::string& pathIn, size_t sizeIn);
+	~MappedFile();
+
+	char* GetData() const;
+	size_t GetSize() const;
+
+	// writes any modified pages back to the file
+	void Flush();
+private:
+	void Open(unsigned long access, unsigned long creation);
+	void Map(bool writable);
+	void Fail(const std::string& what);
+
+	std::string path;
+	void* file;
+	void* mapping;
+	char* data;
+	size_t size;
+};
@@ -0,0 +1,55 @@
+// Implements helpers for splitting work across all available cores
+
+#include "pch.h"
+#include "Parallel.h"
+
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+unsigned int parallel::WorkerCount(size_t taskCount, unsigned int maxWorkers)
+{
+	unsigned int workers = std::thread::hardware_concurrency();
+	if (workers == 0) workers = 1;
+	if (maxWorkers != 0 && maxWorkers < workers) workers = maxWorkers;
+	if (taskCount < workers) workers = static_cast<unsigned int>(taskCount);
+	return workers;
+}
+
+void parallel::ParallelFor(size_t taskCount, const std::function<void(size_t)>& task, unsigned int maxWorkers)
+{
+	const unsigned int workers = WorkerCount(taskCount, maxWorkers);
+	if (workers <= 1)
+	{
+		for (size_t i = 0; i < taskCount; ++i) task(i);
+		return;
+	}
+
+	std::atomic<size_t> nextTask(0);
+	std::exception_ptr firstError;
+	std::mutex errorMutex;
+	auto work = [&]()
+	{
+		try
+		{
+			for (size_t i = nextTask++; i < taskCount; i = nextTask++) task(i);
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(errorMutex);
+			if (!firstError) firstError = std::current_exception();
+			nextTask = taskCount; // stop handing out work
+		}
+	};
+
+	// the calling thread does its share of the work as well
+	std::vector<std::thread> threads;
+	threads.reserve(workers - 1);
+	for (unsigned int i = 1; i < workers; ++i) threads.emplace_back(work);
+	work();
+	for (auto& thread : threads) thread.join();
+
+	if (firstError) std::rethrow_exception(firstError);
+}
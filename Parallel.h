@@ -0,0 +1,16 @@
+// Helpers for splitting work across all available cores
+#pragma once
+
+#include <functional>
+
+namespace parallel
+{
+	// number of threads ParallelFor will use for the given number of tasks, at most maxWorkers unless that is 0
+	unsigned int WorkerCount(size_t taskCount, unsigned int maxWorkers = 0);
+
+	// runs task(i) for every i in [0, taskCount), handing out tasks dynamically so uneven tasks balance out
+	// the threads are started and joined within the call, so nothing outlives the caller
+	// the first exception thrown by a task is re-thrown once all threads have finished
+	// maxWorkers limits the threads used, including the calling one, 0 uses one per core. With 1 the tasks run in order
+	void ParallelFor(size_t taskCount, const std::function<void(size_t)>& task, unsigned int maxWorkers = 0);
+};
@@ -0,0 +1,343 @@
+// Native CPython extension module over the C++ core, an alternative to loading RootFinder.dll through ctypes
+// Arrays are passed through the buffer protocol, so NumPy arrays are read and written in place and the
+// buffers returned by this module can be wrapped with numpy.asarray without copying
+// The GIL is released while solving and evaluating
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "../pch.h"
+
+#include "../dllImplementation.h"
+#include <string>
+#include <vector>
+
+namespace
+{
+	// A block of native memory exposed through the buffer protocol
+	struct NativeBuffer
+	{
+		PyObject_HEAD
+		char* data;
+		Py_ssize_t length; // number of items
+		Py_ssize_t itemSize;
+		Py_ssize_t shape[1];
+		Py_ssize_t strides[1];
+		const char* format;
+	};
+
+	int NativeBufferGetBuffer(PyObject* self, Py_buffer* view, int flags)
+	{
+		NativeBuffer* buffer = reinterpret_cast<NativeBuffer*>(self);
+		if (PyBuffer_FillInfo(view, self, buffer->data, buffer->length * buffer->itemSize, 0, flags) != 0) return -1;
+		view->itemsize = buffer->itemSize;
+		view->ndim = 1;
+		view->format = (flags & PyBUF_FORMAT) ? const_cast<char*>(buffer->format) : nullptr;
+		view->shape = (flags & PyBUF_ND) ? buffer->shape : nullptr;
+		view->strides = (flags & PyBUF_STRIDES) ? buffer->strides : nullptr;
+		return 0;
+	}
+
+	void NativeBufferDealloc(PyObject* self)
+	{
+		NativeBuffer* buffer = reinterpret_cast<NativeBuffer*>(self);
+		PyMem_Free(buffer->data);
+		Py_TYPE(self)->tp_free(self);
+	}
+
+	Py_ssize_t NativeBufferLength(PyObject* self)
+	{
+		return reinterpret_cast<NativeBuffer*>(self)->length;
+	}
+
+	PyBufferProcs nativeBufferProcs = { NativeBufferGetBuffer, nullptr };
+	PySequenceMethods nativeBufferSequence = { NativeBufferLength };
+
+	PyTypeObject NativeBufferType = { PyVarObject_HEAD_INIT(nullptr, 0) };
+
+	PyObject* NewNativeBuffer(Py_ssize_t length, Py_ssize_t itemSize, const char* format)
+	{
+		NativeBuffer* buffer = PyObject_New(NativeBuffer, &NativeBufferType);
+		if (buffer == nullptr) return nullptr;
+		buffer->data = static_cast<char*>(PyMem_Malloc(length > 0 ? length * itemSize : 1));
+		if (buffer->data == nullptr)
+		{
+			Py_DECREF(buffer);
+			return PyErr_NoMemory();
+		}
+		buffer->length = length;
+		buffer->itemSize = itemSize;
+		buffer->shape[0] = length;
+		buffer->strides[0] = itemSize;
+		buffer->format = format;
+		return reinterpret_cast<PyObject*>(buffer);
+	}
+
+	// Takes a contiguous 1-d view of obj with the given item type. Releases nothing on failure
+	bool GetArray(PyObject* obj, Py_buffer* view, const char* format, Py_ssize_t itemSize, bool writable, const char* name)
+	{
+		const int flags = PyBUF_C_CONTIGUOUS | PyBUF_FORMAT | (writable ? PyBUF_WRITABLE : 0);
+		if (PyObject_GetBuffer(obj, view, flags) != 0) return false;
+		// skip a native byte order prefix, and take 'l' as 'i' where long is 32 bits (NumPy's int32 on Windows)
+		const char* viewFormat = view->format != nullptr ? view->format : "B";
+		if (viewFormat[0] == '@' || viewFormat[0] == '=') ++viewFormat;
+		const bool formatMatches = strcmp(viewFormat, format) == 0 ||
+			(format[0] == 'i' && strcmp(viewFormat, "l") == 0 && view->itemsize == itemSize);
+		if (view->ndim > 1 || view->itemsize != itemSize || !formatMatches)
+		{
+			PyErr_Format(PyExc_TypeError, "%s must be a contiguous 1-d array of '%s'", name, format);
+			PyBuffer_Release(view);
+			return false;
+		}
+		return true;
+	}
+
+	// Returns obj with a new reference if given, or a new NativeBuffer of length items
+	PyObject* OutputArray(PyObject* obj, Py_ssize_t length, Py_ssize_t itemSize, const char* format)
+	{
+		if (obj != nullptr && obj != Py_None)
+		{
+			Py_INCREF(obj);
+			return obj;
+		}
+		return NewNativeBuffer(length, itemSize, format);
+	}
+
+	bool CheckLength(const Py_buffer& view, Py_ssize_t length, const char* name)
+	{
+		if (view.len / view.itemsize >= length) return true;
+		PyErr_Format(PyExc_ValueError, "%s must hold at least %zd items", name, length);
+		return false;
+	}
+
+	PyObject* Solve(PyObject*, PyObject* args, PyObject* kwargs)
+	{
+		// solve(expr, initial_guess, max_iterations, goal_err, method=0, second_guess=None, time_limit=0.0, max_evaluations=0,
+		//     auto_guess=False, search_lo=-10.0, search_hi=10.0) -> (iterates, status)
+		// with auto_guess, initial_guess is only used when sampling [search_lo, search_hi] finds nowhere promising to start
+		static const char* keywords[] = { "expr", "initial_guess", "max_iterations", "goal_err", "method", "second_guess", "time_limit",
+			"max_evaluations", "auto_guess", "search_lo", "search_hi", nullptr };
+		const char* expr = nullptr;
+		Py_ssize_t exprLen = 0;
+		SolveSettings settings;
+		dllImplementation::InitSolveSettings(&settings);
+		PyObject* secondGuessObj = Py_None;
+		if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s#did|iOdipdd", const_cast<char**>(keywords),
+			&expr, &exprLen, &settings.initialGuess, &settings.maxSize, &settings.goalErr, &settings.method, &secondGuessObj,
+			&settings.timeLimit, &settings.maxEvaluations, &settings.autoGuess, &settings.searchLo, &settings.searchHi)) return nullptr;
+		settings.secondGuess = settings.initialGuess;
+		if (secondGuessObj != Py_None)
+		{
+			settings.secondGuess = PyFloat_AsDouble(secondGuessObj);
+			if (PyErr_Occurred()) return nullptr;
+		}
+		if (settings.maxSize <= 0) return PyErr_Format(PyExc_ValueError, "max_iterations must be positive");
+
+		// the solvers write straight into the returned buffer, with one extra slot as they store up to maxSize + 1 iterates
+		PyObject* iterates = NewNativeBuffer(static_cast<Py_ssize_t>(settings.maxSize) + 1, sizeof(double), "d");
+		if (iterates == nullptr) return nullptr;
+		NativeBuffer* iteratesBuffer = reinterpret_cast<NativeBuffer*>(iterates);
+		SolveReport report;
+		int iterations = 0;
+		const std::string exprCopy(expr, exprLen);
+		Py_BEGIN_ALLOW_THREADS
+		iterations = dllImplementation::SolveForRootEx(exprCopy.c_str(), exprCopy.size(), &settings, reinterpret_cast<double*>(iteratesBuffer->data), &report);
+		Py_END_ALLOW_THREADS
+
+		iteratesBuffer->length = iterations;
+		iteratesBuffer->shape[0] = iterations;
+		return Py_BuildValue("(Ni)", iterates, report.status);
+	}
+
+	PyObject* SolveBatch(PyObject*, PyObject* args, PyObject* kwargs)
+	{
+		// solve_batch(expr, guesses, max_iterations, goal_err, method=0, roots=None, iterations=None, statuses=None, time_limit=0.0,
+		//     max_evaluations=0, accuracy=0) -> (converged, roots, iterations, statuses)
+		static const char* keywords[] = { "expr", "guesses", "max_iterations", "goal_err", "method", "roots", "iterations", "statuses",
+			"time_limit", "max_evaluations", "accuracy", nullptr };
+		const char* expr = nullptr;
+		Py_ssize_t exprLen = 0;
+		PyObject* guessesObj = nullptr;
+		PyObject* rootsObj = nullptr;
+		PyObject* iterationsObj = nullptr;
+		PyObject* statusesObj = nullptr;
+		SolveSettings settings;
+		dllImplementation::InitSolveSettings(&settings);
+		if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s#Oid|iOOOdii", const_cast<char**>(keywords),
+			&expr, &exprLen, &guessesObj, &settings.maxSize, &settings.goalErr, &settings.method, &rootsObj, &iterationsObj, &statusesObj,
+			&settings.timeLimit, &settings.maxEvaluations, &settings.accuracy)) return nullptr;
+
+		Py_buffer guesses;
+		if (!GetArray(guessesObj, &guesses, "d", sizeof(double), false, "guesses")) return nullptr;
+		const Py_ssize_t count = guesses.len / guesses.itemsize;
+
+		PyObject* outputs[3] = {
+			OutputArray(rootsObj, count, sizeof(double), "d"),
+			OutputArray(iterationsObj, count, sizeof(int), "i"),
+			OutputArray(statusesObj, count, sizeof(int), "i") };
+		Py_buffer views[3];
+		const char* names[3] = { "roots", "iterations", "statuses" };
+		const char* formats[3] = { "d", "i", "i" };
+		const Py_ssize_t sizes[3] = { sizeof(double), sizeof(int), sizeof(int) };
+		int viewsTaken = 0;
+		bool ok = outputs[0] != nullptr && outputs[1] != nullptr && outputs[2] != nullptr;
+		for (int i = 0; ok && i < 3; ++i)
+		{
+			ok = GetArray(outputs[i], &views[i], formats[i], sizes[i], true, names[i]);
+			if (!ok) break;
+			viewsTaken = i + 1;
+			ok = CheckLength(views[i], count, names[i]);
+		}
+
+		int converged = -1;
+		if (ok)
+		{
+			const std::string exprCopy(expr, exprLen);
+			Py_BEGIN_ALLOW_THREADS
+			converged = dllImplementation::SolveBatch(exprCopy.c_str(), exprCopy.size(), &settings, static_cast<const double*>(guesses.buf), count,
+				static_cast<double*>(views[0].buf), static_cast<int*>(views[1].buf), static_cast<int*>(views[2].buf));
+			Py_END_ALLOW_THREADS
+		}
+
+		for (int i = 0; i < viewsTaken; ++i) PyBuffer_Release(&views[i]);
+		PyBuffer_Release(&guesses);
+		if (!ok)
+		{
+			for (PyObject* output : outputs) Py_XDECREF(output);
+			return nullptr;
+		}
+		if (converged < 0)
+		{
+			for (PyObject* output : outputs) Py_XDECREF(output);
+			return PyErr_Format(PyExc_ValueError, "unable to solve %s", expr);
+		}
+		return Py_BuildValue("(iNNN)", converged, outputs[0], outputs[1], outputs[2]);
+	}
+
+	PyObject* Evaluate(PyObject*, PyObject* args, PyObject* kwargs)
+	{
+		// evaluate(expr, xs, out=None) -> out
+		static const char* keywords[] = { "expr", "xs", "out", nullptr };
+		const char* expr = nullptr;
+		Py_ssize_t exprLen = 0;
+		PyObject* xsObj = nullptr;
+		PyObject* outObj = nullptr;
+		if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s#O|O", const_cast<char**>(keywords), &expr, &exprLen, &xsObj, &outObj)) return nullptr;
+
+		Py_buffer xs;
+		if (!GetArray(xsObj, &xs, "d", sizeof(double), false, "xs")) return nullptr;
+		const Py_ssize_t count = xs.len / xs.itemsize;
+
+		PyObject* output = OutputArray(outObj, count, sizeof(double), "d");
+		Py_buffer out;
+		bool ok = output != nullptr && GetArray(output, &out, "d", sizeof(double), true, "out");
+		if (ok && !CheckLength(out, count, "out"))
+		{
+			PyBuffer_Release(&out);
+			ok = false;
+		}
+
+		int evaluated = 0;
+		if (ok)
+		{
+			const std::string exprCopy(expr, exprLen);
+			Py_BEGIN_ALLOW_THREADS
+			evaluated = dllImplementation::EvaluateBatch(exprCopy.c_str(), exprCopy.size(), static_cast<const double*>(xs.buf), count, static_cast<double*>(out.buf));
+			Py_END_ALLOW_THREADS
+			PyBuffer_Release(&out);
+		}
+		PyBuffer_Release(&xs);
+
+		if (!ok || evaluated == 0)
+		{
+			Py_XDECREF(output);
+			if (ok) return PyErr_Format(PyExc_ValueError, "unable to evaluate %s", expr);
+			return nullptr;
+		}
+		return output;
+	}
+
+	PyObject* SampleCurve(PyObject*, PyObject* args, PyObject* kwargs)
+	{
+		// sample_curve(expr, lo, hi, max_points=1000, tolerance=0.001) -> (xs, values)
+		// points are denser where the curve bends or jumps, see sampling::SampleCurve
+		static const char* keywords[] = { "expr", "lo", "hi", "max_points", "tolerance", nullptr };
+		const char* expr = nullptr;
+		Py_ssize_t exprLen = 0;
+		double lo = 0.0;
+		double hi = 0.0;
+		int maxPoints = 1000;
+		double tolerance = 1E-3;
+		if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s#dd|id", const_cast<char**>(keywords), &expr, &exprLen, &lo, &hi, &maxPoints,
+			&tolerance)) return nullptr;
+		if (maxPoints < 2) return PyErr_Format(PyExc_ValueError, "max_points must be at least 2");
+
+		PyObject* xs = NewNativeBuffer(maxPoints, sizeof(double), "d");
+		PyObject* values = NewNativeBuffer(maxPoints, sizeof(double), "d");
+		if (xs == nullptr || values == nullptr)
+		{
+			Py_XDECREF(xs);
+			Py_XDECREF(values);
+			return nullptr;
+		}
+		NativeBuffer* xsBuffer = reinterpret_cast<NativeBuffer*>(xs);
+		NativeBuffer* valuesBuffer = reinterpret_cast<NativeBuffer*>(values);
+		int count = 0;
+		const std::string exprCopy(expr, exprLen);
+		Py_BEGIN_ALLOW_THREADS
+		count = dllImplementation::SampleCurve(exprCopy.c_str(), exprCopy.size(), lo, hi, maxPoints, tolerance,
+			reinterpret_cast<double*>(xsBuffer->data), reinterpret_cast<double*>(valuesBuffer->data));
+		Py_END_ALLOW_THREADS
+
+		if (count == 0)
+		{
+			Py_DECREF(xs);
+			Py_DECREF(values);
+			return PyErr_Format(PyExc_ValueError, "unable to sample %s", expr);
+		}
+		// fewer points may be needed than were allowed for
+		xsBuffer->length = count;
+		xsBuffer->shape[0] = count;
+		valuesBuffer->length = count;
+		valuesBuffer->shape[0] = count;
+		return Py_BuildValue("(NN)", xs, values);
+	}
+
+	PyMethodDef methods[] =
+	{
+		{ "solve", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)(void)>(Solve)), METH_VARARGS | METH_KEYWORDS,
+			"solve(expr, initial_guess, max_iterations, goal_err, method=0, second_guess=None, time_limit=0.0, max_evaluations=0, auto_guess=False, search_lo=-10.0, search_hi=10.0) -> (iterates, status)" },
+		{ "solve_batch", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)(void)>(SolveBatch)), METH_VARARGS | METH_KEYWORDS,
+			"solve_batch(expr, guesses, max_iterations, goal_err, method=0, roots=None, iterations=None, statuses=None, time_limit=0.0, max_evaluations=0, accuracy=0) -> (converged, roots, iterations, statuses)" },
+		{ "evaluate", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)(void)>(Evaluate)), METH_VARARGS | METH_KEYWORDS,
+			"evaluate(expr, xs, out=None) -> out" },
+		{ "sample_curve", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)(void)>(SampleCurve)), METH_VARARGS | METH_KEYWORDS,
+			"sample_curve(expr, lo, hi, max_points=1000, tolerance=0.001) -> (xs, values)" },
+		{ nullptr, nullptr, 0, nullptr }
+	};
+
+	PyModuleDef moduleDef = { PyModuleDef_HEAD_INIT, "rootfinder_native", "Native bindings for the RootFinder C++ core", -1, methods };
+}
+
+PyMODINIT_FUNC PyInit_rootfinder_native()
+{
+	NativeBufferType.tp_name = "rootfinder_native.NativeBuffer";
+	NativeBufferType.tp_basicsize = sizeof(NativeBuffer);
+	NativeBufferType.tp_dealloc = NativeBufferDealloc;
+	NativeBufferType.tp_as_buffer = &nativeBufferProcs;
+	NativeBufferType.tp_as_sequence = &nativeBufferSequence;
+	NativeBufferType.tp_flags = Py_TPFLAGS_DEFAULT;
+	NativeBufferType.tp_doc = "Native array returned by rootfinder_native, wrap with numpy.asarray";
+	if (PyType_Ready(&NativeBufferType) < 0) return nullptr;
+
+	PyObject* module = PyModule_Create(&moduleDef);
+	if (module == nullptr) return nullptr;
+	Py_INCREF(&NativeBufferType);
+	if (PyModule_AddObject(module, "NativeBuffer", reinterpret_cast<PyObject*>(&NativeBufferType)) < 0)
+	{
+		Py_DECREF(&NativeBufferType);
+		Py_DECREF(module);
+		return nullptr;
+	}
+	return module;
+}
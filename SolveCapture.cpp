@@ -0,0 +1,148 @@
+// Implements the binary solve capture files
+
+#include "pch.h"
+#include "SolveCapture.h"
+
+#include <cstring>
+#include "MappedFile.h"
+#include <stdexcept>
+
+namespace
+{
+	// copies a value out of the mapped file, which makes no promises about alignment
+	template <typename T>
+	bool ReadValue(const char* data, size_t size, size_t& offset, T& value)
+	{
+		if (size - offset < sizeof(T)) return false;
+		std::memcpy(&value, data + offset, sizeof(T));
+		offset += sizeof(T);
+		return true;
+	}
+}
+
+SolveCaptureWriter::SolveCaptureWriter(const std::string& pathIn) :
+	path(pathIn),
+	out(pathIn, std::ios::binary | std::ios::trunc),
+	start(std::chrono::steady_clock::now())
+{
+	if (!out) throw std::runtime_error("SolveCaptureWriter - unable to open " + path);
+	const SolveCaptureHeader header = { SOLVE_CAPTURE_MAGIC, SOLVE_CAPTURE_VERSION };
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	out.flush();
+	if (!out) throw std::runtime_error("SolveCaptureWriter - unable to write " + path);
+	written = out.tellp();
+}
+
+SolveCaptureWriter::~SolveCaptureWriter()
+{ }
+
+double SolveCaptureWriter::GetElapsed() const
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void SolveCaptureWriter::Add(const std::string& expr, SolveCaptureRecord record)
+{
+	std::lock_guard<std::mutex> lock(outMutex);
+	const auto found = expressionIndices.find(expr);
+	const bool isNew = found == expressionIndices.end();
+	record.expressionIndex = isNew ? static_cast<uint32_t>(expressionIndices.size()) : found->second;
+	if (isNew)
+	{
+		const uint32_t length = static_cast<uint32_t>(expr.size());
+		out.write(reinterpret_cast<const char*>(&CAPTURE_EXPRESSION), sizeof(CAPTURE_EXPRESSION));
+		out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+		out.write(expr.data(), expr.size());
+	}
+	out.write(reinterpret_cast<const char*>(&CAPTURE_SOLVE), sizeof(CAPTURE_SOLVE));
+	out.write(reinterpret_cast<const char*>(&record), sizeof(record));
+	// flushed every time so the capture survives the process dying
+	out.flush();
+	if (!out)
+	{
+		// reopened to drop what is still buffered, so the next entry goes over whatever part of this one reached the file
+		out.close();
+		out.clear();
+		out.open(path, std::ios::binary | std::ios::in | std::ios::out);
+		out.seekp(written);
+		throw std::runtime_error("SolveCaptureWriter - unable to write " + path);
+	}
+	if (isNew) expressionIndices.emplace(expr, record.expressionIndex);
+	written = out.tellp();
+}
+
+SolveCaptureReader::SolveCaptureReader(const std::string& path) :
+	truncated(false)
+{
+	const MappedFile file(path, false);
+	const char* data = file.GetData();
+	const size_t size = file.GetSize();
+
+	size_t offset = 0;
+	SolveCaptureHeader header;
+	if (!ReadValue(data, size, offset, header) || header.magic != SOLVE_CAPTURE_MAGIC)
+		throw std::runtime_error("SolveCaptureReader - " + path + " is not a capture file");
+	if (header.version != SOLVE_CAPTURE_VERSION)
+		throw std::runtime_error("SolveCaptureReader - " + path + " has unsupported version " + std::to_string(header.version));
+
+	uint32_t tag;
+	while (ReadValue(data, size, offset, tag))
+	{
+		if (tag == CAPTURE_EXPRESSION)
+		{
+			uint32_t length;
+			if (!ReadValue(data, size, offset, length) || size - offset < length)
+			{
+				truncated = true;
+				break;
+			}
+			expressions.emplace_back(data + offset, length);
+			offset += length;
+		}
+		else if (tag == CAPTURE_SOLVE)
+		{
+			SolveCaptureRecord record;
+			if (!ReadValue(data, size, offset, record))
+			{
+				truncated = true;
+				break;
+			}
+			if (record.expressionIndex >= expressions.size())
+				throw std::runtime_error("SolveCaptureReader - " + path + " has a solve of an unknown expression");
+			solves.push_back(record);
+		}
+		else
+		{
+			throw std::runtime_error("SolveCaptureReader - " + path + " has an unknown entry " + std::to_string(tag));
+		}
+	}
+	if (offset != size) truncated = true;
+}
+
+SolveCaptureReader::~SolveCaptureReader()
+{ }
+
+size_t SolveCaptureReader::GetSolveCount() const
+{
+	return solves.size();
+}
+
+size_t SolveCaptureReader::GetExpressionCount() const
+{
+	return expressions.size();
+}
+
+const std::string& SolveCaptureReader::GetExpression(size_t index) const
+{
+	return expressions.at(index);
+}
+
+const SolveCaptureRecord& SolveCaptureReader::GetSolve(size_t index) const
+{
+	return solves.at(index);
+}
+
+bool SolveCaptureReader::WasTruncated() const
+{
+	return truncated;
+}
@@ -0,0 +1,90 @@
+// Binary capture files recording the solves made through SolveForRoot, so real traffic can be replayed later
+//
+// Capture file: SolveCaptureHeader, then a stream of entries, each a uint32 tag followed by its data
+//     CAPTURE_EXPRESSION: uint32 length, then the expression string. Expressions are numbered in the order they appear
+//     CAPTURE_SOLVE: a SolveCaptureRecord
+// Each distinct expression is stored once, before the first solve using it. Entries are appended as the solves
+// finish, so a capture cut short by a crash is still readable up to its last complete entry
+// All values are little-endian
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+const uint32_t SOLVE_CAPTURE_MAGIC = 0x43534652; // "RFSC"
+const uint32_t SOLVE_CAPTURE_VERSION = 1;
+const uint32_t CAPTURE_EXPRESSION = 1;
+const uint32_t CAPTURE_SOLVE = 2;
+
+struct SolveCaptureHeader
+{
+	uint32_t magic;
+	uint32_t version;
+};
+
+struct SolveCaptureRecord
+{
+	double initialGuess;
+	double goalErr;
+	double startTime; // seconds from the start of the capture to the start of the call
+	double seconds; // how long the call took
+	uint32_t expressionIndex;
+	int32_t maxSize;
+	int32_t iterations; // what SolveForRoot returned
+	int32_t status; // SolveStatus
+};
+
+static_assert(sizeof(SolveCaptureHeader) == 8, "SolveCaptureHeader layout changed");
+static_assert(sizeof(SolveCaptureRecord) == 48, "SolveCaptureRecord layout changed");
+
+// Creates a capture file (replacing any existing one) and appends solves to it. Add may be called from any thread
+class SolveCaptureWriter
+{
+public:
+	SolveCaptureWriter() = delete;
+	SolveCaptureWriter(const SolveCaptureWriter&) = delete;
+	SolveCaptureWriter& operator=(const SolveCaptureWriter&) = delete;
+	SolveCaptureWriter(const std::string& pathIn);
+	~SolveCaptureWriter();
+
+	// seconds since the capture was started, for SolveCaptureRecord::startTime
+	double GetElapsed() const;
+
+	// appends one solve of expr. expressionIndex in the record is filled in here
+	// throws std::runtime_error if the entry could not be written. Its expression is then not taken as written, and the
+	// next entry goes over any part of it that reached the file
+	void Add(const std::string& expr, SolveCaptureRecord record);
+private:
+	std::string path;
+	std::ofstream out;
+	std::mutex outMutex;
+	std::unordered_map<std::string, uint32_t> expressionIndices; // only the expressions whose entry was written
+	std::streampos written; // the end of the last complete entry
+	std::chrono::steady_clock::time_point start;
+};
+
+// Maps a capture file and reads all of its complete entries
+class SolveCaptureReader
+{
+public:
+	SolveCaptureReader() = delete;
+	SolveCaptureReader(const std::string& path);
+	~SolveCaptureReader();
+
+	size_t GetSolveCount() const;
+	size_t GetExpressionCount() const;
+	const std::string& GetExpression(size_t index) const;
+	const SolveCaptureRecord& GetSolve(size_t index) const;
+
+	// true if the file ended partway through an entry, which is expected when the capturing process died
+	bool WasTruncated() const;
+private:
+	std::vector<std::string> expressions;
+	std::vector<SolveCaptureRecord> solves;
+	bool truncated;
+};
@@ -0,0 +1,106 @@
+// Implements solves running on a thread of their own
+
+#include "pch.h"
+#include "SolveJob.h"
+
+#include <algorithm>
+
+SolveJob::SolveJob(int maxSize, SolveProgressCallback progressIn, SolveDoneCallback doneIn, double progressIntervalIn, void* contextIn) :
+	progress(progressIn),
+	done(doneIn),
+	progressInterval(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(std::max(progressIntervalIn, 0.0)))),
+	context(contextIn),
+	iterates(static_cast<size_t>(std::max(maxSize, 0)) + 1), // the solvers store up to maxSize + 1 iterates
+	finished(false),
+	iterations(0),
+	report(),
+	progressIteration(0),
+	progressX(0.0),
+	progressFuncMag(0.0)
+{ }
+
+SolveJob::~SolveJob()
+{
+	Cancel();
+	if (thread.joinable()) thread.join();
+}
+
+void SolveJob::Start(std::function<int(SolveJob&, SolveReport&)> solve)
+{
+	thread = std::thread(&SolveJob::Run, this, std::move(solve));
+}
+
+const CancellationToken* SolveJob::GetCancellation() const
+{
+	return &cancellation;
+}
+
+double* SolveJob::GetIterates()
+{
+	return iterates.data();
+}
+
+void SolveJob::ReportProgress(int iteration, double x, double funcMag)
+{
+	{
+		std::lock_guard<std::mutex> lock(stateMutex);
+		progressIteration = iteration;
+		progressX = x;
+		progressFuncMag = funcMag;
+	}
+	if (progress == nullptr) return;
+
+	// reading the clock is cheap next to an evaluation, unlike what the callback may do
+	const auto now = std::chrono::steady_clock::now();
+	if (iteration != 0 && now - lastProgress < progressInterval) return;
+	lastProgress = now;
+	progress(context, iteration, x, funcMag);
+}
+
+void SolveJob::Cancel()
+{
+	cancellation.Cancel();
+}
+
+bool SolveJob::Wait(double timeout)
+{
+	std::unique_lock<std::mutex> lock(stateMutex);
+	if (timeout < 0.0)
+	{
+		finishedChanged.wait(lock, [this]() { return finished; });
+		return true;
+	}
+	return finishedChanged.wait_for(lock, std::chrono::duration<double>(timeout), [this]() { return finished; });
+}
+
+bool SolveJob::GetProgress(int& iteration, double& x, double& funcMag)
+{
+	std::lock_guard<std::mutex> lock(stateMutex);
+	iteration = progressIteration;
+	x = progressX;
+	funcMag = progressFuncMag;
+	return finished;
+}
+
+int SolveJob::GetResult(double* results, SolveReport& reportOut)
+{
+	std::lock_guard<std::mutex> lock(stateMutex);
+	if (!finished) return -1;
+	std::copy(iterates.begin(), iterates.begin() + iterations, results);
+	reportOut = report;
+	return iterations;
+}
+
+void SolveJob::Run(const std::function<int(SolveJob&, SolveReport&)>& solve)
+{
+	SolveReport result = {};
+	const int count = solve(*this, result);
+	{
+		std::lock_guard<std::mutex> lock(stateMutex);
+		iterations = std::min(std::max(count, 0), static_cast<int>(iterates.size()));
+		report = result;
+		finished = true;
+	}
+	finishedChanged.notify_all();
+	if (done != nullptr) done(context, iterations, &result);
+}
@@ -0,0 +1,67 @@
+// A solve running on a thread of its own, the handle behind StartSolveAsync
+// The solve reports its progress and its outcome to the job. Callers may poll it, wait on it, or have callbacks called,
+// from any thread. The callbacks run on the job's thread, so a UI has to hand them to its own thread or just poll instead
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include "ConvergenceMonitor.h"
+#include "dllImplementation.h"
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class SolveJob
+{
+public:
+	SolveJob() = delete;
+	SolveJob(const SolveJob&) = delete;
+	SolveJob& operator=(const SolveJob&) = delete;
+
+	// progress is called at most once every progressInterval seconds, and always for the initial guess. done is called once the
+	// solve is over. Either may be nullptr. context is handed to both
+	SolveJob(int maxSize, SolveProgressCallback progressIn, SolveDoneCallback doneIn, double progressIntervalIn, void* contextIn);
+	// cancels the solve and waits for it, so it must not be called from the callbacks
+	~SolveJob();
+
+	// runs solve on the job's thread. solve stores its iterates in GetIterates(), calls ReportProgress for each of them, and returns
+	// the number of iterates along with the report
+	void Start(std::function<int(SolveJob&, SolveReport&)> solve);
+
+	// for the solve
+	const CancellationToken* GetCancellation() const;
+	double* GetIterates();
+	void ReportProgress(int iteration, double x, double funcMag);
+
+	// for the callers
+	void Cancel();
+	// waits up to timeout seconds for the solve to finish, or without a limit when timeout is negative
+	// returns whether it has finished
+	bool Wait(double timeout);
+	// the latest iterate reported. returns whether the solve has finished
+	bool GetProgress(int& iteration, double& x, double& funcMag);
+	// once finished, copies the iterates to results and the report to report and returns the number of iterates, otherwise returns -1
+	int GetResult(double* results, SolveReport& reportOut);
+private:
+	void Run(const std::function<int(SolveJob&, SolveReport&)>& solve);
+
+	SolveProgressCallback progress;
+	SolveDoneCallback done;
+	const std::chrono::steady_clock::duration progressInterval;
+	void* context;
+	CancellationToken cancellation;
+	std::vector<double> iterates;
+	std::chrono::steady_clock::time_point lastProgress;
+
+	std::mutex stateMutex; // guards everything below
+	std::condition_variable finishedChanged;
+	bool finished;
+	int iterations;
+	SolveReport report;
+	int progressIteration;
+	double progressX;
+	double progressFuncMag;
+
+	std::thread thread; // last, so it starts after everything it uses is constructed
+};
@@ -0,0 +1,108 @@
+// Replays a capture made with StartSolveCapture: runs every captured SolveForRoot call again, back to back, on a
+// chosen number of threads, and reports the throughput and latency percentiles next to the captured ones
+// Build as a console application together with BytecodeExpression.cpp, CompiledExpression.cpp, CurveSampler.cpp,
+// dllImplementation.cpp, Expression.cpp, IncrementalEvaluator.cpp, Interval.cpp, IntervalSolver.cpp, LaneSolver.cpp,
+// Logger.cpp, MappedFile.cpp, Parallel.cpp, SolveCapture.cpp and SolveJob.cpp
+//
+// usage: SolveReplay <capture file> [threads] [repeats]
+// threads defaults to 1, repeats (how many times the whole capture is run) to 1
+
+#include "../pch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include "../dllImplementation.h"
+#include <iomanip>
+#include <iostream>
+#include "../SolveCapture.h"
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	// the latency below which the given fraction of latencies fall, latencies must be sorted
+	double Percentile(const std::vector<double>& latencies, double fraction);
+	void PrintLatencies(const std::string& label, std::vector<double> latencies);
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		std::cerr << "usage: SolveReplay <capture file> [threads] [repeats]\n";
+		return 1;
+	}
+
+	try
+	{
+		const SolveCaptureReader capture(argv[1]);
+		const unsigned int threadCount = std::max(1, argc > 2 ? std::stoi(argv[2]) : 1);
+		const size_t repeats = std::max(1, argc > 3 ? std::stoi(argv[3]) : 1);
+		const size_t solveCount = capture.GetSolveCount();
+		std::cout << solveCount << " solves of " << capture.GetExpressionCount() << " expressions"
+			<< (capture.WasTruncated() ? " (the capture ends partway through an entry, which was dropped)" : "") << "\n";
+		if (solveCount == 0) return 0;
+
+		const size_t callCount = solveCount * repeats;
+		std::vector<double> latencies(callCount);
+		std::atomic<size_t> next(0);
+		std::atomic<size_t> mismatches(0);
+		const auto start = std::chrono::steady_clock::now();
+		std::vector<std::thread> threads;
+		for (unsigned int t = 0; t < threadCount; ++t)
+		{
+			threads.emplace_back([&]()
+			{
+				std::vector<double> results;
+				for (size_t call = next++; call < callCount; call = next++)
+				{
+					const SolveCaptureRecord& solve = capture.GetSolve(call % solveCount);
+					const std::string& expr = capture.GetExpression(solve.expressionIndex);
+					results.resize(std::max(solve.maxSize, 0) + static_cast<size_t>(1));
+
+					const auto callStart = std::chrono::steady_clock::now();
+					const int iterations = dllImplementation::SolveForRoot(expr.c_str(), expr.size(), solve.initialGuess, solve.maxSize, solve.goalErr, results.data());
+					latencies[call] = std::chrono::duration<double>(std::chrono::steady_clock::now() - callStart).count();
+					if (iterations != solve.iterations) ++mismatches;
+				}
+			});
+		}
+		for (std::thread& thread : threads) thread.join();
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		std::vector<double> captured(solveCount);
+		for (size_t i = 0; i < solveCount; ++i) captured[i] = capture.GetSolve(i).seconds;
+		std::cout << "Replayed " << callCount << " calls on " << threadCount << " threads in " << seconds << " s";
+		if (seconds > 0.0) std::cout << ", " << static_cast<size_t>(callCount / seconds) << " calls/s";
+		std::cout << "\n";
+		PrintLatencies("replayed", latencies);
+		PrintLatencies("captured", captured);
+		if (mismatches > 0) std::cout << mismatches << " calls returned a different number of iterations than when captured\n";
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << "\n";
+		return 1;
+	}
+	return 0;
+}
+
+namespace
+{
+	double Percentile(const std::vector<double>& latencies, double fraction)
+	{
+		const size_t index = static_cast<size_t>(fraction * (latencies.size() - 1) + 0.5);
+		return latencies[index];
+	}
+
+	void PrintLatencies(const std::string& label, std::vector<double> latencies)
+	{
+		std::sort(latencies.begin(), latencies.end());
+		std::cout << std::setw(10) << label << " latency (us): p50 " << Percentile(latencies, 0.5) * 1E6
+			<< ", p90 " << Percentile(latencies, 0.9) * 1E6
+			<< ", p99 " << Percentile(latencies, 0.99) * 1E6
+			<< ", max " << latencies.back() * 1E6 << "\n";
+	}
+}
@@ -0,0 +1,184 @@
+// Newton's Method one iterate at a time, and schedulers that interleave many such solves on one thread
+// A stepper keeps just the state of its solve between iterates, so thousands of solves can be in flight at once without
+// a thread or a results array each, and the caller can look at every iterate and stop any solve early
+#pragma once
+
+#include <cmath>
+#include "ConvergenceMonitor.h"
+#include <cstdint>
+#include <queue>
+#include "Solvers.h"
+#include <utility>
+#include <vector>
+
+namespace solvers
+{
+	// the same iteration as Newton, with the loop turned inside out: constructing the stepper evaluates the initial guess
+	// (iteration 0), and every call of Next advances to the next iterate. The result, once finished, is what Newton returns
+	// for the same guess. Function and Derivative are stored by value, so lambdas should capture the expressions by reference
+	template <typename T, typename Function, typename Derivative>
+	class NewtonStepper
+	{
+	public:
+		NewtonStepper(Function functionIn, Derivative derivativeIn, T initialGuess, const SolveOptions& optionsIn) :
+			function(std::move(functionIn)),
+			derivative(std::move(derivativeIn)),
+			options(optionsIn),
+			monitor(optionsIn),
+			xn(initialGuess),
+			funcVal(function(initialGuess)),
+			iterNum(1),
+			functionEvaluations(1),
+			derivativeEvaluations(0),
+			finished(false),
+			result()
+		{
+			// a start that is not finite ends the solve right there, as in Newton
+			SolveStatus reason;
+			if (monitor.Start(xn, funcVal, reason)) Finish(solvers::Finish(xn, iterNum, reason, options, functionEvaluations, derivativeEvaluations));
+			else CheckDone();
+		}
+
+		// takes one step. returns true if it reached a new iterate, false if the solve stopped before one
+		// once IsFinished, Next does nothing and returns false
+		bool Next()
+		{
+			if (finished) return false;
+			SolveStatus reason;
+			if (monitor.Interrupted(functionEvaluations + derivativeEvaluations, reason))
+			{
+				Finish(solvers::Finish(xn, iterNum, reason, options, functionEvaluations, derivativeEvaluations));
+				return false;
+			}
+			const T derivVal = derivative(xn);
+			++derivativeEvaluations;
+			if (std::abs(derivVal) < VERY_SMALL_VALUE)
+			{
+				Finish({ xn, iterNum, SolveStatus::ZERO_DERIVATIVE, functionEvaluations, derivativeEvaluations });
+				return false;
+			}
+			const T step = funcVal / derivVal;
+			xn -= step;
+			funcVal = function(xn);
+			++functionEvaluations;
+			if (monitor.Update(xn, step, funcVal, reason))
+			{
+				++iterNum;
+				Finish(solvers::Finish(xn, iterNum, reason, options, functionEvaluations, derivativeEvaluations));
+				return true;
+			}
+			++iterNum;
+			CheckDone();
+			return true;
+		}
+
+		// ends the solve at the current iterate with the given status, for callers that have seen enough
+		void Stop(SolveStatus status)
+		{
+			if (!finished) Finish(solvers::Finish(xn, iterNum, status, options, functionEvaluations, derivativeEvaluations));
+		}
+
+		bool IsFinished() const { return finished; }
+		// the index of the current iterate, 0 for the initial guess
+		int GetIteration() const { return iterNum - 1; }
+		T GetX() const { return xn; }
+		T GetFunctionValue() const { return funcVal; }
+		// only meaningful once IsFinished
+		const SolveResult<T>& GetResult() const { return result; }
+	private:
+		// the loop condition of Newton, checked after every iterate so that a solve is known to be over as soon as it is
+		void CheckDone()
+		{
+			if (iterNum > options.maxSize || IsConverged(funcVal, options))
+			{
+				Finish(solvers::Finish(xn, funcVal, iterNum, options, functionEvaluations, derivativeEvaluations));
+			}
+		}
+
+		void Finish(const SolveResult<T>& resultIn)
+		{
+			result = resultIn;
+			finished = true;
+		}
+
+		Function function;
+		Derivative derivative;
+		SolveOptions options;
+		ConvergenceMonitor<T> monitor;
+		T xn;
+		T funcVal;
+		int iterNum; // the index of the next iterate
+		int functionEvaluations;
+		int derivativeEvaluations;
+		bool finished;
+		SolveResult<T> result;
+	};
+
+	// both schedulers advance the unfinished steppers one iterate at a time, until every one is finished or stepBudget steps have
+	// been taken. stop(index, stepper) is called after every iterate of a solve that is still going, and returning true ends that
+	// solve there with the status CANCELLED. Returns the number of steps taken. Steppers left unfinished by the budget keep
+	// their state, so they can be scheduled again later
+
+	// takes the unfinished steppers in turn, one step each, so every solve gets the same share
+	template <typename Stepper, typename Stop>
+	size_t RunRoundRobin(std::vector<Stepper>& steppers, Stop&& stop, size_t stepBudget = SIZE_MAX)
+	{
+		std::vector<size_t> active;
+		for (size_t i = 0; i < steppers.size(); ++i)
+		{
+			if (!steppers[i].IsFinished()) active.push_back(i);
+		}
+
+		size_t steps = 0;
+		while (!active.empty() && steps < stepBudget)
+		{
+			for (size_t slot = 0; slot < active.size() && steps < stepBudget;)
+			{
+				Stepper& stepper = steppers[active[slot]];
+				++steps;
+				if (stepper.Next() && !stepper.IsFinished() && stop(active[slot], stepper)) stepper.Stop(SolveStatus::CANCELLED);
+				if (stepper.IsFinished())
+				{
+					// the order of the rest does not matter, so the last one takes this slot
+					active[slot] = active.back();
+					active.pop_back();
+				}
+				else
+				{
+					++slot;
+				}
+			}
+		}
+		return steps;
+	}
+
+	// always steps the unfinished stepper that priority(stepper) rates highest, rating it again after every step
+	// with priority -|f(x)| for instance, a limited budget goes to the solves closest to converging
+	// a NaN priority rates lowest, it would leave the queue out of order otherwise
+	template <typename Stepper, typename Priority, typename Stop>
+	size_t RunByPriority(std::vector<Stepper>& steppers, Priority&& priority, Stop&& stop, size_t stepBudget = SIZE_MAX)
+	{
+		const auto rate = [&](const Stepper& stepper)
+		{
+			const double rating = static_cast<double>(priority(stepper));
+			return std::isnan(rating) ? -HUGE_VAL : rating;
+		};
+		std::priority_queue<std::pair<double, size_t>> queue;
+		for (size_t i = 0; i < steppers.size(); ++i)
+		{
+			if (!steppers[i].IsFinished()) queue.push({ rate(steppers[i]), i });
+		}
+
+		size_t steps = 0;
+		while (!queue.empty() && steps < stepBudget)
+		{
+			const size_t index = queue.top().second;
+			queue.pop();
+			Stepper& stepper = steppers[index];
+			++steps;
+			if (stepper.Next() && !stepper.IsFinished() && stop(index, stepper)) stepper.Stop(SolveStatus::CANCELLED);
+			if (!stepper.IsFinished()) queue.push({ rate(stepper), index });
+		}
+		return steps;
+	}
+};
@@ -0,0 +1,48 @@
+// Wire format of the solver server
+// Every message is a fixed size little-endian header, optionally followed by a payload. A client may send any
+// number of requests without waiting for the responses; responses carry the id of their request and may come
+// back in a different order than the requests were sent
+#pragma once
+
+#include <cstdint>
+
+const uint32_t SOLVER_REQUEST_MAGIC = 0x51535652; // "RVSQ"
+const uint32_t SOLVER_RESPONSE_MAGIC = 0x50535652; // "RVSP"
+const uint32_t SOLVER_MAX_EXPRESSION_LENGTH = 1 << 16;
+
+enum class RequestType : uint32_t
+{
+	SOLVE, // solve expression from initialGuess, the response holds the root
+	EVALUATE, // evaluate expression at initialGuess, the response holds the value
+	STATS // no expression, the response payload is a text summary of the server's counters and latencies
+};
+
+// followed by exprLen bytes of expression, without a terminating null
+struct SolverRequestHeader
+{
+	uint32_t magic;
+	uint32_t type; // RequestType
+	uint64_t requestId; // chosen by the client, echoed in the response
+	double initialGuess;
+	double secondGuess; // the other end of the Illinois bracket, or the secant's second point. NaN puts it next to initialGuess,
+	                    // which Illinois cannot use, so an Illinois request with a NaN here is INVALID_INPUT
+	double goalErr;
+	int32_t maxSize;
+	int32_t method; // SolveMethod
+	uint32_t exprLen;
+	uint32_t timeLimit; // microseconds from when the server receives the request, after which a SOLVE stops with TIMED_OUT, 0 disables
+};
+
+// followed by payloadLen bytes, only STATS responses have a payload
+struct SolverResponseHeader
+{
+	uint32_t magic;
+	int32_t status; // SolveStatus, INVALID_INPUT if the expression or request could not be used
+	uint64_t requestId;
+	double value; // the root for SOLVE, f(initialGuess) for EVALUATE
+	int32_t iterations;
+	uint32_t payloadLen;
+};
+
+static_assert(sizeof(SolverRequestHeader) == 56, "SolverRequestHeader must match the wire format");
+static_assert(sizeof(SolverResponseHeader) == 32, "SolverResponseHeader must match the wire format");
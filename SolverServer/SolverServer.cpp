@@ -0,0 +1,397 @@
+// Solver server: a long-running process that answers solve requests over a Unix domain socket, so services
+// that solve many small problems do not pay for loading the DLL, parsing and differentiating on every call
+// Build as a console application together with CanonicalForm.cpp, CompiledExpression.cpp, ExpressionCache.cpp,
+// ExpressionLibrary.cpp, Interval.cpp, Logger.cpp, MappedFile.cpp and ThreadPool.cpp, linking Ws2_32.lib.
+// AF_UNIX sockets need Windows 10 1803 or later
+//
+// usage: SolverServer <socket path> [worker threads] [expression library]
+// The wire format is described in SolverProtocol.h. Compiled expressions are kept, up to EXPRESSION_CACHE_CAPACITY
+// of them or the size of the library if that is larger, so every client after the first one to use an expression gets it
+// warm until it falls out of use. Expressions in the library, if one is given, are warm from the start
+
+#include "../pch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include "../ExpressionCache.h"
+#include "../ExpressionLibrary.h"
+#include <iostream>
+#include "../Logger.h"
+#include <memory>
+#include <mutex>
+#include "../Solvers.h"
+#include "SolverProtocol.h"
+#include <sstream>
+#include <string>
+#include <thread>
+#include "../ThreadPool.h"
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <afunix.h>
+#pragma comment(lib, "Ws2_32.lib")
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+typedef int SOCKET;
+const SOCKET INVALID_SOCKET = -1;
+inline int closesocket(SOCKET socket) { return close(socket); }
+#endif
+
+namespace
+{
+	const size_t LATENCY_SAMPLES = 1 << 16; // most recent request latencies kept for the percentiles
+	const size_t MAX_IN_FLIGHT = 4096; // requests per connection queued or being solved before reading pauses
+	const int STATS_INTERVAL_SECONDS = 10;
+#ifdef MSG_NOSIGNAL
+	const int SEND_FLAGS = MSG_NOSIGNAL; // a client hanging up must not kill the server
+#else
+	const int SEND_FLAGS = 0;
+#endif
+
+	// time from a request being read to its response being sent, over the most recent requests
+	class LatencyRecorder
+	{
+	public:
+		LatencyRecorder() :
+			samples(LATENCY_SAMPLES, 0.0)
+		{ }
+
+		void Record(double micros)
+		{
+			std::lock_guard<std::mutex> lock(samplesMutex);
+			samples[count % samples.size()] = micros;
+			++count;
+		}
+
+		// p50, p99 and max in microseconds
+		std::string Summary()
+		{
+			std::vector<double> sorted;
+			size_t total;
+			{
+				std::lock_guard<std::mutex> lock(samplesMutex);
+				total = count;
+				sorted.assign(samples.begin(), samples.begin() + std::min(count, samples.size()));
+			}
+			if (sorted.empty()) return "requests 0";
+			std::sort(sorted.begin(), sorted.end());
+			std::ostringstream summary;
+			summary << "requests " << total
+				<< ", p50 " << sorted[sorted.size() / 2] << " us"
+				<< ", p99 " << sorted[std::min(sorted.size() - 1, sorted.size() * 99 / 100)] << " us"
+				<< ", max " << sorted.back() << " us";
+			return summary.str();
+		}
+
+		size_t GetCount()
+		{
+			std::lock_guard<std::mutex> lock(samplesMutex);
+			return count;
+		}
+	private:
+		std::vector<double> samples; // ring buffer
+		size_t count = 0;
+		std::mutex samplesMutex;
+	};
+
+	// a response waiting to be written, with when its request was read
+	struct PendingResponse
+	{
+		std::string bytes; // header and payload
+		std::chrono::steady_clock::time_point received;
+	};
+
+	// one client. Owned by its reader thread and by every request of it still being solved, the socket
+	// closes once the last of them is done. Only the connection's writer thread writes to the socket, the workers
+	// queue their responses, so a client that stops reading holds up nobody but itself
+	struct Connection
+	{
+		Connection(SOCKET socketIn) :
+			socket(socketIn)
+		{ }
+		~Connection()
+		{
+			closesocket(socket);
+		}
+
+		const SOCKET socket;
+		std::mutex stateMutex;
+		std::condition_variable roomAvailable; // the reader waits on this while MAX_IN_FLIGHT requests are unanswered
+		std::condition_variable responsesQueued; // the writer waits on this for something to write
+		std::deque<PendingResponse> responses;
+		size_t inFlight = 0; // requests read and not yet written back, whether queued, being solved or waiting to be written
+		bool readerDone = false;
+	};
+
+	struct Server
+	{
+		Server(const std::shared_ptr<Logger>& logger, unsigned int threadCount, size_t cacheCapacity) :
+			cache(logger, cacheCapacity),
+			pool(threadCount)
+		{ }
+
+		ExpressionCache cache;
+		LatencyRecorder latencies;
+		ThreadPool pool;
+		std::atomic<size_t> connections{ 0 };
+	};
+
+	void ServeConnection(std::shared_ptr<Connection> connection, Server& server);
+	// writes the responses the workers queue, until the reader is done and every response is out
+	void WriteResponses(Connection& connection, Server& server);
+	SolverResponseHeader HandleRequest(const SolverRequestHeader& request, const std::string& expr, std::chrono::steady_clock::time_point received,
+		Server& server, std::string& payload);
+	std::string StatsSummary(Server& server);
+	bool ReadFully(SOCKET socket, void* buffer, size_t size);
+	bool WriteFully(SOCKET socket, const void* buffer, size_t size);
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		std::cerr << "usage: SolverServer <socket path> [worker threads] [expression library]\n";
+		return 1;
+	}
+	const std::string socketPath = argv[1];
+
+#ifdef _WIN32
+	WSADATA wsaData;
+	if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+	{
+		std::cerr << "WSAStartup failed\n";
+		return 1;
+	}
+#endif
+
+	sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+	if (socketPath.size() >= sizeof(address.sun_path))
+	{
+		std::cerr << "Socket path is too long: " << socketPath << "\n";
+		return 1;
+	}
+	socketPath.copy(address.sun_path, socketPath.size());
+
+	const SOCKET listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	std::remove(socketPath.c_str()); // left behind by an earlier run
+	if (listener == INVALID_SOCKET ||
+		bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 ||
+		listen(listener, SOMAXCONN) != 0)
+	{
+		std::cerr << "Could not listen on " << socketPath << "\n";
+		return 1;
+	}
+
+	auto logger = std::make_shared<Logger>("server_log.txt");
+	std::unique_ptr<ExpressionLibrary> library;
+	if (argc > 3)
+	{
+		try
+		{
+			library = std::make_unique<ExpressionLibrary>(argv[3], logger);
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << e.what() << "\n";
+			return 1;
+		}
+	}
+	// room for the whole library, so preloading it does not push out part of itself
+	Server server(logger, argc > 2 ? std::stoul(argv[2]) : 0, std::max(EXPRESSION_CACHE_CAPACITY, library ? library->GetCount() : 0));
+	if (library)
+	{
+		library->Preload(server.cache);
+		std::cout << "Loaded " << library->GetCount() << " expressions from " << argv[3] << "\n";
+	}
+	std::cout << "Listening on " << socketPath << " with " << server.pool.GetThreadCount() << " worker threads\n";
+
+	// prints the latencies every so often while there is traffic
+	std::thread([&server]()
+	{
+		size_t reported = 0;
+		while (true)
+		{
+			std::this_thread::sleep_for(std::chrono::seconds(STATS_INTERVAL_SECONDS));
+			const size_t count = server.latencies.GetCount();
+			if (count == reported) continue;
+			reported = count;
+			std::cout << StatsSummary(server) << std::endl;
+		}
+	}).detach();
+
+	while (true)
+	{
+		const SOCKET client = accept(listener, nullptr, nullptr);
+		if (client == INVALID_SOCKET) continue;
+		std::thread(ServeConnection, std::make_shared<Connection>(client), std::ref(server)).detach();
+	}
+}
+
+namespace
+{
+	void ServeConnection(std::shared_ptr<Connection> connection, Server& server)
+	{
+		++server.connections;
+		std::thread writer(WriteResponses, std::ref(*connection), std::ref(server));
+		SolverRequestHeader request;
+		std::string expr;
+		while (ReadFully(connection->socket, &request, sizeof(request)))
+		{
+			if (request.magic != SOLVER_REQUEST_MAGIC || request.exprLen > SOLVER_MAX_EXPRESSION_LENGTH) break; // out of step with the client, nothing to recover
+			expr.resize(request.exprLen);
+			if (request.exprLen > 0 && !ReadFully(connection->socket, &expr[0], expr.size())) break;
+			const auto received = std::chrono::steady_clock::now();
+
+			// wait for room, so a client that never reads its responses cannot queue unbounded work
+			{
+				std::unique_lock<std::mutex> lock(connection->stateMutex);
+				connection->roomAvailable.wait(lock, [&]() { return connection->inFlight < MAX_IN_FLIGHT; });
+				++connection->inFlight;
+			}
+
+			server.pool.Submit([connection, request, expr, received, &server]()
+			{
+				std::string payload;
+				const SolverResponseHeader response = HandleRequest(request, expr, received, server, payload);
+				PendingResponse pending = { std::string(reinterpret_cast<const char*>(&response), sizeof(response)) + payload, received };
+				{
+					std::lock_guard<std::mutex> lock(connection->stateMutex);
+					connection->responses.push_back(std::move(pending));
+				}
+				connection->responsesQueued.notify_one();
+			});
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(connection->stateMutex);
+			connection->readerDone = true;
+		}
+		connection->responsesQueued.notify_one();
+		writer.join();
+		--server.connections;
+	}
+
+	void WriteResponses(Connection& connection, Server& server)
+	{
+		bool clientGone = false;
+		std::unique_lock<std::mutex> lock(connection.stateMutex);
+		while (true)
+		{
+			connection.responsesQueued.wait(lock, [&]() { return !connection.responses.empty() || (connection.readerDone && connection.inFlight == 0); });
+			if (connection.responses.empty()) return;
+			PendingResponse pending = std::move(connection.responses.front());
+			connection.responses.pop_front();
+			lock.unlock();
+
+			// once a write fails the client is gone, the rest are dropped while the reader notices on its next read
+			if (!clientGone) clientGone = !WriteFully(connection.socket, pending.bytes.data(), pending.bytes.size());
+			server.latencies.Record(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - pending.received).count());
+
+			lock.lock();
+			--connection.inFlight;
+			connection.roomAvailable.notify_one();
+		}
+	}
+
+	SolverResponseHeader HandleRequest(const SolverRequestHeader& request, const std::string& expr, std::chrono::steady_clock::time_point received,
+		Server& server, std::string& payload)
+	{
+		SolverResponseHeader response = { SOLVER_RESPONSE_MAGIC, static_cast<int32_t>(SolveStatus::INVALID_INPUT), request.requestId, request.initialGuess, 0, 0 };
+		switch (static_cast<RequestType>(request.type))
+		{
+		case RequestType::STATS:
+			payload = StatsSummary(server);
+			response.status = static_cast<int32_t>(SolveStatus::CONVERGED);
+			response.payloadLen = static_cast<uint32_t>(payload.size());
+			return response;
+		case RequestType::EVALUATE:
+		{
+			const auto expression = server.cache.Get(expr);
+			if (!expression->function) return response;
+			response.value = expression->function->Evaluate(request.initialGuess);
+			response.status = static_cast<int32_t>(SolveStatus::CONVERGED);
+			return response;
+		}
+		case RequestType::SOLVE:
+		{
+			const auto expression = server.cache.Get(expr);
+			const SolveMethod method = static_cast<SolveMethod>(request.method);
+			if (!expression->function || request.maxSize <= 0 ||
+				(method == SolveMethod::NEWTON && !expression->derivative) ||
+				(method == SolveMethod::ILLINOIS && std::isnan(request.secondGuess)))
+			{
+				return response;
+			}
+			const double secondGuess = std::isnan(request.secondGuess) ? solvers::OffsetGuess(request.initialGuess) : request.secondGuess;
+			// the time limit counts from when the request arrived, so time spent queued behind other requests uses it up too
+			SolveOptions options = { request.maxSize, request.goalErr };
+			if (request.timeLimit > 0) options.deadline = received + std::chrono::microseconds(request.timeLimit);
+			try
+			{
+				const SolveResult<double> result = solvers::Solve(method,
+					[&](double x) { return expression->function->Evaluate(x); },
+					[&](double x) { return expression->derivative->Evaluate(x); },
+					request.initialGuess, secondGuess, options,
+					[](int, double) {});
+				response.value = result.root;
+				response.iterations = result.iterations;
+				response.status = static_cast<int32_t>(result.status);
+			}
+			catch (const std::invalid_argument&)
+			{
+				// unknown method
+			}
+			return response;
+		}
+		}
+		return response;
+	}
+
+	std::string StatsSummary(Server& server)
+	{
+		std::ostringstream summary;
+		summary << server.latencies.Summary()
+			<< ", connections " << server.connections
+			<< ", expressions " << server.cache.GetSize()
+			<< ", cache hits " << server.cache.GetHits()
+			<< " (" << server.cache.GetCanonicalHits() << " written differently)"
+			<< ", misses " << server.cache.GetMisses()
+			<< ", evictions " << server.cache.GetEvictions();
+		return summary.str();
+	}
+
+	bool ReadFully(SOCKET socket, void* buffer, size_t size)
+	{
+		char* position = static_cast<char*>(buffer);
+		while (size > 0)
+		{
+			const int received = recv(socket, position, static_cast<int>(size), 0);
+			if (received <= 0) return false;
+			position += received;
+			size -= received;
+		}
+		return true;
+	}
+
+	bool WriteFully(SOCKET socket, const void* buffer, size_t size)
+	{
+		const char* position = static_cast<const char*>(buffer);
+		while (size > 0)
+		{
+			const int sent = send(socket, position, static_cast<int>(size), SEND_FLAGS);
+			if (sent <= 0) return false;
+			position += sent;
+			size -= sent;
+		}
+		return true;
+	}
+}
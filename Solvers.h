@@ -0,0 +1,362 @@
+// Root finding iterations shared by every entry point
+// Function and Derivative may be anything callable with a T, so the same loops serve
+// string expressions, compiled expressions, real values and complex values
+#pragma once
+
+#include <cmath>
+#include <complex>
+#include "ConvergenceMonitor.h"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+enum class SolveMethod
+{
+	NEWTON,
+	SECANT,
+	STEFFENSEN,
+	ILLINOIS
+};
+
+template <typename T>
+struct SolveResult
+{
+	T root;
+	int iterations;
+	SolveStatus status;
+	int functionEvaluations;
+	int derivativeEvaluations;
+};
+
+namespace solvers
+{
+	const double SECANT_OFFSET = 1E-4; // relative offset of the second secant point when only one guess is given
+
+	// a point to start a solve from, found by RankStarts
+	struct StartCandidate
+	{
+		double x;
+		double other; // the other end of the bracket when bracketed, otherwise a point just next to x
+		bool bracketed; // f changes sign between x and other
+		double distance; // estimated distance from x to the root
+	};
+
+	// a second starting point just next to x, for methods that need two
+	template <typename T>
+	T OffsetGuess(T x)
+	{
+		return x + SECANT_OFFSET * (std::abs(x) + 1.0);
+	}
+
+	// every solver follows the same conventions:
+	// observer(iterNum, x) is called with the initial guess (iterNum 0) and with every new iterate
+	// iterations in the result is the number of values passed to the observer, matching SolveForRoot
+	// the loop stops once |f(x)| <= goalErr, after maxSize iterations, or when the ConvergenceMonitor gives up
+	// the evaluation budget, deadline and cancellation in the options are checked before every step, and a solve
+	// stopped by them returns the last iterate it reached
+
+	template <typename T>
+	SolveResult<T> Finish(T xn, int iterNum, SolveStatus status, const SolveOptions& options, int functionEvaluations, int derivativeEvaluations)
+	{
+		if (iterNum > options.maxSize) iterNum = options.maxSize;
+		return { xn, iterNum, status, functionEvaluations, derivativeEvaluations };
+	}
+
+	template <typename T>
+	SolveResult<T> Finish(T xn, T funcVal, int iterNum, const SolveOptions& options, int functionEvaluations, int derivativeEvaluations)
+	{
+		const SolveStatus status = !std::isfinite(std::abs(funcVal)) ? SolveStatus::NOT_FINITE :
+			IsConverged(funcVal, options) ? SolveStatus::CONVERGED :
+			SolveStatus::MAX_ITERATIONS;
+		return Finish(xn, iterNum, status, options, functionEvaluations, derivativeEvaluations);
+	}
+
+	// Newton's Method
+	// x[n+1] = x[n] - f[x] / f'[x]
+	// error == f[x]
+	template <typename T, typename Function, typename Derivative, typename Observer>
+	SolveResult<T> Newton(Function&& function, Derivative&& derivative, T initialGuess, const SolveOptions& options, Observer&& observer)
+	{
+		T xn = initialGuess;
+		T funcVal = function(xn);
+		int functionEvaluations = 1;
+		int derivativeEvaluations = 0;
+		observer(0, xn);
+		ConvergenceMonitor<T> monitor(options);
+		SolveStatus reason;
+		if (monitor.Start(xn, funcVal, reason)) return Finish(xn, 1, reason, options, functionEvaluations, derivativeEvaluations);
+
+		int iterNum = 1;
+		for (; iterNum <= options.maxSize && !IsConverged(funcVal, options); ++iterNum)
+		{
+			if (monitor.Interrupted(functionEvaluations + derivativeEvaluations, reason)) return Finish(xn, iterNum, reason, options, functionEvaluations, derivativeEvaluations);
+			const T derivVal = derivative(xn);
+			++derivativeEvaluations;
+			if (std::abs(derivVal) < VERY_SMALL_VALUE)
+			{
+				return { xn, iterNum, SolveStatus::ZERO_DERIVATIVE, functionEvaluations, derivativeEvaluations };
+			}
+			const T step = funcVal / derivVal;
+			xn -= step;
+			funcVal = function(xn);
+			++functionEvaluations;
+			observer(iterNum, xn);
+			if (monitor.Update(xn, step, funcVal, reason)) return Finish(xn, iterNum + 1, reason, options, functionEvaluations, derivativeEvaluations);
+		}
+		return Finish(xn, funcVal, iterNum, options, functionEvaluations, derivativeEvaluations);
+	}
+
+	// Secant Method, Newton's Method with f'[x] replaced by the slope through the last two iterates
+	// x[n+1] = x[n] - f[x[n]] * (x[n] - x[n-1]) / (f[x[n]] - f[x[n-1]])
+	// secondGuess only seeds the first slope, it is not reported as an iterate
+	// one function evaluation per step
+	template <typename T, typename Function, typename Observer>
+	SolveResult<T> Secant(Function&& function, T initialGuess, T secondGuess, const SolveOptions& options, Observer&& observer)
+	{
+		T xPrev = secondGuess;
+		T funcValPrev = function(xPrev);
+		T xn = initialGuess;
+		T funcVal = function(xn);
+		int functionEvaluations = 2;
+		observer(0, xn);
+		ConvergenceMonitor<T> monitor(options);
+		SolveStatus reason;
+		if (monitor.Start(xn, funcVal, reason)) return Finish(xn, 1, reason, options, functionEvaluations, 0);
+
+		int iterNum = 1;
+		for (; iterNum <= options.maxSize && !IsConverged(funcVal, options); ++iterNum)
+		{
+			if (monitor.Interrupted(functionEvaluations, reason)) return Finish(xn, iterNum, reason, options, functionEvaluations, 0);
+			const T funcDiff = funcVal - funcValPrev;
+			if (std::abs(funcDiff) < VERY_SMALL_VALUE)
+			{
+				return { xn, iterNum, SolveStatus::ZERO_DERIVATIVE, functionEvaluations, 0 };
+			}
+			const T step = funcVal * (xn - xPrev) / funcDiff;
+			xPrev = xn;
+			funcValPrev = funcVal;
+			xn -= step;
+			funcVal = function(xn);
+			++functionEvaluations;
+			observer(iterNum, xn);
+			if (monitor.Update(xn, step, funcVal, reason)) return Finish(xn, iterNum + 1, reason, options, functionEvaluations, 0);
+		}
+		return Finish(xn, funcVal, iterNum, options, functionEvaluations, 0);
+	}
+
+	// Steffensen's Method, Newton's Method with f'[x] replaced by (f[x + f[x]] - f[x]) / f[x]
+	// converges quadratically like Newton's Method, at the price of two function evaluations per step
+	template <typename T, typename Function, typename Observer>
+	SolveResult<T> Steffensen(Function&& function, T initialGuess, const SolveOptions& options, Observer&& observer)
+	{
+		T xn = initialGuess;
+		T funcVal = function(xn);
+		int functionEvaluations = 1;
+		observer(0, xn);
+		ConvergenceMonitor<T> monitor(options);
+		SolveStatus reason;
+		if (monitor.Start(xn, funcVal, reason)) return Finish(xn, 1, reason, options, functionEvaluations, 0);
+
+		int iterNum = 1;
+		for (; iterNum <= options.maxSize && !IsConverged(funcVal, options); ++iterNum)
+		{
+			if (monitor.Interrupted(functionEvaluations, reason)) return Finish(xn, iterNum, reason, options, functionEvaluations, 0);
+			const T funcDiff = function(xn + funcVal) - funcVal;
+			++functionEvaluations;
+			if (std::abs(funcDiff) < VERY_SMALL_VALUE)
+			{
+				return { xn, iterNum, SolveStatus::ZERO_DERIVATIVE, functionEvaluations, 0 };
+			}
+			const T step = funcVal * funcVal / funcDiff;
+			xn -= step;
+			funcVal = function(xn);
+			++functionEvaluations;
+			observer(iterNum, xn);
+			if (monitor.Update(xn, step, funcVal, reason)) return Finish(xn, iterNum + 1, reason, options, functionEvaluations, 0);
+		}
+		return Finish(xn, funcVal, iterNum, options, functionEvaluations, 0);
+	}
+
+	// Illinois variant of regula falsi, real values only
+	// initialGuess and secondGuess must bracket a root (f has opposite signs at each)
+	// the end of the bracket that is kept twice in a row has its function value halved, which avoids
+	// the one-sided convergence of plain regula falsi
+	// one function evaluation per step
+	template <typename T, typename Function, typename Observer>
+	SolveResult<T> Illinois(Function&& function, T initialGuess, T secondGuess, const SolveOptions& options, Observer&& observer)
+	{
+		T a = secondGuess;
+		T funcValA = function(a);
+		T b = initialGuess;
+		T funcValB = function(b);
+		int functionEvaluations = 2;
+		observer(0, b);
+
+		ConvergenceMonitor<T> monitor(options);
+		SolveStatus reason;
+		if (monitor.Start(b, funcValB, reason)) return Finish(b, 1, reason, options, functionEvaluations, 0);
+		// a NaN at the other end brackets nothing, it would pass the sign test as positive
+		if (!IsConverged(funcValB, options) && (!std::isfinite(funcValA) || (funcValA < 0) == (funcValB < 0)))
+		{
+			return { b, 1, SolveStatus::NO_BRACKET, functionEvaluations, 0 };
+		}
+
+		int iterNum = 1;
+		for (; iterNum <= options.maxSize && !IsConverged(funcValB, options); ++iterNum)
+		{
+			if (monitor.Interrupted(functionEvaluations, reason)) return Finish(b, iterNum, reason, options, functionEvaluations, 0);
+			const T funcDiff = funcValB - funcValA;
+			if (std::abs(funcDiff) < VERY_SMALL_VALUE)
+			{
+				return { b, iterNum, SolveStatus::ZERO_DERIVATIVE, functionEvaluations, 0 };
+			}
+			const T c = (a * funcValB - b * funcValA) / funcDiff;
+			const T funcValC = function(c);
+			++functionEvaluations;
+			if ((funcValC < 0) != (funcValB < 0))
+			{
+				// the root is between b and c, b becomes the other end of the bracket
+				a = b;
+				funcValA = funcValB;
+			}
+			else
+			{
+				// a is kept again, reduce its weight
+				funcValA /= 2;
+			}
+			const T step = c - b;
+			b = c;
+			funcValB = funcValC;
+			observer(iterNum, b);
+			if (monitor.Update(b, step, funcValB, reason)) return Finish(b, iterNum + 1, reason, options, functionEvaluations, 0);
+		}
+		return Finish(b, funcValB, iterNum, options, functionEvaluations, 0);
+	}
+
+	// picks starting points by sampling f at sampleCount evenly spaced points of [lo, hi], best first and at most
+	// maxCandidates of them. sample(xs, values, count) stores f at each of the count points in xs, so that they can be evaluated
+	// together, in lanes for instance. Sign changes between neighbouring samples come first, starting from whichever end has the smaller |f|
+	// and ranked by how far the secant through the two puts the root. A sign change where the slope between the samples disagrees
+	// with f' is a pole (as in tan) and is skipped. After those come the samples where |f| has a local minimum without changing sign,
+	// where f dips towards 0 and may touch it, ranked by their Newton step |f/f'|. The derivative is only evaluated at those points
+	// real values only. functionEvaluations and derivativeEvaluations are increased by the evaluations used
+	template <typename Sample, typename Derivative>
+	std::vector<StartCandidate> RankStarts(Sample&& sample, Derivative&& derivative, double lo, double hi, int sampleCount, size_t maxCandidates,
+		int& functionEvaluations, int& derivativeEvaluations)
+	{
+		if (sampleCount < 2 || !(hi > lo)) throw std::invalid_argument("RankStarts - needs at least 2 samples of a non-empty range");
+
+		const double spacing = (hi - lo) / (sampleCount - 1);
+		std::vector<double> xs(sampleCount);
+		std::vector<double> funcVals(sampleCount);
+		for (int i = 0; i < sampleCount; ++i) xs[i] = lo + spacing * i;
+		sample(xs.data(), funcVals.data(), xs.size());
+		functionEvaluations += sampleCount;
+		auto derivativeAt = [&](int i)
+		{
+			++derivativeEvaluations;
+			const double derivVal = derivative(xs[i]);
+			return std::isfinite(derivVal) ? derivVal : 0.0;
+		};
+		auto finiteAt = [&](int i) { return i >= 0 && i < sampleCount && std::isfinite(funcVals[i]); };
+
+		std::vector<StartCandidate> brackets;
+		std::vector<StartCandidate> dips;
+		for (int i = 0; i < sampleCount; ++i)
+		{
+			if (!finiteAt(i)) continue;
+			if (funcVals[i] == 0.0)
+			{
+				brackets.push_back({ xs[i], OffsetGuess(xs[i]), true, 0.0 });
+				continue;
+			}
+			const bool signChangeBefore = finiteAt(i - 1) && funcVals[i - 1] != 0.0 && (funcVals[i - 1] < 0) != (funcVals[i] < 0);
+			const bool signChangeAfter = finiteAt(i + 1) && funcVals[i + 1] != 0.0 && (funcVals[i + 1] < 0) != (funcVals[i] < 0);
+			if (signChangeAfter)
+			{
+				const int nearer = std::abs(funcVals[i]) <= std::abs(funcVals[i + 1]) ? i : i + 1;
+				const int farther = nearer == i ? i + 1 : i;
+				const double derivVal = derivativeAt(nearer);
+				const bool risesAcross = funcVals[i + 1] > funcVals[i];
+				const double secantDistance = std::abs(funcVals[nearer]) * spacing / std::abs(funcVals[i + 1] - funcVals[i]);
+				if (derivVal != 0.0 && (derivVal > 0) == risesAcross) brackets.push_back({ xs[nearer], xs[farther], true, secantDistance });
+			}
+			const bool belowPrevious = !finiteAt(i - 1) || std::abs(funcVals[i]) <= std::abs(funcVals[i - 1]);
+			const bool belowNext = !finiteAt(i + 1) || std::abs(funcVals[i]) < std::abs(funcVals[i + 1]);
+			if (belowPrevious && belowNext && !signChangeBefore && !signChangeAfter)
+			{
+				const double derivVal = derivativeAt(i);
+				if (std::abs(derivVal) >= VERY_SMALL_VALUE) dips.push_back({ xs[i], OffsetGuess(xs[i]), false, std::abs(funcVals[i] / derivVal) });
+			}
+		}
+
+		auto nearest = [](const StartCandidate& a, const StartCandidate& b) { return a.distance < b.distance; };
+		std::stable_sort(brackets.begin(), brackets.end(), nearest);
+		std::stable_sort(dips.begin(), dips.end(), nearest);
+		brackets.insert(brackets.end(), dips.begin(), dips.end());
+		if (brackets.size() > maxCandidates) brackets.resize(maxCandidates);
+		return brackets;
+	}
+
+	// runs the given method. derivative is only called by Newton's Method and secondGuess is only used by
+	// the secant and Illinois methods
+	template <typename T, typename Function, typename Derivative, typename Observer>
+	SolveResult<T> Solve(SolveMethod method, Function&& function, Derivative&& derivative, T initialGuess, T secondGuess, const SolveOptions& options, Observer&& observer)
+	{
+		switch (method)
+		{
+		case SolveMethod::NEWTON:
+			return Newton(function, derivative, initialGuess, options, observer);
+		case SolveMethod::SECANT:
+			return Secant(function, initialGuess, secondGuess, options, observer);
+		case SolveMethod::STEFFENSEN:
+			return Steffensen(function, initialGuess, options, observer);
+		case SolveMethod::ILLINOIS:
+			return Illinois(function, initialGuess, secondGuess, options, observer);
+		}
+		throw std::invalid_argument("Solve - unknown solve method " + std::to_string(static_cast<int>(method)));
+	}
+
+	// runs the given method from each of starts in turn, until a solve converges or is stopped by the limits in the options
+	// the starts share options.maxSize and options.maxEvaluations, less the usedEvaluations already spent finding them, so a
+	// search with several starts stays within the limits of one solve. The result is the last solve's, with the evaluations
+	// of all of them added up, not counting usedEvaluations
+	template <typename Function, typename Derivative, typename Observer>
+	SolveResult<double> SolveFromStarts(SolveMethod method, Function&& function, Derivative&& derivative, const std::vector<StartCandidate>& starts,
+		const SolveOptions& options, int usedEvaluations, Observer&& observer)
+	{
+		if (starts.empty()) throw std::invalid_argument("SolveFromStarts - no starting points");
+
+		SolveResult<double> result = { starts.front().x, 0, SolveStatus::BUDGET_EXHAUSTED, 0, 0 };
+		int iterations = 0;
+		int functionEvaluations = 0;
+		int derivativeEvaluations = 0;
+		for (const StartCandidate& start : starts)
+		{
+			SolveOptions remaining = options;
+			remaining.maxSize = options.maxSize - iterations;
+			if (iterations > 0 && remaining.maxSize < 1) break;
+			if (options.maxEvaluations > 0)
+			{
+				// 0 would turn the budget off
+				remaining.maxEvaluations = options.maxEvaluations - usedEvaluations - functionEvaluations - derivativeEvaluations;
+				if (remaining.maxEvaluations <= 0)
+				{
+					result.status = SolveStatus::BUDGET_EXHAUSTED;
+					break;
+				}
+			}
+			result = Solve(method, function, derivative, start.x, start.other, remaining, observer);
+			iterations += result.iterations;
+			functionEvaluations += result.functionEvaluations;
+			derivativeEvaluations += result.derivativeEvaluations;
+			if (result.status == SolveStatus::CONVERGED || result.status == SolveStatus::CONVERGED_STEP || result.status == SolveStatus::CANCELLED ||
+				result.status == SolveStatus::TIMED_OUT || result.status == SolveStatus::BUDGET_EXHAUSTED) break;
+		}
+		result.functionEvaluations = functionEvaluations;
+		result.derivativeEvaluations = derivativeEvaluations;
+		return result;
+	}
+};
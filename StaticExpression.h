@@ -0,0 +1,354 @@
+// Expressions written directly in C++, for models that are known when the code is built
+//
+//     using namespace staticexpr;
+//     constexpr auto f = sin(X) - X*X + 2_c;
+//     auto result = solvers::Newton(f, Derivative(f), 1.0, options, observer);
+//
+// The expression is a tree of small types, so evaluating it is plain inlined arithmetic with no parsing and
+// no interpreting. Derivative() builds the derivative's type at compile time, dropping terms that are known
+// to be 0 or 1. Expressions and their derivatives are callables taking a T (double or std::complex<double>),
+// the same as what the solvers in Solvers.h take
+#pragma once
+
+#include <cmath>
+#include <complex>
+#include <type_traits>
+
+namespace staticexpr
+{
+	// every expression type derives from this, which limits the operators below to expressions
+	struct ExpressionTag { };
+
+	template <typename E>
+	constexpr bool IS_EXPRESSION = std::is_base_of<ExpressionTag, E>::value;
+
+	// 0 and 1 have their own types, so they can be simplified away while building derivatives
+	struct Zero : ExpressionTag
+	{
+		template <typename T>
+		constexpr T operator()(T) const { return T(0); }
+	};
+
+	struct One : ExpressionTag
+	{
+		template <typename T>
+		constexpr T operator()(T) const { return T(1); }
+	};
+
+	struct Constant : ExpressionTag
+	{
+		constexpr explicit Constant(double valueIn) : value(valueIn) { }
+
+		template <typename T>
+		constexpr T operator()(T) const { return T(value); }
+
+		double value;
+	};
+
+	struct Variable : ExpressionTag
+	{
+		template <typename T>
+		constexpr T operator()(T x) const { return x; }
+	};
+
+	template <typename A>
+	struct Negate : ExpressionTag
+	{
+		constexpr explicit Negate(A aIn) : a(aIn) { }
+
+		template <typename T>
+		constexpr T operator()(T x) const { return -a(x); }
+
+		A a;
+	};
+
+	// binary operations and functions only differ in how they combine their operands
+	template <typename A, typename B>
+	struct Binary : ExpressionTag
+	{
+		constexpr Binary(A aIn, B bIn) : a(aIn), b(bIn) { }
+
+		A a;
+		B b;
+	};
+
+	template <typename A, typename B>
+	struct Add : Binary<A, B>
+	{
+		using Binary<A, B>::Binary;
+
+		template <typename T>
+		constexpr T operator()(T x) const { return this->a(x) + this->b(x); }
+	};
+
+	template <typename A, typename B>
+	struct Subtract : Binary<A, B>
+	{
+		using Binary<A, B>::Binary;
+
+		template <typename T>
+		constexpr T operator()(T x) const { return this->a(x) - this->b(x); }
+	};
+
+	template <typename A, typename B>
+	struct Multiply : Binary<A, B>
+	{
+		using Binary<A, B>::Binary;
+
+		template <typename T>
+		constexpr T operator()(T x) const { return this->a(x) * this->b(x); }
+	};
+
+	template <typename A, typename B>
+	struct Divide : Binary<A, B>
+	{
+		using Binary<A, B>::Binary;
+
+		template <typename T>
+		constexpr T operator()(T x) const { return this->a(x) / this->b(x); }
+	};
+
+	template <typename A, typename B>
+	struct Power : Binary<A, B>
+	{
+		using Binary<A, B>::Binary;
+
+		template <typename T>
+		T operator()(T x) const { return std::pow(this->a(x), this->b(x)); }
+	};
+
+	template <typename A>
+	struct Sin : ExpressionTag
+	{
+		constexpr explicit Sin(A aIn) : a(aIn) { }
+
+		template <typename T>
+		T operator()(T x) const { return std::sin(a(x)); }
+
+		A a;
+	};
+
+	template <typename A>
+	struct Cos : ExpressionTag
+	{
+		constexpr explicit Cos(A aIn) : a(aIn) { }
+
+		template <typename T>
+		T operator()(T x) const { return std::cos(a(x)); }
+
+		A a;
+	};
+
+	template <typename A>
+	struct Tan : ExpressionTag
+	{
+		constexpr explicit Tan(A aIn) : a(aIn) { }
+
+		template <typename T>
+		T operator()(T x) const { return std::tan(a(x)); }
+
+		A a;
+	};
+
+	template <typename A>
+	struct Ln : ExpressionTag
+	{
+		constexpr explicit Ln(A aIn) : a(aIn) { }
+
+		template <typename T>
+		T operator()(T x) const { return std::log(a(x)); }
+
+		A a;
+	};
+
+	// builders that simplify while they go: anything times 0 is 0, 1 * a is a, constants are folded, and so on
+	// the derivatives are built from these, which keeps them from filling up with multiplications by 1
+
+	template <typename E>
+	constexpr auto ToExpression(E e)
+	{
+		if constexpr (IS_EXPRESSION<E>) return e;
+		else return Constant(static_cast<double>(e));
+	}
+
+	template <typename A>
+	constexpr auto MakeNegate(A a)
+	{
+		if constexpr (std::is_same<A, Zero>::value) return Zero();
+		else if constexpr (std::is_same<A, Constant>::value) return Constant(-a.value);
+		else if constexpr (std::is_same<A, One>::value) return Constant(-1.0);
+		else return Negate<A>(a);
+	}
+
+	template <typename A, typename B>
+	constexpr auto MakeAdd(A a, B b)
+	{
+		if constexpr (std::is_same<A, Zero>::value) return b;
+		else if constexpr (std::is_same<B, Zero>::value) return a;
+		else if constexpr (std::is_same<A, Constant>::value && std::is_same<B, Constant>::value) return Constant(a.value + b.value);
+		else return Add<A, B>(a, b);
+	}
+
+	template <typename A, typename B>
+	constexpr auto MakeSubtract(A a, B b)
+	{
+		if constexpr (std::is_same<B, Zero>::value) return a;
+		else if constexpr (std::is_same<A, Zero>::value) return MakeNegate(b);
+		else if constexpr (std::is_same<A, Constant>::value && std::is_same<B, Constant>::value) return Constant(a.value - b.value);
+		else return Subtract<A, B>(a, b);
+	}
+
+	template <typename A, typename B>
+	constexpr auto MakeMultiply(A a, B b)
+	{
+		if constexpr (std::is_same<A, Zero>::value || std::is_same<B, Zero>::value) return Zero();
+		else if constexpr (std::is_same<A, One>::value) return b;
+		else if constexpr (std::is_same<B, One>::value) return a;
+		else if constexpr (std::is_same<A, Constant>::value && std::is_same<B, Constant>::value) return Constant(a.value * b.value);
+		else return Multiply<A, B>(a, b);
+	}
+
+	template <typename A, typename B>
+	constexpr auto MakeDivide(A a, B b)
+	{
+		if constexpr (std::is_same<A, Zero>::value) return Zero();
+		else if constexpr (std::is_same<B, One>::value) return a;
+		else if constexpr (std::is_same<A, Constant>::value && std::is_same<B, Constant>::value) return Constant(a.value / b.value);
+		else return Divide<A, B>(a, b);
+	}
+
+	template <typename A, typename B>
+	constexpr auto MakePower(A a, B b)
+	{
+		if constexpr (std::is_same<B, Zero>::value) return One();
+		else if constexpr (std::is_same<B, One>::value) return a;
+		else return Power<A, B>(a, b);
+	}
+
+	// operators and functions, either side may be a plain number
+	template <typename A, typename B>
+	using EnableForExpressions = typename std::enable_if<(IS_EXPRESSION<A> || IS_EXPRESSION<B>) &&
+		(IS_EXPRESSION<A> || std::is_arithmetic<A>::value) && (IS_EXPRESSION<B> || std::is_arithmetic<B>::value)>::type;
+
+	template <typename A, typename = typename std::enable_if<IS_EXPRESSION<A>>::type>
+	constexpr auto operator-(A a) { return MakeNegate(a); }
+
+	template <typename A>
+	constexpr auto operator+(A a) -> typename std::enable_if<IS_EXPRESSION<A>, A>::type { return a; }
+
+	template <typename A, typename B, typename = EnableForExpressions<A, B>>
+	constexpr auto operator+(A a, B b) { return MakeAdd(ToExpression(a), ToExpression(b)); }
+
+	template <typename A, typename B, typename = EnableForExpressions<A, B>>
+	constexpr auto operator-(A a, B b) { return MakeSubtract(ToExpression(a), ToExpression(b)); }
+
+	template <typename A, typename B, typename = EnableForExpressions<A, B>>
+	constexpr auto operator*(A a, B b) { return MakeMultiply(ToExpression(a), ToExpression(b)); }
+
+	template <typename A, typename B, typename = EnableForExpressions<A, B>>
+	constexpr auto operator/(A a, B b) { return MakeDivide(ToExpression(a), ToExpression(b)); }
+
+	// ^ binds too loosely in C++ to stand for powers, so they are written pow(a, b)
+	template <typename A, typename B, typename = EnableForExpressions<A, B>>
+	constexpr auto pow(A a, B b) { return MakePower(ToExpression(a), ToExpression(b)); }
+
+	template <typename A, typename = typename std::enable_if<IS_EXPRESSION<A>>::type>
+	constexpr auto sin(A a) { return Sin<A>(a); }
+
+	template <typename A, typename = typename std::enable_if<IS_EXPRESSION<A>>::type>
+	constexpr auto cos(A a) { return Cos<A>(a); }
+
+	template <typename A, typename = typename std::enable_if<IS_EXPRESSION<A>>::type>
+	constexpr auto tan(A a) { return Tan<A>(a); }
+
+	template <typename A, typename = typename std::enable_if<IS_EXPRESSION<A>>::type>
+	constexpr auto ln(A a) { return Ln<A>(a); }
+
+	constexpr Variable X;
+	constexpr Constant E(M_E);
+
+	namespace literals
+	{
+		constexpr Constant operator""_c(long double value) { return Constant(static_cast<double>(value)); }
+		constexpr Constant operator""_c(unsigned long long value) { return Constant(static_cast<double>(value)); }
+	};
+	using namespace literals;
+
+	// derivatives with respect to X, the same rules as Expression::Derivative
+	constexpr Zero Derivative(Zero) { return Zero(); }
+	constexpr Zero Derivative(One) { return Zero(); }
+	constexpr Zero Derivative(Constant) { return Zero(); }
+	constexpr One Derivative(Variable) { return One(); }
+
+	template <typename A>
+	constexpr auto Derivative(Negate<A> e)
+	{
+		return MakeNegate(Derivative(e.a));
+	}
+
+	template <typename A, typename B>
+	constexpr auto Derivative(Add<A, B> e)
+	{
+		return MakeAdd(Derivative(e.a), Derivative(e.b));
+	}
+
+	template <typename A, typename B>
+	constexpr auto Derivative(Subtract<A, B> e)
+	{
+		return MakeSubtract(Derivative(e.a), Derivative(e.b));
+	}
+
+	template <typename A, typename B>
+	constexpr auto Derivative(Multiply<A, B> e)
+	{
+		// (ab)' = a'b + ab'
+		return MakeAdd(MakeMultiply(Derivative(e.a), e.b), MakeMultiply(e.a, Derivative(e.b)));
+	}
+
+	template <typename A, typename B>
+	constexpr auto Derivative(Divide<A, B> e)
+	{
+		// (a/b)' = (a'b - ab') / b^2
+		return MakeDivide(MakeSubtract(MakeMultiply(Derivative(e.a), e.b), MakeMultiply(e.a, Derivative(e.b))), MakeMultiply(e.b, e.b));
+	}
+
+	template <typename A, typename B>
+	constexpr auto Derivative(Power<A, B> e)
+	{
+		if constexpr (std::is_same<B, Constant>::value)
+		{
+			// (a^n)' = n a^(n-1) a'
+			return MakeMultiply(MakeMultiply(e.b, MakePower(e.a, Constant(e.b.value - 1.0))), Derivative(e.a));
+		}
+		else
+		{
+			// (a^b)' = a^b (b' ln(a) + b a' / a)
+			return MakeMultiply(e, MakeAdd(MakeMultiply(Derivative(e.b), Ln<A>(e.a)), MakeDivide(MakeMultiply(e.b, Derivative(e.a)), e.a)));
+		}
+	}
+
+	template <typename A>
+	constexpr auto Derivative(Sin<A> e)
+	{
+		return MakeMultiply(Cos<A>(e.a), Derivative(e.a));
+	}
+
+	template <typename A>
+	constexpr auto Derivative(Cos<A> e)
+	{
+		return MakeNegate(MakeMultiply(Sin<A>(e.a), Derivative(e.a)));
+	}
+
+	template <typename A>
+	constexpr auto Derivative(Tan<A> e)
+	{
+		// tan' = 1 / cos^2
+		return MakeDivide(Derivative(e.a), MakeMultiply(Cos<A>(e.a), Cos<A>(e.a)));
+	}
+
+	template <typename A>
+	constexpr auto Derivative(Ln<A> e)
+	{
+		return MakeDivide(Derivative(e.a), e.a);
+	}
+};
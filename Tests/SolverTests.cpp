@@ -0,0 +1,414 @@
+// Regression checks for the solvers, run as a console application: prints every check that fails and exits with 1 if any did
+// Build as a console application together with BytecodeExpression.cpp, CanonicalForm.cpp, CompiledExpression.cpp,
+// Expression.cpp, ExpressionCache.cpp, IncrementalEvaluator.cpp, Interval.cpp, LaneSolver.cpp and Logger.cpp
+
+#include "../pch.h"
+
+#include "../CanonicalForm.h"
+#include <chrono>
+#include <cmath>
+#include "../CompiledExpression.h"
+#include "../Expression.h"
+#include "../ExpressionCache.h"
+#include <functional>
+#include <iostream>
+#include "../LaneSolver.h"
+#include "../Logger.h"
+#include <memory>
+#include <random>
+#include "../SolveScheduler.h"
+#include "../Solvers.h"
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	const SolveOptions OPTIONS = { 100, 1E-10 };
+	const char* const METHOD_NAMES[] = { "Newton", "secant", "Steffensen", "Illinois" };
+
+	int checks = 0;
+	int failures = 0;
+
+	void Check(bool passed, const std::string& description);
+	std::string StatusName(SolveStatus status);
+
+	// a start where f is NaN (or infinite) is not a root, whatever goalErr is
+	void TestNonFiniteStarts(const std::shared_ptr<Logger>& logger);
+	// NewtonLanes gives exactly what Newton gives for every start, including starts where f is NaN or infinite
+	void TestLanesMatchNewton(const std::shared_ptr<Logger>& logger);
+	// the cache stays within its capacity, dropping the least recently used expression and its canonical form with it
+	void TestExpressionCacheEviction(const std::shared_ptr<Logger>& logger);
+	// Expression gives the same values from the string evaluator as after it moves to the compiled form, and so does its derivative
+	void TestTierAgreement(const std::shared_ptr<Logger>& logger);
+	// the starts of SolveFromStarts share one solve's iterations and evaluations, after the ones spent finding them
+	void TestStartsShareBudget(const std::shared_ptr<Logger>& logger);
+	// NewtonStepper, stepped by hand or by either scheduler, finishes where Newton does, including from starts where f is NaN or infinite
+	// and with priorities that come out NaN
+	void TestStepperMatchesNewton(const std::shared_ptr<Logger>& logger);
+	// a canonical form reads back as itself and has the value of the expression, NaN included, also where terms cancel
+	void TestCanonicalRoundTrip(const std::shared_ptr<Logger>& logger);
+	// the monitor's default checks let a solve that overshoots far work its way back, and divergenceLimit 0 turns divergence off entirely
+	void TestOvershootRecovers(const std::shared_ptr<Logger>& logger);
+	// 0*t and 0/t are NaN wherever t is NaN or infinite, or 0 for 0/t, as written, while derivatives still drop terms of constants
+	void TestZeroProductsKeepDomain(const std::shared_ptr<Logger>& logger);
+}
+
+int main()
+{
+	auto logger = std::make_shared<Logger>("tests_log.txt");
+
+	TestNonFiniteStarts(logger);
+	TestLanesMatchNewton(logger);
+	TestExpressionCacheEviction(logger);
+	TestTierAgreement(logger);
+	TestStartsShareBudget(logger);
+	TestStepperMatchesNewton(logger);
+	TestCanonicalRoundTrip(logger);
+	TestOvershootRecovers(logger);
+	TestZeroProductsKeepDomain(logger);
+
+	std::cout << checks << " checks, " << failures << " failed" << std::endl;
+	return failures == 0 ? 0 : 1;
+}
+
+namespace
+{
+	void Check(bool passed, const std::string& description)
+	{
+		++checks;
+		if (passed) return;
+		++failures;
+		std::cout << "FAILED: " << description << std::endl;
+	}
+
+	std::string StatusName(SolveStatus status)
+	{
+		const char* const names[] = { "CONVERGED", "MAX_ITERATIONS", "ZERO_DERIVATIVE", "NO_BRACKET", "CONVERGED_STEP", "STAGNATED", "CYCLING",
+			"NOT_FINITE", "DIVERGED", "INVALID_INPUT", "CANCELLED", "TIMED_OUT", "BUDGET_EXHAUSTED" };
+		const size_t index = static_cast<size_t>(status);
+		return index < sizeof(names) / sizeof(names[0]) ? names[index] : std::to_string(index);
+	}
+
+	void TestNonFiniteStarts(const std::shared_ptr<Logger>& logger)
+	{
+		const struct
+		{
+			const char* expr;
+			double initialGuess;
+			double secondGuess; // a valid point, so only the initial guess is bad
+		} cases[] =
+		{
+			{ "sqrt(x)-2", -4.0, 9.0 },
+			{ "ln(x)", -1.0, 2.0 },
+			{ "1/x", 0.0, 1.0 },
+		};
+		auto ignore = [](int, double) {};
+		for (const auto& testCase : cases)
+		{
+			const CompiledExpression function(testCase.expr, logger);
+			const CompiledExpression compiledDerivative = function.Derivative();
+			auto f = [&](double x) { return function.Evaluate(x); };
+			auto derivative = [&](double x) { return compiledDerivative.Evaluate(x); };
+			for (int method = 0; method < 4; ++method)
+			{
+				const SolveResult<double> result = solvers::Solve(static_cast<SolveMethod>(method), f, derivative,
+					testCase.initialGuess, testCase.secondGuess, OPTIONS, ignore);
+				Check(result.status == SolveStatus::NOT_FINITE && result.root == testCase.initialGuess && result.iterations == 1,
+					std::string(METHOD_NAMES[method]) + " on " + testCase.expr + " from " + std::to_string(testCase.initialGuess) +
+					" stops as NOT_FINITE at the guess, got " + StatusName(result.status) + " at " + std::to_string(result.root) +
+					" after " + std::to_string(result.iterations) + " iterations");
+			}
+
+			// the other way round, Illinois has no bracket when one end is NaN
+			const SolveResult<double> swapped = solvers::Illinois(f, testCase.secondGuess, testCase.initialGuess, OPTIONS, ignore);
+			Check(swapped.status == SolveStatus::NO_BRACKET, std::string("Illinois on ") + testCase.expr +
+				" with a NaN end is NO_BRACKET, got " + StatusName(swapped.status));
+		}
+	}
+
+	void TestExpressionCacheEviction(const std::shared_ptr<Logger>& logger)
+	{
+		ExpressionCache cache(logger, 2);
+		const auto square = cache.Get("x^2-2");
+		cache.Get("x^3");
+		cache.Get("x^2-2"); // x^3 is now the least recently used
+		cache.Get("sin(x)");
+		Check(cache.GetSize() == 2 && cache.GetEvictions() == 1, "a cache of 2 holds 2 expressions after 3, got " +
+			std::to_string(cache.GetSize()) + " with " + std::to_string(cache.GetEvictions()) + " evictions");
+		Check(cache.Get("x*x-2") == square && cache.GetCanonicalHits() == 1, "x*x-2 shares the entry of x^2-2, which was kept");
+
+		const size_t misses = cache.GetMisses();
+		cache.Get("x^3");
+		Check(cache.GetMisses() == misses + 1, "x^3 was evicted and compiles again");
+		Check(cache.GetSize() == 2, "the cache is still within its capacity, holds " + std::to_string(cache.GetSize()));
+
+		// every spelling of x^2-2 is gone now, so its canonical form must be too
+		cache.Get("cos(x)");
+		cache.Get("tan(x)");
+		const auto respelled = cache.Get("x^2-2");
+		Check(respelled != square, "x^2-2 compiles again once every spelling of it was evicted");
+	}
+
+	void TestLanesMatchNewton(const std::shared_ptr<Logger>& logger)
+	{
+		const char* const exprs[] = { "x^2-2", "cos(x)-x", "ln(x)+x-2", "sqrt(x)-2", "tan(x)-x/2", "x^x-5", "1/x-3", "e^x-3" };
+		const double specialGuesses[] = { NAN, INFINITY, -INFINITY, 0.0, -1.0, 1E308 };
+		std::mt19937 random(2024);
+		std::uniform_real_distribution<double> guessDistribution(-10.0, 10.0);
+		for (const char* expr : exprs)
+		{
+			const CompiledExpression function(expr, logger);
+			const CompiledExpression derivative = function.Derivative();
+			std::vector<double> guesses(specialGuesses, specialGuesses + sizeof(specialGuesses) / sizeof(specialGuesses[0]));
+			while (guesses.size() < 500) guesses.push_back(guessDistribution(random));
+			std::vector<SolveResult<double>> laneResults(guesses.size());
+			solvers::NewtonLanes(function, derivative, guesses.data(), guesses.size(), OPTIONS, laneResults.data());
+
+			int mismatches = 0;
+			std::string first;
+			for (size_t i = 0; i < guesses.size(); ++i)
+			{
+				const SolveResult<double> expected = solvers::Newton([&](double x) { return function.Evaluate(x); },
+					[&](double x) { return derivative.Evaluate(x); }, guesses[i], OPTIONS, [](int, double) {});
+				const SolveResult<double>& actual = laneResults[i];
+				const bool sameRoot = actual.root == expected.root || (std::isnan(actual.root) && std::isnan(expected.root));
+				if (sameRoot && actual.iterations == expected.iterations && actual.status == expected.status &&
+					actual.functionEvaluations == expected.functionEvaluations && actual.derivativeEvaluations == expected.derivativeEvaluations) continue;
+				if (mismatches++ == 0)
+				{
+					first = "from " + std::to_string(guesses[i]) + " lanes give " + StatusName(actual.status) + " at " + std::to_string(actual.root) +
+						" after " + std::to_string(actual.iterations) + ", Newton " + StatusName(expected.status) + " at " + std::to_string(expected.root) +
+						" after " + std::to_string(expected.iterations);
+				}
+			}
+			Check(mismatches == 0, std::string("NewtonLanes matches Newton on ") + expr + ", " + std::to_string(mismatches) + " differ, " + first);
+		}
+	}
+
+	void TestTierAgreement(const std::shared_ptr<Logger>& logger)
+	{
+		const struct
+		{
+			const char* expr;
+			std::function<double(double)> expected;
+		} cases[] =
+		{
+			{ "-sin(x)^2+0.5", [](double x) { return 0.5 - std::sin(x) * std::sin(x); } },
+			{ "3x-1", [](double x) { return 3.0 * x - 1.0; } },
+			{ "x-3E-2", [](double x) { return x - 0.03; } },
+			{ "1+(x-5)^2", [](double x) { return 1.0 + (x - 5.0) * (x - 5.0); } },
+			{ "-3^2+x", [](double x) { return x - 9.0; } },
+			{ "2sin(x)", [](double x) { return 2.0 * std::sin(x); } },
+			{ "x(x+1)", [](double x) { return x * (x + 1.0); } },
+			{ "2e-1*x", [](double x) { return 0.2 * x; } },
+			{ "2^-x*e", [](double x) { return std::pow(2.0, -x) * M_E; } },
+			{ "-(x-5)/3", [](double x) { return (5.0 - x) / 3.0; } },
+			{ "min(x,-2x)+max(1,x)", [](double x) { return std::min(x, -2.0 * x) + std::max(1.0, x); } },
+			{ "sqrt(x-1)", [](double x) { return std::sqrt(x - 1.0); } },
+		};
+		const double xs[] = { 0.3, 1.7, -2.5 };
+		const auto same = [](double a, double b) { return (std::isnan(a) && std::isnan(b)) || std::abs(a - b) <= 1E-12 * std::max(1.0, std::abs(b)); };
+		for (const auto& testCase : cases)
+		{
+			Expression function(testCase.expr, logger);
+			function.SetTierThresholds(4, static_cast<size_t>(-1));
+			int mismatches = 0;
+			std::string first;
+			int evaluations = 0;
+			// the compiled form is built in the background, so keep evaluating across the switch
+			for (; evaluations < 2000 && (evaluations < 16 || function.GetTier() == ExpressionTier::INTERPRETED); ++evaluations)
+			{
+				const double x = xs[evaluations % 3];
+				const ExpressionTier tier = function.GetTier();
+				const double value = function.Evaluate(x);
+				if (!same(value, testCase.expected(x)) && mismatches++ == 0)
+				{
+					first = "at " + std::to_string(x) + (tier == ExpressionTier::INTERPRETED ? " interpreted " : " compiled ") +
+						std::to_string(value) + " instead of " + std::to_string(testCase.expected(x));
+				}
+				if (tier == ExpressionTier::INTERPRETED) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+			Check(mismatches == 0, std::string(testCase.expr) + " evaluates the same in every tier, " + std::to_string(mismatches) + " differ, " + first);
+			Check(function.GetTier() == ExpressionTier::COMPILED, std::string(testCase.expr) + " moves to the compiled form");
+
+			// the string derivative reads the expression the same way
+			Expression derivative = Expression(testCase.expr, logger).Derivative();
+			const CompiledExpression compiledDerivative = function.Compile().Derivative();
+			for (double x : xs)
+			{
+				Check(same(derivative.Evaluate(x), compiledDerivative.Evaluate(x)), std::string("the derivative of ") + testCase.expr + " at " +
+					std::to_string(x) + " is " + std::to_string(compiledDerivative.Evaluate(x)) + ", got " + std::to_string(derivative.Evaluate(x)));
+			}
+		}
+	}
+
+	void TestStartsShareBudget(const std::shared_ptr<Logger>& logger)
+	{
+		// x^2+1 has no root, and with the monitor's checks off every start runs until it is stopped
+		const CompiledExpression function("x^2+1", logger);
+		const CompiledExpression derivative = function.Derivative();
+		auto f = [&](double x) { return function.Evaluate(x); };
+		auto fPrime = [&](double x) { return derivative.Evaluate(x); };
+		const std::vector<solvers::StartCandidate> starts = { { 0.5, 0.6, false, 0.0 }, { -3.0, -2.9, false, 0.0 }, { 7.0, 7.1, false, 0.0 } };
+		SolveOptions options = OPTIONS;
+		options.stagnationLimit = 0;
+		options.cycleLength = 0;
+		options.divergenceLimit = 0;
+		for (int method = 0; method < 3; ++method)
+		{
+			const std::string name = METHOD_NAMES[method];
+			SolveOptions limited = options;
+			limited.maxSize = 10;
+			int iterates = 0;
+			int singleIterates = 0;
+			solvers::SolveFromStarts(static_cast<SolveMethod>(method), f, fPrime, starts, limited, 0, [&](int, double) { ++iterates; });
+			solvers::Solve(static_cast<SolveMethod>(method), f, fPrime, starts[0].x, starts[0].other, limited, [&](int, double) { ++singleIterates; });
+			Check(iterates == singleIterates, name + " from 3 starts with maxSize 10 made " + std::to_string(iterates) + " iterates, one solve makes " +
+				std::to_string(singleIterates));
+
+			limited = options;
+			limited.maxEvaluations = 50;
+			const int sampled = 20;
+			const SolveResult<double> byEvaluations = solvers::SolveFromStarts(static_cast<SolveMethod>(method), f, fPrime, starts, limited, sampled,
+				[](int, double) {});
+			const int used = byEvaluations.functionEvaluations + byEvaluations.derivativeEvaluations;
+			Check(used + sampled <= limited.maxEvaluations + 2 && byEvaluations.status == SolveStatus::BUDGET_EXHAUSTED, name +
+				" from 3 starts with 50 evaluations, 20 of them spent sampling, used " + std::to_string(used) + " more and stopped as " +
+				StatusName(byEvaluations.status));
+
+			limited.maxEvaluations = sampled;
+			const SolveResult<double> spent = solvers::SolveFromStarts(static_cast<SolveMethod>(method), f, fPrime, starts, limited, sampled,
+				[](int, double) {});
+			Check(spent.functionEvaluations + spent.derivativeEvaluations == 0 && spent.status == SolveStatus::BUDGET_EXHAUSTED, name +
+				" does not start once the sampling used the whole budget");
+		}
+	}
+
+	void TestStepperMatchesNewton(const std::shared_ptr<Logger>& logger)
+	{
+		const char* const exprs[] = { "x^2-2", "cos(x)-x", "ln(x)+x-2", "sqrt(x)-2", "1/x-3" };
+		const double guesses[] = { NAN, INFINITY, -INFINITY, 0.0, -1.0, 0.5, 3.0, 1E308 };
+		for (const char* expr : exprs)
+		{
+			const CompiledExpression function(expr, logger);
+			const CompiledExpression derivative = function.Derivative();
+			const auto makeStepper = [&](double guess)
+			{
+				return solvers::NewtonStepper([&function](double x) { return function.Evaluate(x); },
+					[&derivative](double x) { return derivative.Evaluate(x); }, guess, OPTIONS);
+			};
+			using Stepper = decltype(makeStepper(0.0));
+			std::vector<Stepper> byHand;
+			for (double guess : guesses) byHand.push_back(makeStepper(guess));
+			std::vector<Stepper> roundRobin = byHand;
+			std::vector<Stepper> byPriority = byHand;
+			for (Stepper& stepper : byHand) while (stepper.Next()) { }
+			const auto never = [](size_t, const Stepper&) { return false; };
+			solvers::RunRoundRobin(roundRobin, never);
+			// |f| is NaN wherever f is, and those have to be stepped all the same
+			solvers::RunByPriority(byPriority, [](const Stepper& stepper) { return -std::abs(stepper.GetFunctionValue()); }, never);
+
+			for (size_t i = 0; i < sizeof(guesses) / sizeof(guesses[0]); ++i)
+			{
+				const SolveResult<double> expected = solvers::Newton([&](double x) { return function.Evaluate(x); },
+					[&](double x) { return derivative.Evaluate(x); }, guesses[i], OPTIONS, [](int, double) {});
+				const std::pair<const char*, const Stepper*> runs[] = { { "by hand", &byHand[i] }, { "round robin", &roundRobin[i] },
+					{ "by priority", &byPriority[i] } };
+				for (const auto& run : runs)
+				{
+					const SolveResult<double>& actual = run.second->GetResult();
+					const bool sameRoot = actual.root == expected.root || (std::isnan(actual.root) && std::isnan(expected.root));
+					Check(run.second->IsFinished() && sameRoot && actual.iterations == expected.iterations && actual.status == expected.status &&
+						actual.functionEvaluations == expected.functionEvaluations && actual.derivativeEvaluations == expected.derivativeEvaluations,
+						std::string("NewtonStepper ") + run.first + " matches Newton on " + expr + " from " + std::to_string(guesses[i]) + ", gives " +
+						StatusName(actual.status) + " after " + std::to_string(actual.iterations) + ", Newton " + StatusName(expected.status) +
+						" after " + std::to_string(expected.iterations));
+				}
+			}
+		}
+	}
+
+	void TestCanonicalRoundTrip(const std::shared_ptr<Logger>& logger)
+	{
+		const char* const exprs[] = { "x-x", "2*x-x-x", "x-x+3", "sin(x)-sin(x)", "(x-x)*2", "x^2-x*x+x", "(x-x)^2", "1/(x-x)", "sin(x-x)",
+			"x^(x-x)", "(x-x)^x", "e^(x-x+1)", "min(x-x,1)", "x^(x-x+2)*x", "(x-x)/(x-x)", "x*(x-x+1)", "-(x-x)", "x^2-2", "2*x*x-3/x+1",
+			"cos(x)-x", "e^x-3", "x^0.5*x^0.5", "sqrt(x)/x^2", "max(x,2)-min(1,x)", "-x^3+0.1*x-1E-3", "x/3+x/3+x/3", "ln(x)-ln(x)+x",
+			"(x+x)*x", "1/(x+x)", "(x+x)/3", "x/(x+x)", "-(x+x)*x", "(x+1)*(x+1)", "0*x", "0/x" };
+		const double xs[] = { -1.0, 0.0, 0.5, 2.0 };
+		for (const char* expr : exprs)
+		{
+			const CompiledExpression function(expr, logger);
+			const std::string form = canonical::Canonicalize(function);
+			const CompiledExpression formFunction(form, logger);
+			const std::string again = canonical::Canonicalize(formFunction);
+			Check(again == form, std::string("canonical form of ") + expr + " reads back as itself, " + form + " became " + again);
+			for (const double x : xs)
+			{
+				const double expected = function.Evaluate(x);
+				const double actual = formFunction.Evaluate(x);
+				const bool same = actual == expected || (std::isnan(expected) && std::isnan(actual)) ||
+					std::abs(actual - expected) <= 1E-12 * (std::abs(expected) + 1.0);
+				Check(same, std::string("canonical form ") + form + " of " + expr + " has its value at " + std::to_string(x) + ", " +
+					std::to_string(actual) + " against " + std::to_string(expected));
+			}
+		}
+
+		// a term that cancels is still NaN where it is undefined, so the cache must not hand out the compiled x for it
+		ExpressionCache cache(logger, 4);
+		const auto plain = cache.Get("x");
+		const auto cancelled = cache.Get("x+ln(x)-ln(x)");
+		Check(cancelled != plain && std::isnan(cancelled->function->Evaluate(-1.0)), "x+ln(x)-ln(x) does not share the entry of x");
+	}
+
+	void TestOvershootRecovers(const std::shared_ptr<Logger>& logger)
+	{
+		// the first Newton step lands at about 50 and 330, and the iterates come back down far above |f| at the start
+		const struct
+		{
+			const char* expr;
+			double guess;
+			double root;
+		} cases[] = { { "x^10-1", 0.5, 1.0 }, { "e^x-1000", 1.1, std::log(1000.0) } };
+		const SolveOptions options = { 1000, 1E-10 };
+		for (const auto& c : cases)
+		{
+			const CompiledExpression function(c.expr, logger);
+			const CompiledExpression derivative = function.Derivative();
+			const SolveResult<double> result = solvers::Newton([&](double x) { return function.Evaluate(x); },
+				[&](double x) { return derivative.Evaluate(x); }, c.guess, options, [](int, double) {});
+			Check(result.status == SolveStatus::CONVERGED && std::abs(result.root - c.root) < 1E-9, std::string("Newton on ") + c.expr +
+				" from " + std::to_string(c.guess) + " recovers from its overshoot, gives " + StatusName(result.status) + " at " + std::to_string(result.root));
+		}
+
+		// an iterate past 1E150, straight after the start
+		SolveOptions unchecked = { 100, 1E-10 };
+		unchecked.divergenceLimit = 0;
+		ConvergenceMonitor<double> monitor(unchecked);
+		SolveStatus reason = SolveStatus::CONVERGED;
+		monitor.Start(1.0, 1.0, reason);
+		const bool stopped = monitor.Update(1E200, 1E200, 0.5, reason);
+		Check(!stopped, "divergenceLimit 0 never stops a solve as diverging, stopped with " + StatusName(reason));
+	}
+
+	void TestZeroProductsKeepDomain(const std::shared_ptr<Logger>& logger)
+	{
+		const struct
+		{
+			const char* expr;
+			double x;
+		} undefined[] = { { "0/x", 0.0 }, { "0*ln(x)", -1.0 }, { "ln(x)*0+x", -1.0 }, { "0*(1/x)", 0.0 }, { "x+0/sqrt(x)", -4.0 } };
+		for (const auto& c : undefined)
+		{
+			const CompiledExpression function(c.expr, logger);
+			Check(std::isnan(function.Evaluate(c.x)), std::string(c.expr) + " is NaN at " + std::to_string(c.x) + ", gives " +
+				std::to_string(function.Evaluate(c.x)));
+		}
+		Check(CompiledExpression("0*ln(x)", logger).Evaluate(2.0) == 0.0, "0*ln(x) is 0 where ln(x) is defined");
+
+		// the derivative of 3*x^2 has a 0*x^2 term from the constant, which has to go
+		const CompiledExpression derivative = CompiledExpression("3*x^2", logger).Derivative();
+		Check(derivative.GetNodes().size() <= 5 && derivative.Evaluate(2.0) == 12.0, "the derivative of 3*x^2 is 6*x in " +
+			std::to_string(derivative.GetNodes().size()) + " nodes, gives " + std::to_string(derivative.Evaluate(2.0)) + " at 2");
+	}
+}
\ No newline at end of file
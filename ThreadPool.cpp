@@ -0,0 +1,53 @@
+// Implements a fixed set of worker threads
+
+#include "pch.h"
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned int threadCount) :
+	stopping(false)
+{
+	if (threadCount == 0) threadCount = std::thread::hardware_concurrency();
+	if (threadCount == 0) threadCount = 1;
+	threads.reserve(threadCount);
+	for (unsigned int i = 0; i < threadCount; ++i) threads.emplace_back(&ThreadPool::WorkerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(tasksMutex);
+		stopping = true;
+	}
+	tasksChanged.notify_all();
+	for (auto& thread : threads) thread.join();
+}
+
+void ThreadPool::Submit(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock(tasksMutex);
+		tasks.push_back(std::move(task));
+	}
+	tasksChanged.notify_one();
+}
+
+unsigned int ThreadPool::GetThreadCount() const
+{
+	return static_cast<unsigned int>(threads.size());
+}
+
+void ThreadPool::WorkerLoop()
+{
+	while (true)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(tasksMutex);
+			tasksChanged.wait(lock, [this]() { return stopping || !tasks.empty(); });
+			if (tasks.empty()) return; // only when stopping
+			task = std::move(tasks.front());
+			tasks.pop_front();
+		}
+		task();
+	}
+}
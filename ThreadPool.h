@@ -0,0 +1,33 @@
+// A fixed set of worker threads that run submitted tasks in order of submission
+// Owned by whoever needs long-lived workers; the destructor finishes the queued tasks and joins the threads
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+public:
+	ThreadPool() = delete;
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// 0 threads means one per core
+	ThreadPool(unsigned int threadCount);
+	~ThreadPool();
+
+	void Submit(std::function<void()> task);
+	unsigned int GetThreadCount() const;
+private:
+	void WorkerLoop();
+
+	std::vector<std::thread> threads;
+	std::deque<std::function<void()>> tasks;
+	std::mutex tasksMutex;
+	std::condition_variable tasksChanged;
+	bool stopping;
+};
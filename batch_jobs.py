@@ -0,0 +1,66 @@
+# -*- coding: utf-8 -*-
+"""
+Reads and writes the binary batch job and result files used by BatchDriver.
+The layout is documented in BatchJobFile.h.
+"""
+
+import numpy as np
+
+BATCH_JOB_MAGIC = 0x4A424652
+BATCH_RESULT_MAGIC = 0x52424652
+BATCH_FORMAT_VERSION = 2 # 2 added secondGuess to the job records
+BATCH_PENDING = -1
+BATCH_WORKER_FAILED = -2 # a job BatchCoordinator gave up on after its worker crashed or hung on it twice
+ILLINOIS = 3
+
+JOB_HEADER_DTYPE = np.dtype([('magic', '<u4'), ('version', '<u4'), ('expressionCount', '<u8'), ('jobCount', '<u8'),
+                             ('expressionTableOffset', '<u8'), ('stringsOffset', '<u8'), ('jobsOffset', '<u8')])
+EXPRESSION_ENTRY_DTYPE = np.dtype([('offset', '<u8'), ('length', '<u4'), ('reserved', '<u4')])
+JOB_DTYPE = np.dtype([('initialGuess', '<f8'), ('secondGuess', '<f8'), ('goalErr', '<f8'), ('expressionIndex', '<u4'),
+                      ('maxSize', '<i4'), ('method', '<i4'), ('reserved', '<i4')])
+RESULT_HEADER_DTYPE = np.dtype([('magic', '<u4'), ('version', '<u4'), ('jobCount', '<u8'), ('recordsOffset', '<u8'), ('reserved', '<u8')])
+RESULT_DTYPE = np.dtype([('root', '<f8'), ('iterations', '<i4'), ('status', '<i4')])
+
+
+def write_batch_jobs(path, jobs):
+    """Write (expression, initialGuess, goalErr, maxSize[, method[, secondGuess]]) tuples to a job file. Repeated expressions are stored once.
+    secondGuess is the other end of the Illinois bracket or the secant's second point, left out it is put next to initialGuess,
+    which Illinois cannot use, so Illinois jobs must give it."""
+    expressionIndices = {}
+    records = np.zeros(len(jobs), dtype=JOB_DTYPE)
+    for i, job in enumerate(jobs):
+        expression, initialGuess, goalErr, maxSize = job[0:4]
+        method = job[4] if len(job) > 4 else 0
+        secondGuess = job[5] if len(job) > 5 else np.nan
+        if method == ILLINOIS and np.isnan(secondGuess):
+            raise ValueError('job ' + str(i) + ' uses the Illinois method without a second guess to bracket the root')
+        index = expressionIndices.setdefault(expression, len(expressionIndices))
+        records[i] = (initialGuess, secondGuess, goalErr, index, maxSize, method, 0)
+
+    strings = [expression.encode() for expression in expressionIndices]
+    table = np.zeros(len(strings), dtype=EXPRESSION_ENTRY_DTYPE)
+    offset = 0
+    for i, string in enumerate(strings):
+        table[i] = (offset, len(string), 0)
+        offset += len(string)
+
+    header = np.zeros(1, dtype=JOB_HEADER_DTYPE)
+    tableOffset = JOB_HEADER_DTYPE.itemsize
+    stringsOffset = tableOffset + table.nbytes
+    jobsOffset = (stringsOffset + offset + 7) & ~7
+    header[0] = (BATCH_JOB_MAGIC, BATCH_FORMAT_VERSION, len(strings), len(jobs), tableOffset, stringsOffset, jobsOffset)
+
+    with open(path, 'wb') as f:
+        f.write(header.tobytes())
+        f.write(table.tobytes())
+        f.write(b''.join(strings))
+        f.write(bytes(jobsOffset - stringsOffset - offset))
+        f.write(records.tobytes())
+
+
+def read_batch_results(path):
+    """Memory-map a result file. Returns a structured array with root, iterations and status fields."""
+    header = np.fromfile(path, dtype=RESULT_HEADER_DTYPE, count=1)[0]
+    if header['magic'] != BATCH_RESULT_MAGIC or header['version'] != BATCH_FORMAT_VERSION:
+        raise ValueError(path + ' is not a batch result file')
+    return np.memmap(path, dtype=RESULT_DTYPE, mode='r', offset=int(header['recordsOffset']), shape=(int(header['jobCount']),))
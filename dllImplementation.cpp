@@ -3,69 +3,755 @@
 #include "pch.h"
 #include "dllImplementation.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <complex>
+#include "CurveSampler.h"
+#include <functional>
 #include "Expression.h"
+#include "IncrementalEvaluator.h"
+#include "IntervalSolver.h"
+#include "LaneSolver.h"
 #include "Logger.h"
 #include <memory>
+#include <mutex>
+#include "Parallel.h"
+#include "SolveCapture.h"
+#include "SolveJob.h"
+#include "Solvers.h"
+#include <vector>
 
 using namespace std;
 
+namespace
+{
+	const int DEFAULT_MAX_SIZE = 10000;
+	const double DEFAULT_GOAL_ERR = 1.0E-4;
+	const int BASIN_TILE_SIZE = 16; // tiles of BASIN_TILE_SIZE x BASIN_TILE_SIZE starting points are handed to each thread
+	const size_t BATCH_CHUNK_SIZE = 256; // batch solves and evaluations are handed to each thread in chunks of this size
+	const size_t INTERVAL_MAX_BOXES = 1 << 22; // FindAllRoots gives up refining after looking at this many boxes
+	const double FAST_MATH_MIN_GOAL_ERR = 1E-12; // with accuracy 2, goalErr must be at least this for the fast math kernels to be used
+	const double DEFAULT_SEARCH_LO = -10.0;
+	const double DEFAULT_SEARCH_HI = 10.0;
+	const int AUTO_GUESS_SAMPLES = 32; // points of the search range sampled to pick the starts from, a multiple of EVALUATION_LANES
+	const size_t AUTO_GUESS_STARTS = 4; // most promising samples tried, in order, until a solve converges
+	const double CURVE_TOLERANCE = 1E-3; // SampleCurve refines until each piece is this close to straight, relative to the spread of the values
+
+	bool CheckInputs(const std::shared_ptr<Logger>& logger, size_t exprLen, int maxSize);
+	SolveOptions ToSolveOptions(const SolveSettings& settings, std::chrono::steady_clock::time_point start);
+	// the solve behind SolveForRootEx, calling observer(i, x, |f(x)|) with every iterate instead of storing it
+	int SolveExpression(const char* expr, size_t exprLen, const SolveSettings& settings, std::chrono::steady_clock::time_point start,
+		const std::function<void(int, double, double)>& observer, SolveReport& report);
+	bool StoppedEarly(SolveStatus status);
+	MathAccuracy ToMathAccuracy(const SolveSettings& settings);
+
+	// the capture SolveForRoot appends to while StartSolveCapture is in effect
+	std::shared_ptr<SolveCaptureWriter> solveCapture;
+	std::mutex solveCaptureMutex;
+
+	// runs settings.method from initialGuess, with options made from settings. derivative is only called by Newton's Method
+	template <typename Function, typename Derivative, typename Observer>
+	SolveResult<double> RunSolveMethod(const SolveSettings& settings, const SolveOptions& options, double initialGuess, Function&& function, Derivative&& derivative, Observer&& observer)
+	{
+		// the secant method needs two distinct points to start from
+		double secondGuess = settings.secondGuess;
+		if (secondGuess == settings.initialGuess) secondGuess = solvers::OffsetGuess(initialGuess);
+
+		return solvers::Solve(static_cast<SolveMethod>(settings.method), function, derivative, initialGuess, secondGuess, options, observer);
+	}
+}
+
 
 int dllImplementation::SolveForRoot(const char* expr, size_t exprLen, double initialGuess, int maxSize, double goalErr, double* results)
 {
+	std::shared_ptr<SolveCaptureWriter> capture;
+	{
+		std::lock_guard<std::mutex> lock(solveCaptureMutex);
+		capture = solveCapture;
+	}
+	if (capture == nullptr)
+	{
+		return SolveForRootWithMethod(expr, exprLen, static_cast<int>(SolveMethod::NEWTON), initialGuess, initialGuess, maxSize, goalErr, results);
+	}
+
+	// the same solve as SolveForRootWithMethod, keeping the report for the capture
+	SolveSettings settings;
+	InitSolveSettings(&settings);
+	settings.initialGuess = initialGuess;
+	settings.secondGuess = initialGuess;
+	settings.maxSize = maxSize;
+	settings.goalErr = goalErr;
+	SolveReport report;
+	const double startTime = capture->GetElapsed();
+	const auto start = std::chrono::steady_clock::now();
+	const int iterations = SolveForRootEx(expr, exprLen, &settings, results, &report);
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	try
+	{
+		capture->Add(std::string(expr, exprLen), { initialGuess, goalErr, startTime, seconds, 0, maxSize, iterations, report.status });
+	}
+	catch (...)
+	{
+		// a failing capture must not fail the solve
+		auto logger = std::make_shared<Logger>("logfile.txt");
+		logger->Log("SolveForRoot - unable to write to the solve capture");
+	}
+	return iterations;
+}
 
+int dllImplementation::StartSolveCapture(const char* path, size_t pathLen)
+{
+	// Starts appending every SolveForRoot call to a new capture file at path, replacing any capture already running
+	// outputs 1 if the capture was started, 0 is the signal that something went wrong
 	auto logger = std::make_shared<Logger>("logfile.txt");
+	try
+	{
+		auto capture = std::make_shared<SolveCaptureWriter>(std::string(path, pathLen));
+		std::lock_guard<std::mutex> lock(solveCaptureMutex);
+		solveCapture = capture;
+	}
+	catch (const std::exception& e)
+	{
+		logger->Log("StartSolveCapture - " + std::string(e.what()));
+		return 0;
+	}
+	return 1;
+}
+
+void dllImplementation::StopSolveCapture()
+{
+	// solves still running keep their reference and finish writing to the capture, which is closed after the last one
+	std::lock_guard<std::mutex> lock(solveCaptureMutex);
+	solveCapture.reset();
+}
 
-	// Uses Newton's Method to calculate the roots.
+int dllImplementation::SolveForRootWithMethod(const char* expr, size_t exprLen, int method, double initialGuess, double secondGuess, int maxSize, double goalErr, double* results)
+{
+	// secondGuess seeds the secant slope or is the other end of the Illinois bracket, and is ignored by Newton and Steffensen
+	// an output of 0 is the signal to the calling funcitons that somethign went wrong
+	SolveSettings settings;
+	InitSolveSettings(&settings);
+	settings.method = method;
+	settings.initialGuess = initialGuess;
+	settings.secondGuess = secondGuess;
+	settings.maxSize = maxSize;
+	settings.goalErr = goalErr;
+
+	SolveReport report;
+	return SolveForRootEx(expr, exprLen, &settings, results, &report);
+}
+
+void dllImplementation::InitSolveSettings(SolveSettings* settings)
+{
+	const SolveOptions defaults = { DEFAULT_MAX_SIZE, DEFAULT_GOAL_ERR };
+	settings->method = static_cast<int>(SolveMethod::NEWTON);
+	settings->initialGuess = 0.0;
+	settings->secondGuess = 0.0;
+	settings->maxSize = defaults.maxSize;
+	settings->goalErr = defaults.goalErr;
+	settings->stepTol = defaults.stepTol;
+	settings->relStepTol = defaults.relStepTol;
+	settings->stagnationLimit = defaults.stagnationLimit;
+	settings->cycleLength = defaults.cycleLength;
+	settings->divergenceLimit = defaults.divergenceLimit;
+	settings->timeLimit = 0.0;
+	settings->maxEvaluations = defaults.maxEvaluations;
+	settings->cancellation = defaults.cancellation;
+	settings->accuracy = static_cast<int>(MathAccuracy::FULL);
+	settings->autoGuess = 0;
+	settings->searchLo = DEFAULT_SEARCH_LO;
+	settings->searchHi = DEFAULT_SEARCH_HI;
+}
+
+int dllImplementation::SolveForRootEx(const char* expr, size_t exprLen, const SolveSettings* settings, double* results, SolveReport* report)
+{
+	const auto start = std::chrono::steady_clock::now();
+
+	// Uses the chosen SolveMethod to calculate the roots. Only Newton's Method needs the derivative
 	// outputs the number of iterations used to solve the system. Stores intermediate results in the results output
-	// stops if reaches the maxSize number of iterations or if the absolute error drops reaches goalErr
+	// stops if reaches the maxSize number of iterations, if the absolute error drops reaches goalErr, or if the
+	// ConvergenceMonitor decides the solve is stuck. report->status holds the SolveStatus saying which one happened
+	// a solve stopped by the time limit, the evaluation budget or its cancellation token outputs the iterates it got to
+	// with settings->autoGuess, samples [searchLo, searchHi] and solves from the most promising samples in turn until one converges,
+	// reporting the last solve and the evaluations of all of them, sampling included. If no sample looks promising initialGuess is used
 	// an output of 0 is the signal to the calling funcitons that somethign went wrong
-	if (maxSize <= 0 || exprLen == 0)
+	return SolveExpression(expr, exprLen, *settings, start, [&](int i, double x, double) { results[i] = x; }, *report);
+}
+
+SolveJob* dllImplementation::StartSolveAsync(const char* expr, size_t exprLen, const SolveSettings* settings, SolveProgressCallback progress,
+	SolveDoneCallback done, double progressInterval, void* context)
+{
+	// Starts the same solve as SolveForRootEx on a thread of its own and returns straight away with a handle to it
+	// progress(context, iteration, x, |f(x)|) is called for the initial guess and then at most once every progressInterval seconds
+	// done(context, iterations, report) is called when the solve is over, with what SolveForRootEx would have output. Both are
+	// called on the solve's thread and may be nullptr, in which case GetSolveJobProgress and WaitSolveJob tell the same
+	// settings->cancellation is replaced by the job's own, which CancelSolveJob cancels. The expression and settings are copied
+	// every job must be freed with DestroySolveJob, an output of nullptr is the signal that the job could not be started
+	const auto start = std::chrono::steady_clock::now();
+	try
+	{
+		const std::string exprCopy(expr, exprLen);
+		SolveSettings jobSettings = *settings;
+		auto job = std::make_unique<SolveJob>(settings->maxSize, progress, done, progressInterval, context);
+		jobSettings.cancellation = job->GetCancellation();
+		job->Start([exprCopy, jobSettings, start](SolveJob& running, SolveReport& report)
+		{
+			double* iterates = running.GetIterates();
+			return SolveExpression(exprCopy.c_str(), exprCopy.size(), jobSettings, start, [&](int i, double x, double funcMag)
+			{
+				iterates[i] = x;
+				running.ReportProgress(i, x, funcMag);
+			}, report);
+		});
+		return job.release();
+	}
+	catch (const std::exception& e)
+	{
+		auto logger = std::make_shared<Logger>("logfile.txt");
+		logger->Log("StartSolveAsync - " + std::string(e.what()));
+		return nullptr;
+	}
+}
+
+int dllImplementation::GetSolveJobProgress(SolveJob* job, int* iteration, double* x, double* funcMag)
+{
+	// the latest iterate of the solve and |f| there. outputs 1 once the solve has finished, 0 while it is running
+	return job->GetProgress(*iteration, *x, *funcMag) ? 1 : 0;
+}
+
+int dllImplementation::WaitSolveJob(SolveJob* job, double timeout)
+{
+	// waits up to timeout seconds for the solve to finish, 0 just looks and a negative timeout waits as long as it takes
+	// outputs 1 if the solve has finished, 0 if it is still running
+	return job->Wait(timeout) ? 1 : 0;
+}
+
+int dllImplementation::GetSolveJobResult(SolveJob* job, double* results, SolveReport* report)
+{
+	// once the solve has finished, stores its iterates in results, which must hold maxSize + 1 values, and fills in report
+	// outputs what SolveForRootEx would have, or -1 while the solve is still running
+	return job->GetResult(results, *report);
+}
+
+void dllImplementation::CancelSolveJob(SolveJob* job)
+{
+	// the solve stops within a step with CANCELLED, and still finishes as usual
+	job->Cancel();
+}
+
+void dllImplementation::DestroySolveJob(SolveJob* job)
+{
+	// cancels the solve if it is still running and waits for it. Must not be called from the job's own callbacks
+	delete job;
+}
+
+int dllImplementation::SolveBatch(const char* expr, size_t exprLen, const SolveSettings* settings, const double* initialGuesses, size_t count,
+	double* roots, int* iterations, int* statuses)
+{
+	const auto start = std::chrono::steady_clock::now();
+	auto logger = std::make_shared<Logger>("logfile.txt");
+
+	// Solves the same expression from every one of the count initial guesses, spread across all cores
+	// settings->initialGuess and settings->autoGuess are ignored. For the secant method every guess is paired with a point just next to it,
+	// unless settings->secondGuess differs from settings->initialGuess, in which case it is used for all of them
+	// stores the root, iterations and SolveStatus of every solve, intermediate iterates are not kept
+	// settings->timeLimit covers the whole batch. Once it has passed, or the cancellation token is cancelled, the running
+	// solves stop where they are and the ones not started yet keep their initial guess, both with TIMED_OUT or CANCELLED
+	// settings->accuracy picks between the library math functions and the fast approximations
+	// outputs the number of solves that converged, -1 is the signal that something went wrong
+	if (!CheckInputs(logger, exprLen, settings->maxSize)) return -1;
+
+	try
 	{
-		logger->Log("Failed to evaluate");
-		if (maxSize <= 0)
+		auto function = Expression(expr, exprLen, logger);
+		const CompiledExpression& compiledFunction = function.Compile();
+		std::unique_ptr<CompiledExpression> derivative;
+		const CompiledExpression* compiledDerivative = nullptr;
+		if (static_cast<SolveMethod>(settings->method) == SolveMethod::NEWTON)
 		{
-			logger->Log("Cannot iterate to 0");
+			derivative = std::make_unique<CompiledExpression>(compiledFunction.Derivative());
+			compiledDerivative = derivative.get();
 		}
-		if (exprLen == 0)
+
+		const SolveOptions options = ToSolveOptions(*settings, start);
+		const MathAccuracy accuracy = ToMathAccuracy(*settings);
+		std::atomic<int> converged(0);
+		std::atomic<int> stopped(0);
+		const size_t chunks = (count + BATCH_CHUNK_SIZE - 1) / BATCH_CHUNK_SIZE;
+		parallel::ParallelFor(chunks, [&](size_t chunk)
+		{
+			const size_t begin = chunk * BATCH_CHUNK_SIZE;
+			const size_t end = std::min(count, begin + BATCH_CHUNK_SIZE);
+			SolveResult<double> results[BATCH_CHUNK_SIZE];
+			SolveStatus reason;
+			if (ConvergenceMonitor<double>(options).Interrupted(0, reason))
+			{
+				// the batch is out of time or cancelled, skip the whole chunk
+				for (size_t i = begin; i < end; ++i) results[i - begin] = { initialGuesses[i], 0, reason, 0, 0 };
+			}
+			else if (compiledDerivative != nullptr)
+			{
+				// Newton's Method runs the whole chunk in SIMD lanes
+				solvers::NewtonLanes(compiledFunction, *compiledDerivative, initialGuesses + begin, end - begin, options, results, accuracy);
+			}
+			else
+			{
+				for (size_t i = begin; i < end; ++i)
+				{
+					results[i - begin] = RunSolveMethod(*settings, options, initialGuesses[i],
+						[&](double x) { return compiledFunction.Evaluate(x, accuracy); },
+						[&](double x) { return compiledDerivative->Evaluate(x, accuracy); },
+						[](int, double) {});
+				}
+			}
+			for (size_t i = begin; i < end; ++i)
+			{
+				const SolveResult<double>& result = results[i - begin];
+				roots[i] = result.root;
+				iterations[i] = result.iterations;
+				statuses[i] = static_cast<int>(result.status);
+				if (result.status == SolveStatus::CONVERGED || result.status == SolveStatus::CONVERGED_STEP) ++converged;
+				else if (StoppedEarly(result.status)) ++stopped;
+			}
+		});
+
+		std::string logMsg = "SolveBatch - " + std::to_string(converged) + " of " + std::to_string(count) + " solves converged";
+		if (stopped > 0) logMsg += ", " + std::to_string(stopped) + " stopped by the time limit, evaluation budget or cancellation";
+		logger->LogEndChunk(logMsg);
+		return converged;
+	}
+	catch (...)
+	{
+		// something went wrong. It is possible the inputted expression was incorrect. 
+		return -1;
+	}
+}
+
+int dllImplementation::EvaluateBatch(const char* expr, size_t exprLen, const double* xs, size_t count, double* values)
+{
+	auto logger = std::make_shared<Logger>("logfile.txt");
+
+	// Evaluates the expression at each of the count values in xs, spread across all cores
+	// outputs 1 on success, 0 is the signal that something went wrong
+	if (exprLen == 0)
+	{
+		logger->Log("Cannot evaluate nothing");
+		return 0;
+	}
+
+	try
+	{
+		auto function = Expression(expr, exprLen, logger);
+		const CompiledExpression& compiledFunction = function.Compile();
+		const size_t chunks = (count + BATCH_CHUNK_SIZE - 1) / BATCH_CHUNK_SIZE;
+		parallel::ParallelFor(chunks, [&](size_t chunk)
+		{
+			const size_t end = std::min(count, (chunk + 1) * BATCH_CHUNK_SIZE);
+			size_t i = chunk * BATCH_CHUNK_SIZE;
+			for (; i + EVALUATION_LANES <= end; i += EVALUATION_LANES) compiledFunction.EvaluateLanes(xs + i, values + i);
+			for (; i < end; ++i) values[i] = compiledFunction.Evaluate(xs[i]);
+		});
+		return 1;
+	}
+	catch (...)
+	{
+		// something went wrong. It is possible the inputted expression was incorrect. 
+		return 0;
+	}
+}
+
+int dllImplementation::EvaluateParameterSweep(const char* expr, size_t exprLen, const char* parameter, size_t parameterLen, double x,
+	const double* parameterValues, size_t count, double* values)
+{
+	auto logger = std::make_shared<Logger>("logfile.txt");
+
+	// Evaluates the expression at x once for each of the count values of the named parameter in parameterValues
+	// only the part of the expression that depends on the parameter is redone from one value to the next
+	// outputs 1 on success, 0 is the signal that something went wrong
+	if (exprLen == 0 || parameterLen == 0)
+	{
+		logger->Log("Cannot evaluate nothing");
+		return 0;
+	}
+
+	try
+	{
+		CompiledExpression function(std::string(expr, exprLen), logger, { std::string(parameter, parameterLen) });
+		IncrementalEvaluator evaluator(function);
+		size_t recomputed = 0;
+		for (size_t i = 0; i < count; ++i)
 		{
-			logger->Log("Cannot evaluate nothing");
+			function.SetParameter(0, parameterValues[i]);
+			values[i] = evaluator.Evaluate(x);
+			recomputed += evaluator.GetRecomputedCount();
 		}
+		const std::string logMsg = "EvaluateParameterSweep - " + std::to_string(count) + " evaluations recomputed " + std::to_string(recomputed) +
+			" nodes of " + std::to_string(count * function.GetNodes().size());
+		logger->LogEndChunk(logMsg);
+		return 1;
+	}
+	catch (...)
+	{
+		// something went wrong. It is possible the inputted expression or parameter name was incorrect.
 		return 0;
 	}
+}
+
+int dllImplementation::SolveForComplexRoot(const char* expr, size_t exprLen, double initialGuessReal, double initialGuessImag, int maxSize, double goalErr,
+	double* resultsReal, double* resultsImag)
+{
+	auto logger = std::make_shared<Logger>("logfile.txt");
+
+	// Same as SolveForRoot, but iterates in the complex plane so complex roots can be found
+	// the real and imaginary parts of the iterates are stored in resultsReal and resultsImag
+	if (!CheckInputs(logger, exprLen, maxSize)) return 0;
 
 	int iterNum = 0;
 	try
 	{
 		auto function = Expression(expr, exprLen, logger);
+		const CompiledExpression& compiledFunction = function.Compile();
+		const CompiledExpression compiledDerivative = compiledFunction.Derivative();
+
+		const SolveResult<complex<double>> result = solvers::Newton(
+			[&](complex<double> z) { return compiledFunction.Evaluate(z); },
+			[&](complex<double> z) { return compiledDerivative.Evaluate(z); },
+			complex<double>(initialGuessReal, initialGuessImag), { maxSize, goalErr },
+			[&](int i, complex<double> z) { resultsReal[i] = z.real(); resultsImag[i] = z.imag(); });
+		if (result.status == SolveStatus::ZERO_DERIVATIVE)
+		{
+			logger->Log("Derivative found to be zero, exiting");
+			return 0; // cannot solve
+		}
+		iterNum = result.iterations;
+	}
+	catch (...)
+	{
+		// something went wrong. It is possible the inputted expression was incorrect. 
+		iterNum = 0;
+	}
+	return iterNum;
+}
+
+int dllImplementation::ComputeNewtonBasins(const char* expr, size_t exprLen, double realMin, double realMax, double imagMin, double imagMax,
+	int width, int height, int maxSize, double goalErr, int maxRoots, double* rootsReal, double* rootsImag, int* rootIndices, int* iterationCounts)
+{
+	auto logger = std::make_shared<Logger>("logfile.txt");
+
+	// Runs complex Newton from every point of a width x height grid spanning the given rectangle
+	// grid points are stored row-major, row 0 is imagMin and column 0 is realMin
+	// for every point, rootIndices holds the index of the root it converged to (or -1) and iterationCounts the iterations used
+	// distinct roots are stored in rootsReal/rootsImag in the order they were found, up to maxRoots of them
+	// outputs the number of distinct roots found, -1 is the signal that something went wrong
+	if (!CheckInputs(logger, exprLen, maxSize) || width <= 0 || height <= 0 || maxRoots < 0)
+	{
+		logger->Log("ComputeNewtonBasins - invalid grid");
+		return -1;
+	}
+
+	try
+	{
+		auto function = Expression(expr, exprLen, logger);
+
+		// compile up front, the worker threads only evaluate
+		const CompiledExpression& compiledFunction = function.Compile();
+		const CompiledExpression compiledDerivative = compiledFunction.Derivative();
+
+		const double realStep = width > 1 ? (realMax - realMin) / (width - 1) : 0.0;
+		const double imagStep = height > 1 ? (imagMax - imagMin) / (height - 1) : 0.0;
+		const double rootTolerance = std::max(std::sqrt(goalErr), 1E-8); // iterates closer than this are treated as the same root
 
+		std::vector<complex<double>> roots;
+		std::mutex rootsMutex;
+		auto findRootIndex = [&](complex<double> root, std::vector<complex<double>>& knownRoots) -> int
+		{
+			// check this tile's copy of the roots first so the shared list is only locked for new roots
+			for (size_t i = 0; i < knownRoots.size(); ++i)
+				if (std::abs(knownRoots[i] - root) < rootTolerance) return static_cast<int>(i);
 
-		auto derivative = function.Derivative();
-		double xn = initialGuess;
-		double funcVal = function.Evaluate(xn);
-		results[0] = xn;
+			std::lock_guard<std::mutex> lock(rootsMutex);
+			knownRoots = roots;
+			for (size_t i = 0; i < knownRoots.size(); ++i)
+				if (std::abs(knownRoots[i] - root) < rootTolerance) return static_cast<int>(i);
+			if (roots.size() >= static_cast<size_t>(maxRoots)) return -1;
+			roots.push_back(root);
+			knownRoots = roots;
+			return static_cast<int>(roots.size() - 1);
+		};
 
-		for (iterNum = 1; iterNum <= maxSize && std::fabs(funcVal) > goalErr; ++iterNum)
+		const int tilesAcross = (width + BASIN_TILE_SIZE - 1) / BASIN_TILE_SIZE;
+		const int tilesDown = (height + BASIN_TILE_SIZE - 1) / BASIN_TILE_SIZE;
+		parallel::ParallelFor(static_cast<size_t>(tilesAcross) * tilesDown, [&](size_t tile)
 		{
-			// Newton's Method implementation
-			// x[n+1] = x[n] - f[x] / f'[x]
-			// error == f[x]
-			const double derivVal = derivative.Evaluate(xn);
-			if (std::fabs(derivVal) < VERY_SMALL_VALUE)
+			const int rowStart = static_cast<int>(tile / tilesAcross) * BASIN_TILE_SIZE;
+			const int colStart = static_cast<int>(tile % tilesAcross) * BASIN_TILE_SIZE;
+			const int rowEnd = std::min(rowStart + BASIN_TILE_SIZE, height);
+			const int colEnd = std::min(colStart + BASIN_TILE_SIZE, width);
+
+			std::vector<complex<double>> knownRoots;
+			for (int row = rowStart; row < rowEnd; ++row)
 			{
-				logger->Log("Derivative found to be zero, exiting");
-				return 0; // cannot solve
+				for (int col = colStart; col < colEnd; ++col)
+				{
+					const complex<double> start(realMin + col * realStep, imagMin + row * imagStep);
+					const SolveResult<complex<double>> result = solvers::Newton(
+						[&](complex<double> z) { return compiledFunction.Evaluate(z); },
+						[&](complex<double> z) { return compiledDerivative.Evaluate(z); },
+						start, { maxSize, goalErr },
+						[](int, complex<double>) {});
+
+					const size_t pixel = static_cast<size_t>(row) * width + col;
+					iterationCounts[pixel] = result.iterations;
+					rootIndices[pixel] = result.status == SolveStatus::CONVERGED ?
+						findRootIndex(result.root, knownRoots) :
+						-1;
+				}
 			}
-			xn -= funcVal / derivVal;
-			funcVal = function.Evaluate(xn);
-			results[iterNum] = xn;
+		});
+
+		for (size_t i = 0; i < roots.size(); ++i)
+		{
+			rootsReal[i] = roots[i].real();
+			rootsImag[i] = roots[i].imag();
 		}
-		if (iterNum > maxSize) iterNum = maxSize;
+		const std::string logMsg = "ComputeNewtonBasins - found " + std::to_string(roots.size()) + " roots";
+		logger->LogEndChunk(logMsg);
+		return static_cast<int>(roots.size());
 	}
 	catch (...)
 	{
 		// something went wrong. It is possible the inputted expression was incorrect. 
-		iterNum = 0;
+		return -1;
+	}
+}
+
+CancellationToken* dllImplementation::CreateCancellationToken()
+{
+	// Cancelling the token with CancelSolves stops every solve whose SolveSettings point at it, from any thread
+	// a cancelled token stays cancelled, make a new one for the next solves
+	return new CancellationToken();
+}
+
+void dllImplementation::CancelSolves(CancellationToken* token)
+{
+	token->Cancel();
+}
+
+void dllImplementation::DestroyCancellationToken(CancellationToken* token)
+{
+	// no solve may still be using the token
+	delete token;
+}
+
+int dllImplementation::FindAllRoots(const char* expr, size_t exprLen, double lo, double hi, double tolerance, int maxRoots,
+	double* rootsLo, double* rootsHi, int* unique)
+{
+	auto logger = std::make_shared<Logger>("logfile.txt");
+
+	// Encloses every root in [lo, hi] using interval arithmetic, so unlike the other solvers no root can be missed
+	// each root is somewhere in [rootsLo[i], rootsHi[i]], and unique[i] is 1 when that enclosure is proven to hold
+	// exactly one root, 0 when it might hold several or none (such as a double root, or a pole of tan)
+	// enclosures are at most tolerance wide, apart from neighbouring ones merged around a multiple root, which can be wider
+	// enclosures are sorted and stored up to maxRoots of them
+	// outputs the number of enclosures found, -1 is the signal that something went wrong
+	if (exprLen == 0 || !(lo <= hi) || !(tolerance > 0.0) || maxRoots < 0)
+	{
+		logger->Log("FindAllRoots - invalid inputs");
+		return -1;
+	}
+
+	try
+	{
+		auto function = Expression(expr, exprLen, logger);
+
+		// compile up front, the worker threads only evaluate
+		const CompiledExpression& compiledFunction = function.Compile();
+		const CompiledExpression compiledDerivative = compiledFunction.Derivative();
+
+		const std::vector<RootEnclosure> enclosures = solvers::IntervalNewton(compiledFunction, compiledDerivative, Interval(lo, hi), tolerance, INTERVAL_MAX_BOXES);
+		for (size_t i = 0; i < enclosures.size() && i < static_cast<size_t>(maxRoots); ++i)
+		{
+			rootsLo[i] = enclosures[i].enclosure.lo;
+			rootsHi[i] = enclosures[i].enclosure.hi;
+			unique[i] = enclosures[i].unique ? 1 : 0;
+		}
+
+		const std::string logMsg = "FindAllRoots - found " + std::to_string(enclosures.size()) + " root enclosures";
+		logger->LogEndChunk(logMsg);
+		return static_cast<int>(enclosures.size());
+	}
+	catch (...)
+	{
+		// something went wrong. It is possible the inputted expression was incorrect. 
+		return -1;
+	}
+}
+
+int dllImplementation::SampleCurve(const char* expr, size_t exprLen, double lo, double hi, int maxPoints, double tolerance,
+	double* xs, double* values)
+{
+	auto logger = std::make_shared<Logger>("logfile.txt");
+
+	// Samples the expression over [lo, hi] for plotting, placing points where the curve bends or jumps rather than evenly
+	// refines until every piece is within tolerance of straight, relative to the spread of the values, or maxPoints are used
+	// tolerance of 0 or less uses CURVE_TOLERANCE, about a pixel on a plot 1000 pixels high
+	// xs and values must hold maxPoints each, the points are stored sorted by x
+	// outputs the number of points stored, 0 is the signal that something went wrong
+	if (exprLen == 0 || !std::isfinite(lo) || !std::isfinite(hi) || !(lo < hi) || maxPoints < 2)
+	{
+		logger->Log("SampleCurve - invalid inputs");
+		return 0;
+	}
+
+	try
+	{
+		auto function = Expression(expr, exprLen, logger);
+
+		// compile up front, the worker threads only evaluate
+		const CompiledExpression& compiledFunction = function.Compile();
+		std::vector<double> sampleXs;
+		std::vector<double> sampleValues;
+		sampling::SampleCurve(compiledFunction, lo, hi, static_cast<size_t>(maxPoints), tolerance > 0.0 ? tolerance : CURVE_TOLERANCE,
+			sampleXs, sampleValues);
+		std::copy(sampleXs.begin(), sampleXs.end(), xs);
+		std::copy(sampleValues.begin(), sampleValues.end(), values);
+		return static_cast<int>(sampleXs.size());
+	}
+	catch (...)
+	{
+		// something went wrong. It is possible the inputted expression was incorrect. 
+		return 0;
+	}
+}
+
+namespace
+{
+	int SolveExpression(const char* expr, size_t exprLen, const SolveSettings& settings, std::chrono::steady_clock::time_point start,
+		const std::function<void(int, double, double)>& observer, SolveReport& report)
+	{
+		auto logger = std::make_shared<Logger>("logfile.txt");
+
+		report = { settings.initialGuess, 0, static_cast<int>(SolveStatus::INVALID_INPUT), 0, 0 };
+		if (!CheckInputs(logger, exprLen, settings.maxSize)) return 0;
+
+		int iterNum = 0;
+		try
+		{
+			auto function = Expression(expr, exprLen, logger);
+			// only Newton's Method evaluates the derivative during the solve. Some expressions only have a compiled derivative
+			std::unique_ptr<Expression> derivative;
+			if (static_cast<SolveMethod>(settings.method) == SolveMethod::NEWTON) derivative = std::make_unique<Expression>(function.Derivative());
+			// the solvers evaluate f at every iterate just before reporting it, so the last value evaluated is f at the iterate
+			double lastFuncVal = 0.0;
+			auto evaluate = [&](double x) { return lastFuncVal = function.Evaluate(x); };
+			auto evaluateDerivative = [&](double x) { return derivative->Evaluate(x); };
+			auto storeIterate = [&](int i, double x) { observer(i, x, std::abs(lastFuncVal)); };
+
+			SolveResult<double> result;
+			const SolveOptions options = ToSolveOptions(settings, start);
+			std::vector<solvers::StartCandidate> starts;
+			int sampleEvaluations = 0;
+			int sampleDerivativeEvaluations = 0;
+			if (settings.autoGuess != 0)
+			{
+				// the samples are evaluated in lanes, which costs about as much as a couple of the string evaluator's evaluations
+				const CompiledExpression& compiledFunction = function.Compile();
+				const CompiledExpression compiledDerivative = compiledFunction.Derivative();
+				auto sample = [&](const double* xs, double* values, size_t count)
+				{
+					size_t i = 0;
+					for (; i + EVALUATION_LANES <= count; i += EVALUATION_LANES) compiledFunction.EvaluateLanes(xs + i, values + i);
+					for (; i < count; ++i) values[i] = compiledFunction.Evaluate(xs[i]);
+				};
+				auto sampleDerivative = [&](double x) { return compiledDerivative.Evaluate(x); };
+				starts = solvers::RankStarts(sample, sampleDerivative, settings.searchLo, settings.searchHi, AUTO_GUESS_SAMPLES, AUTO_GUESS_STARTS,
+					sampleEvaluations, sampleDerivativeEvaluations);
+				logger->Log("SolveExpression - sampling found " + std::to_string(starts.size()) + " starting points");
+			}
+			if (!starts.empty())
+			{
+				// each start overwrites the iterates of the one before, so the iterates left are those of the solve reported
+				result = solvers::SolveFromStarts(static_cast<SolveMethod>(settings.method), evaluate, evaluateDerivative, starts, options,
+					sampleEvaluations + sampleDerivativeEvaluations, storeIterate);
+			}
+			else
+			{
+				// nothing promising in the search range, or no automatic guess asked for
+				result = RunSolveMethod(settings, options, settings.initialGuess, evaluate, evaluateDerivative, storeIterate);
+			}
+			result.functionEvaluations += sampleEvaluations;
+			result.derivativeEvaluations += sampleDerivativeEvaluations;
+
+			report = { result.root, result.iterations, static_cast<int>(result.status), result.functionEvaluations, result.derivativeEvaluations };
+			const std::string logMsg = "SolveExpression - finished with status " + std::to_string(report.status) + " after " + std::to_string(result.iterations) + " iterations";
+			logger->LogEndChunk(logMsg);
+			if (result.status == SolveStatus::ZERO_DERIVATIVE)
+			{
+				logger->Log("Derivative found to be zero, exiting");
+				return 0; // cannot solve
+			}
+			if (result.status == SolveStatus::NO_BRACKET)
+			{
+				logger->Log("Initial guesses do not bracket a root, exiting");
+				return 0; // cannot solve
+			}
+			iterNum = result.iterations;
+		}
+		catch (...)
+		{
+			// something went wrong. It is possible the inputted expression was incorrect. 
+			iterNum = 0;
+		}
+		return iterNum;
+	}
+
+	SolveOptions ToSolveOptions(const SolveSettings& settings, std::chrono::steady_clock::time_point start)
+	{
+		// start is when the call began, timeLimit counts from there
+		SolveOptions options = { settings.maxSize, settings.goalErr };
+		options.stepTol = settings.stepTol;
+		options.relStepTol = settings.relStepTol;
+		options.stagnationLimit = settings.stagnationLimit;
+		options.cycleLength = settings.cycleLength;
+		options.divergenceLimit = settings.divergenceLimit;
+		options.maxEvaluations = settings.maxEvaluations;
+		options.cancellation = settings.cancellation;
+		if (settings.timeLimit > 0.0)
+		{
+			options.deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(settings.timeLimit));
+		}
+		return options;
+	}
+
+	bool StoppedEarly(SolveStatus status)
+	{
+		return status == SolveStatus::CANCELLED || status == SolveStatus::TIMED_OUT || status == SolveStatus::BUDGET_EXHAUSTED;
+	}
+
+	MathAccuracy ToMathAccuracy(const SolveSettings& settings)
+	{
+		// the fast kernels are a few ulp out, which only matters when goalErr asks for nearly all the digits
+		if (settings.accuracy == 2) return settings.goalErr >= FAST_MATH_MIN_GOAL_ERR ? MathAccuracy::FAST : MathAccuracy::FULL;
+		return settings.accuracy == static_cast<int>(MathAccuracy::FAST) ? MathAccuracy::FAST : MathAccuracy::FULL;
+	}
+
+	bool CheckInputs(const std::shared_ptr<Logger>& logger, size_t exprLen, int maxSize)
+	{
+		if (maxSize <= 0 || exprLen == 0)
+		{
+			logger->Log("Failed to evaluate");
+			if (maxSize <= 0)
+			{
+				logger->Log("Cannot iterate to 0");
+			}
+			if (exprLen == 0)
+			{
+				logger->Log("Cannot evaluate nothing");
+			}
+			return false;
+		}
+		return true;
 	}
-	return iterNum;
 }
@@ -1,7 +1,73 @@
 // Defines the main functions to export
 #pragma once
 
+class CancellationToken;
+class SolveJob;
+
+// C layout so callers (such as ctypes) can build it directly. Fill with InitSolveSettings before changing fields
+struct SolveSettings
+{
+	int method; // SolveMethod
+	double initialGuess;
+	double secondGuess; // seeds the secant slope or is the other end of the Illinois bracket
+	int maxSize;
+	double goalErr; // absolute tolerance on |f(x)|
+	double stepTol; // absolute tolerance on |x[n+1] - x[n]|, 0 disables
+	double relStepTol; // relative tolerance on |x[n+1] - x[n]|, 0 disables
+	int stagnationLimit; // iterations without |f(x)| improving on the recent iterates before giving up, 0 disables
+	int cycleLength; // longest cycle between iterates to look for, 0 disables
+	int divergenceLimit; // iterations in a row with |x| doubling before giving up, also gives up once |x| is past 1E150, 0 disables both
+	double timeLimit; // seconds the whole call may take, after which solves stop with TIMED_OUT, 0 disables
+	int maxEvaluations; // function and derivative evaluations each solve may use, the sampling for autoGuess included, 0 disables
+	const CancellationToken* cancellation; // from CreateCancellationToken, solves stop with CANCELLED once it is cancelled, nullptr disables
+	int accuracy; // 0 uses the library math functions, 1 the faster approximations of FastMath.h, 2 the approximations only if goalErr allows
+	int autoGuess; // 1 ignores initialGuess and secondGuess and starts from the most promising samples of [searchLo, searchHi], 0 disables
+	double searchLo;
+	double searchHi;
+};
+
+struct SolveReport
+{
+	double root;
+	int iterations;
+	int status; // SolveStatus, says why the solve stopped
+	int functionEvaluations;
+	int derivativeEvaluations;
+};
+
+// called from the thread running an asynchronous solve, with the context given to StartSolveAsync
+typedef void (*SolveProgressCallback)(void* context, int iteration, double x, double funcMag);
+typedef void (*SolveDoneCallback)(void* context, int iterations, const SolveReport* report);
+
 namespace dllImplementation
 {
 	int SolveForRoot(const char* expr, size_t exprLen, double initialGuess, int maxSize, double goalErr, double* results);
+	int SolveForRootWithMethod(const char* expr, size_t exprLen, int method, double initialGuess, double secondGuess, int maxSize, double goalErr, double* results);
+	int StartSolveCapture(const char* path, size_t pathLen);
+	void StopSolveCapture();
+	void InitSolveSettings(SolveSettings* settings);
+	int SolveForRootEx(const char* expr, size_t exprLen, const SolveSettings* settings, double* results, SolveReport* report);
+	SolveJob* StartSolveAsync(const char* expr, size_t exprLen, const SolveSettings* settings, SolveProgressCallback progress, SolveDoneCallback done,
+		double progressInterval, void* context);
+	int GetSolveJobProgress(SolveJob* job, int* iteration, double* x, double* funcMag);
+	int WaitSolveJob(SolveJob* job, double timeout);
+	int GetSolveJobResult(SolveJob* job, double* results, SolveReport* report);
+	void CancelSolveJob(SolveJob* job);
+	void DestroySolveJob(SolveJob* job);
+	int SolveBatch(const char* expr, size_t exprLen, const SolveSettings* settings, const double* initialGuesses, size_t count,
+		double* roots, int* iterations, int* statuses);
+	int EvaluateBatch(const char* expr, size_t exprLen, const double* xs, size_t count, double* values);
+	int EvaluateParameterSweep(const char* expr, size_t exprLen, const char* parameter, size_t parameterLen, double x,
+		const double* parameterValues, size_t count, double* values);
+	int SolveForComplexRoot(const char* expr, size_t exprLen, double initialGuessReal, double initialGuessImag, int maxSize, double goalErr,
+		double* resultsReal, double* resultsImag);
+	int ComputeNewtonBasins(const char* expr, size_t exprLen, double realMin, double realMax, double imagMin, double imagMax,
+		int width, int height, int maxSize, double goalErr, int maxRoots, double* rootsReal, double* rootsImag, int* rootIndices, int* iterationCounts);
+	CancellationToken* CreateCancellationToken();
+	void CancelSolves(CancellationToken* token);
+	void DestroyCancellationToken(CancellationToken* token);
+	int FindAllRoots(const char* expr, size_t exprLen, double lo, double hi, double tolerance, int maxRoots,
+		double* rootsLo, double* rootsHi, int* unique);
+	int SampleCurve(const char* expr, size_t exprLen, double lo, double hi, int maxPoints, double tolerance,
+		double* xs, double* values);
 };
@@ -24,3 +24,117 @@ extern "C" __declspec(dllexport) double SolveForRoot(const char* expr, size_t ex
 {
     return dllImplementation::SolveForRoot(expr, exprLen, initialGuess, maxSize, goalErr, results);
 }
+
+extern "C" __declspec(dllexport) int SolveForRootWithMethod(const char* expr, size_t exprLen, int method, double initialGuess, double secondGuess, int maxSize, double goalErr,
+    double* results)
+{
+    return dllImplementation::SolveForRootWithMethod(expr, exprLen, method, initialGuess, secondGuess, maxSize, goalErr, results);
+}
+
+extern "C" __declspec(dllexport) int StartSolveCapture(const char* path, size_t pathLen)
+{
+    return dllImplementation::StartSolveCapture(path, pathLen);
+}
+
+extern "C" __declspec(dllexport) void StopSolveCapture()
+{
+    dllImplementation::StopSolveCapture();
+}
+
+extern "C" __declspec(dllexport) void InitSolveSettings(SolveSettings* settings)
+{
+    dllImplementation::InitSolveSettings(settings);
+}
+
+extern "C" __declspec(dllexport) int SolveForRootEx(const char* expr, size_t exprLen, const SolveSettings* settings, double* results, SolveReport* report)
+{
+    return dllImplementation::SolveForRootEx(expr, exprLen, settings, results, report);
+}
+
+extern "C" __declspec(dllexport) SolveJob* StartSolveAsync(const char* expr, size_t exprLen, const SolveSettings* settings, SolveProgressCallback progress,
+    SolveDoneCallback done, double progressInterval, void* context)
+{
+    return dllImplementation::StartSolveAsync(expr, exprLen, settings, progress, done, progressInterval, context);
+}
+
+extern "C" __declspec(dllexport) int GetSolveJobProgress(SolveJob* job, int* iteration, double* x, double* funcMag)
+{
+    return dllImplementation::GetSolveJobProgress(job, iteration, x, funcMag);
+}
+
+extern "C" __declspec(dllexport) int WaitSolveJob(SolveJob* job, double timeout)
+{
+    return dllImplementation::WaitSolveJob(job, timeout);
+}
+
+extern "C" __declspec(dllexport) int GetSolveJobResult(SolveJob* job, double* results, SolveReport* report)
+{
+    return dllImplementation::GetSolveJobResult(job, results, report);
+}
+
+extern "C" __declspec(dllexport) void CancelSolveJob(SolveJob* job)
+{
+    dllImplementation::CancelSolveJob(job);
+}
+
+extern "C" __declspec(dllexport) void DestroySolveJob(SolveJob* job)
+{
+    dllImplementation::DestroySolveJob(job);
+}
+
+extern "C" __declspec(dllexport) int SolveBatch(const char* expr, size_t exprLen, const SolveSettings* settings, const double* initialGuesses, size_t count,
+    double* roots, int* iterations, int* statuses)
+{
+    return dllImplementation::SolveBatch(expr, exprLen, settings, initialGuesses, count, roots, iterations, statuses);
+}
+
+extern "C" __declspec(dllexport) int EvaluateBatch(const char* expr, size_t exprLen, const double* xs, size_t count, double* values)
+{
+    return dllImplementation::EvaluateBatch(expr, exprLen, xs, count, values);
+}
+
+extern "C" __declspec(dllexport) int EvaluateParameterSweep(const char* expr, size_t exprLen, const char* parameter, size_t parameterLen, double x,
+    const double* parameterValues, size_t count, double* values)
+{
+    return dllImplementation::EvaluateParameterSweep(expr, exprLen, parameter, parameterLen, x, parameterValues, count, values);
+}
+
+extern "C" __declspec(dllexport) int SolveForComplexRoot(const char* expr, size_t exprLen, double initialGuessReal, double initialGuessImag, int maxSize, double goalErr,
+    double* resultsReal, double* resultsImag)
+{
+    return dllImplementation::SolveForComplexRoot(expr, exprLen, initialGuessReal, initialGuessImag, maxSize, goalErr, resultsReal, resultsImag);
+}
+
+extern "C" __declspec(dllexport) int ComputeNewtonBasins(const char* expr, size_t exprLen, double realMin, double realMax, double imagMin, double imagMax,
+    int width, int height, int maxSize, double goalErr, int maxRoots, double* rootsReal, double* rootsImag, int* rootIndices, int* iterationCounts)
+{
+    return dllImplementation::ComputeNewtonBasins(expr, exprLen, realMin, realMax, imagMin, imagMax,
+        width, height, maxSize, goalErr, maxRoots, rootsReal, rootsImag, rootIndices, iterationCounts);
+}
+
+extern "C" __declspec(dllexport) int FindAllRoots(const char* expr, size_t exprLen, double lo, double hi, double tolerance, int maxRoots,
+    double* rootsLo, double* rootsHi, int* unique)
+{
+    return dllImplementation::FindAllRoots(expr, exprLen, lo, hi, tolerance, maxRoots, rootsLo, rootsHi, unique);
+}
+
+extern "C" __declspec(dllexport) CancellationToken* CreateCancellationToken()
+{
+    return dllImplementation::CreateCancellationToken();
+}
+
+extern "C" __declspec(dllexport) void CancelSolves(CancellationToken* token)
+{
+    dllImplementation::CancelSolves(token);
+}
+
+extern "C" __declspec(dllexport) void DestroyCancellationToken(CancellationToken* token)
+{
+    dllImplementation::DestroyCancellationToken(token);
+}
+
+extern "C" __declspec(dllexport) int SampleCurve(const char* expr, size_t exprLen, double lo, double hi, int maxPoints, double tolerance,
+    double* xs, double* values)
+{
+    return dllImplementation::SampleCurve(expr, exprLen, lo, hi, maxPoints, tolerance, xs, values);
+}
@@ -9,12 +9,19 @@ import sys
 import matplotlib.pyplot as plt
 import numpy as np
 
+from ctypes import byref
 from ctypes import CDLL
+from ctypes import c_char_p
 from ctypes import c_int
 from ctypes import c_double
+from ctypes import c_size_t
+from ctypes import c_void_p
 from ctypes import create_string_buffer
+from ctypes import POINTER
+from ctypes import Structure
 from functools import partial
 from PyQt5.QtCore import Qt
+from PyQt5.QtCore import QTimer
 from PyQt5.QtWidgets import QApplication
 from PyQt5.QtWidgets import QFileDialog
 from PyQt5.QtWidgets import QGridLayout
@@ -26,8 +33,50 @@ from PyQt5.QtWidgets import QSizePolicy
 from PyQt5.QtWidgets import QVBoxLayout
 from PyQt5.QtWidgets import QWidget
 
+try:
+    # Native extension module built with setup.py, avoids the ctypes call overhead
+    import rootfinder_native
+except ImportError:
+    rootfinder_native = None
+
 ERROR_MSG = 'There was an issue in solving this problem'
 NOT_A_NUMBER = 'This is not a valid input'
+AUTO_GUESS = 'auto' # typed as the initial guess, lets the solver pick where to start
+POLL_INTERVAL_MS = 50 # how often a running solve is checked on
+CURVE_POINTS = 1000 # most points f is sampled at for its plot, placed where the curve bends
+CURVE_TOLERANCE = 1E-3 # how close to straight each piece of the plotted curve is, relative to the spread of f
+CURVE_MARGIN = 0.25 # the plot of f reaches this fraction of the iterates' range past them on either side
+CURVE_CLIP_PERCENTILE = 2 # the plot of f is scaled to the values between this percentile and its mirror, so poles do not flatten it
+
+
+class SolveSettings(Structure):
+    """Mirrors SolveSettings in dllImplementation.h, fill with InitSolveSettings."""
+    _fields_ = [('method', c_int),
+                ('initialGuess', c_double),
+                ('secondGuess', c_double),
+                ('maxSize', c_int),
+                ('goalErr', c_double),
+                ('stepTol', c_double),
+                ('relStepTol', c_double),
+                ('stagnationLimit', c_int),
+                ('cycleLength', c_int),
+                ('divergenceLimit', c_int),
+                ('timeLimit', c_double),
+                ('maxEvaluations', c_int),
+                ('cancellation', c_void_p),
+                ('accuracy', c_int),
+                ('autoGuess', c_int),
+                ('searchLo', c_double),
+                ('searchHi', c_double)]
+
+
+class SolveReport(Structure):
+    """Mirrors SolveReport in dllImplementation.h."""
+    _fields_ = [('root', c_double),
+                ('iterations', c_int),
+                ('status', c_int),
+                ('functionEvaluations', c_int),
+                ('derivativeEvaluations', c_int)]
 
 class MyUI(QMainWindow):        
     """Defines the UI"""
@@ -186,19 +235,26 @@ class MyUI(QMainWindow):
         """Get display's text."""
         return self.display.text()
 
+    def setStatusText(self, text):
+        """Show text in the status bar, for progress that should not replace the expression."""
+        self.statusBar().showMessage(text)
+
     def clearDisplay(self):
         """Clear the display."""
         self.setDisplayText('')
     
     def retrieveInputs(self):
-        """Retrieve the initial guess, maximum iterations, and goal values. Issue an error if invalid. First value is whether there were errors"""
+        """Retrieve the initial guess, maximum iterations, and goal values. Issue an error if invalid. First value is whether there were errors
+        The initial guess is None when it is set to pick itself"""
         hadErrors = False
         initGuess = 0.0
         maxIterations = 0
         goalErr = 0.0
         
         try:
-            initGuess = float(self.initialGuessBox.text())
+            # None asks the solver to pick the initial guess itself
+            text = self.initialGuessBox.text().strip()
+            initGuess = None if text.lower() == AUTO_GUESS else float(text)
         except ValueError:
             self.initialGuessBox.setText(NOT_A_NUMBER)
             self.initialGuessBox.setFocus()
@@ -226,19 +282,52 @@ class MyController:
     """The controller for MyUI."""
     def __init__(self, model, view):
         """Controller initializer."""
-        self._evaluate = model
+        self._evaluator = model
         self._view = view
+        self._job = None
+        self._expression = ''
+        # Solves run on a native thread, the timer checks on them from the UI thread so it never blocks
+        self._pollTimer = QTimer()
+        self._pollTimer.timeout.connect(self._pollSolve)
         self._connectSignals() # Connect signals and slots
 
     def _calculateResult(self):
-        """Evaluate expressions."""
+        """Start solving the expression, the result is shown once the solve finishes."""
         expr = self._view.displayText() 
         
         (hadErrors, initGuess, maxIterations, goalErr) = self._view.retrieveInputs()
         
         if (not hadErrors):
-            result = self._evaluate(expr, initGuess, maxIterations, goalErr) 
-            self._view.setDisplayText(result)
+            self._stopSolve()
+            self._job = self._evaluator.startSolve(expr, initGuess, maxIterations, goalErr)
+            if self._job is None:
+                self._view.setDisplayText(ERROR_MSG)
+                return
+            self._expression = expr
+            self._view.setStatusText('Solving ' + expr)
+            self._pollTimer.start(POLL_INTERVAL_MS)
+
+    def _pollSolve(self):
+        """Show the progress of the running solve, and its result once it is done."""
+        (finished, iteration, x, funcMag) = self._job.poll()
+        if not finished:
+            self._view.setStatusText('Solving {0}: iteration {1}, x = {2:.10g}, |f(x)| = {3:.3g}'.format(self._expression, iteration, x, funcMag))
+            return
+        
+        self._pollTimer.stop()
+        iterates = self._job.iterates()
+        self._job.close()
+        self._job = None
+        self._view.setStatusText('')
+        self._view.setDisplayText(self._evaluator.showIterates(self._expression, iterates))
+
+    def _stopSolve(self):
+        """Cancel the running solve, if any."""
+        self._pollTimer.stop()
+        if self._job is not None:
+            self._job.close()
+            self._job = None
+        self._view.setStatusText('')
 
     def _buildExpression(self, subExpr):
         """Build expression."""
@@ -256,34 +345,183 @@ class MyController:
 
         self._view.buttons['EVAL'].clicked.connect(self._calculateResult)
         self._view.display.returnPressed.connect(self._calculateResult)
+        self._view.buttons['C'].clicked.connect(self._stopSolve)
         self._view.buttons['C'].clicked.connect(self._view.clearDisplay)
 
 
+class SolveJob:
+    """A solve running on a native thread in the DLL, as started by MyEvaluator.startSolve."""
+    def __init__(self, lib, handle, maxNumberOfIterations):
+        self._lib = lib
+        self._handle = handle
+        self._maxNumberOfIterations = maxNumberOfIterations
+
+    def poll(self):
+        """Returns whether the solve has finished, and its latest iteration, x and |f(x)|."""
+        iteration = c_int()
+        x = c_double()
+        funcMag = c_double()
+        finished = self._lib.GetSolveJobProgress(self._handle, byref(iteration), byref(x), byref(funcMag))
+        return (finished != 0, iteration.value, x.value, funcMag.value)
+
+    def iterates(self):
+        """The iterates of the finished solve, empty if something went wrong."""
+        results = (c_double * (self._maxNumberOfIterations + 1))()
+        report = SolveReport()
+        numResults = self._lib.GetSolveJobResult(self._handle, results, byref(report))
+        return np.ctypeslib.as_array(results)[0:max(numResults, 0)]
+
+    def close(self):
+        """Cancel the solve if it is still running and free it."""
+        if self._handle is not None:
+            self._lib.DestroySolveJob(self._handle)
+            self._handle = None
+
+
 class MyEvaluator:
     """The Evaluator for MyController. Links Controller to DLL."""    
     def __init__(self, dllLocation):
         self.lib = CDLL(dllLocation)
+        # pointers have to be declared, ctypes would cut them down to an int otherwise
+        self.lib.StartSolveAsync.restype = c_void_p
+        self.lib.StartSolveAsync.argtypes = [c_char_p, c_size_t, POINTER(SolveSettings), c_void_p, c_void_p, c_double, c_void_p]
+        self.lib.GetSolveJobProgress.argtypes = [c_void_p, POINTER(c_int), POINTER(c_double), POINTER(c_double)]
+        self.lib.GetSolveJobResult.argtypes = [c_void_p, POINTER(c_double), POINTER(SolveReport)]
+        self.lib.DestroySolveJob.argtypes = [c_void_p]
+        self.lib.EvaluateBatch.argtypes = [c_char_p, c_size_t, POINTER(c_double), c_size_t, POINTER(c_double)]
+        self.lib.SampleCurve.argtypes = [c_char_p, c_size_t, c_double, c_double, c_int, c_double, POINTER(c_double), POINTER(c_double)]
         
     def evaluateExpression(self, expression, initialGuess, maxNumberOfIterations, goalErr):
-        """Evaluate an expression."""
+        """Evaluate an expression, waiting for the result."""
+        
+        if rootfinder_native is not None:
+            # Iterates come back in a native buffer that numpy wraps without copying
+            autoGuess = initialGuess is None
+            iterates, _ = rootfinder_native.solve(expression, 0.0 if autoGuess else initialGuess, maxNumberOfIterations, goalErr,
+                                                  auto_guess=autoGuess)
+            arrResults = np.asarray(iterates)
+        else:
+            arrResults = self._evaluateWithCtypes(expression, initialGuess, maxNumberOfIterations, goalErr)
+        return self.showIterates(expression, arrResults)
+
+    def startSolve(self, expression, initialGuess, maxNumberOfIterations, goalErr):
+        """Start solving an expression without waiting, returns a SolveJob or None if it could not be started."""
+        settings = self._makeSettings(initialGuess, maxNumberOfIterations, goalErr)
+        # no callbacks, they would run on the solve's thread where Qt cannot be used. The controller polls instead
+        cExpr = expression.encode()
+        handle = self.lib.StartSolveAsync(cExpr, len(cExpr), byref(settings), None, None, 0.0, None)
+        if not handle:
+            return None
+        return SolveJob(self.lib, handle, maxNumberOfIterations)
+
+    def showIterates(self, expression, arrResults):
+        """Plot the iterates, and f around them with the iterates marked on it, returns the text to display."""
+        numResults = len(arrResults)
+        if (numResults == 0):
+            return ERROR_MSG
+        
+        _, (historyAxes, curveAxes) = plt.subplots(1, 2, figsize=(12, 5))
+        historyAxes.plot(arrResults[0:numResults-1])
+        historyAxes.set_xlabel('Iteration Number')
+        historyAxes.set_ylabel('Solution Estimate')
+        self._plotCurve(curveAxes, expression, arrResults)
+        plt.show(block=False)
+        return str(arrResults[numResults-1]);
+
+    def sampleCurve(self, expression, lo, hi):
+        """Samples f over [lo, hi] more densely where it bends, returns the xs and values, empty if something went wrong."""
+        if rootfinder_native is not None:
+            try:
+                xs, values = rootfinder_native.sample_curve(expression, lo, hi, CURVE_POINTS, CURVE_TOLERANCE)
+            except ValueError:
+                return (np.empty(0), np.empty(0))
+            return (np.asarray(xs), np.asarray(values))
+        
+        xs = (c_double * CURVE_POINTS)()
+        values = (c_double * CURVE_POINTS)()
+        cExpr = expression.encode()
+        numPoints = self.lib.SampleCurve(cExpr, len(cExpr), c_double(lo), c_double(hi), CURVE_POINTS, c_double(CURVE_TOLERANCE), xs, values)
+        return (np.ctypeslib.as_array(xs)[0:numPoints], np.ctypeslib.as_array(values)[0:numPoints])
+
+    def evaluateAt(self, expression, xs):
+        """f at each of xs, NaN everywhere if something went wrong."""
+        xs = np.ascontiguousarray(xs, dtype=np.float64)
+        if rootfinder_native is not None:
+            try:
+                return np.asarray(rootfinder_native.evaluate(expression, xs))
+            except ValueError:
+                return np.full(len(xs), np.nan)
+        
+        values = np.empty(len(xs))
+        cExpr = expression.encode()
+        pointer = POINTER(c_double)
+        if self.lib.EvaluateBatch(cExpr, len(cExpr), xs.ctypes.data_as(pointer), len(xs), values.ctypes.data_as(pointer)) == 0:
+            values.fill(np.nan)
+        return values
+
+    def _plotCurve(self, axes, expression, arrResults):
+        """Plot f over the range of the iterates, with some room either side, and mark the iterates on it."""
+        iterates = arrResults[np.isfinite(arrResults)]
+        if len(iterates) == 0:
+            return
+        lo = np.min(iterates)
+        hi = np.max(iterates)
+        margin = max(CURVE_MARGIN * (hi - lo), 1.0)
+        xs, values = self.sampleCurve(expression, lo - margin, hi + margin)
+        isFinite = np.isfinite(values)
+        if len(xs) < 2 or not np.any(isFinite):
+            return
+        
+        # scale to the bulk of the values, and break the line where it runs far off the plot, which is across a pole
+        # the points bunch up at poles, so each value counts for the width of x it stands for rather than once
+        widths = np.gradient(xs)[isFinite]
+        order = np.argsort(values[isFinite])
+        shares = np.cumsum(widths[order]) / np.sum(widths)
+        bottom, top = np.interp([CURVE_CLIP_PERCENTILE / 100, 1 - CURVE_CLIP_PERCENTILE / 100], shares, values[isFinite][order])
+        pad = max(0.1 * (top - bottom), 1E-12)
+        bottom -= pad
+        top += pad
+        shown = np.where((values > top + 10 * (top - bottom)) | (values < bottom - 10 * (top - bottom)), np.nan, values)
+        
+        iterateValues = self.evaluateAt(expression, iterates)
+        axes.plot(xs, shown)
+        axes.plot(iterates, iterateValues, 'o-', markersize=4, alpha=0.6)
+        axes.axhline(0.0, color='grey', linewidth=0.5)
+        axes.set_ylim(bottom, top)
+        axes.set_xlabel('x')
+        axes.set_ylabel('f(x)')
+
+    def _makeSettings(self, initialGuess, maxNumberOfIterations, goalErr):
+        """SolveSettings for Newton's Method from initialGuess, or from a guess picked automatically when it is None."""
+        settings = SolveSettings()
+        self.lib.InitSolveSettings(byref(settings))
+        settings.maxSize = maxNumberOfIterations
+        settings.goalErr = goalErr
+        if initialGuess is None:
+            settings.autoGuess = 1
+        else:
+            settings.initialGuess = initialGuess
+            settings.secondGuess = initialGuess
+        return settings
+        
+    def _evaluateWithCtypes(self, expression, initialGuess, maxNumberOfIterations, goalErr):
+        """Solve through the DLL, returns the iterates."""
         
          # Results array is created on the python side, so memory management is automatic
-        results = (c_double * maxNumberOfIterations)()
-        cInitGuess = c_double(initialGuess)
+        results = (c_double * (maxNumberOfIterations + 1))()
         cMaxNum = c_int(maxNumberOfIterations)
         cGoalErr = c_double(goalErr)
         cExpr = create_string_buffer(expression.encode())
-        numResults = self.lib.SolveForRoot(cExpr.value, len(expression), cInitGuess, cMaxNum, cGoalErr, results)
-        if (numResults == 0):
-            return ERROR_MSG
+        if initialGuess is None:
+            # the automatic guess is a setting of SolveForRootEx
+            settings = self._makeSettings(initialGuess, maxNumberOfIterations, goalErr)
+            report = SolveReport()
+            numResults = self.lib.SolveForRootEx(cExpr.value, len(expression), byref(settings), results, byref(report))
+        else:
+            numResults = self.lib.SolveForRoot(cExpr.value, len(expression), c_double(initialGuess), cMaxNum, cGoalErr, results)
         
         arrResults = np.ctypeslib.as_array(results)
-        
-        plt.plot(arrResults[0:numResults-1])
-        plt.xlabel('Iteration Number')
-        plt.ylabel('Solution Estimate')
-        plt.show()
-        return str(results[numResults-1]);
+        return arrResults[0:numResults]
 
 def main():
     app = QApplication(sys.argv)
@@ -293,8 +531,7 @@ def main():
     
     # Create instances of the model and the controller
     evaluator = MyEvaluator(r'RootFinder.dll')
-    model = evaluator.evaluateExpression
-    MyController(model=model, view=ui)
+    controller = MyController(model=evaluator, view=ui)
     
     sys.exit(app.exec_())
     
@@ -0,0 +1,40 @@
+# -*- coding: utf-8 -*-
+"""
+Builds rootfinder_native, the CPython extension module over the C++ core.
+
+    python setup.py build_ext --inplace
+"""
+
+import sys
+from setuptools import Extension
+from setuptools import setup
+
+SOURCES = [
+    'PythonModule/RootFinderModule.cpp',
+    'BytecodeExpression.cpp',
+    'CompiledExpression.cpp',
+    'CurveSampler.cpp',
+    'dllImplementation.cpp',
+    'Expression.cpp',
+    'IncrementalEvaluator.cpp',
+    'Interval.cpp',
+    'IntervalSolver.cpp',
+    'LaneSolver.cpp',
+    'Logger.cpp',
+    'MappedFile.cpp',
+    'Parallel.cpp',
+    'SolveCapture.cpp',
+    'SolveJob.cpp',
+]
+
+if sys.platform == 'win32':
+    COMPILE_ARGS = ['/std:c++17', '/O2', '/EHsc']
+else:
+    COMPILE_ARGS = ['-std=c++17', '-O2']
+
+setup(
+    name='rootfinder_native',
+    version='1.0',
+    description='Native bindings for the RootFinder C++ core',
+    ext_modules=[Extension('rootfinder_native', SOURCES, extra_compile_args=COMPILE_ARGS, language='c++')],
+)